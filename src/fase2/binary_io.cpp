@@ -0,0 +1,442 @@
+#include "common.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#include "constants.h"
+#include "manager.h"
+
+namespace fase {
+
+using std::string, std::vector, std::map;
+using size_t = std::size_t;
+
+// Layout (integers are little endian)
+//   "FASEPIPE" u32:version
+//   u32:n_strings  { u32:size bytes }...
+//   u32:n_pipelines {
+//     str:name
+//     u32:n_inputs  { str:name value }...
+//     u32:n_outputs { str:name value }...
+//     u32:n_nodes   { str:name str:func i32:priority u8:side_effect
+//                     u32:n_args { u32:idx value }... }...
+//     u32:n_layers  { u32:n_nodes { str:node }... }...
+//     u32:n_links   { str:src_node u32:src_arg str:dst_node u32:dst_arg }...
+//   }...
+// where `str` is an index of the string table, and `value` is
+//   str:type u8:encoding u32:size bytes
+constexpr char kBinaryMagic[] = "FASEPIPE";
+constexpr std::uint32_t kBinaryVersion = 1;
+
+namespace {
+
+enum class ValueEncoding : std::uint8_t {
+    Empty = 0,
+    Text = 1,   // TypeStringConverters::serializer
+    Binary = 2, // TypeStringConverters::encoder
+};
+
+class BinaryWriter {
+public:
+    void u8(std::uint8_t v) {
+        body += char(v);
+    }
+    void u32(std::uint32_t v) {
+        put32(v, &body);
+    }
+    void i32(std::int32_t v) {
+        u32(std::uint32_t(v));
+    }
+    void str(const string& s) {
+        auto [it, inserted] = str_idxs.emplace(s, strs.size());
+        if (inserted) {
+            strs.emplace_back(&it->first);
+        }
+        u32(it->second);
+    }
+    void bytes(const string& s) {
+        u32(std::uint32_t(s.size()));
+        body += s;
+    }
+    // Write the bytes appended by `append(&buffer)`, following their size.
+    template <typename Append>
+    void sized(Append&& append) {
+        const size_t size_pos = body.size();
+        u32(0);
+        append(&body);
+        const auto size = std::uint32_t(body.size() - size_pos - 4);
+        for (int i = 0; i < 4; i++) {
+            body[size_pos + size_t(i)] = char((size >> (8 * i)) & 0xff);
+        }
+    }
+
+    string finish() const {
+        string dst(kBinaryMagic, sizeof(kBinaryMagic) - 1);
+        put32(kBinaryVersion, &dst);
+        put32(std::uint32_t(strs.size()), &dst);
+        for (auto s : strs) {
+            put32(std::uint32_t(s->size()), &dst);
+            dst += *s;
+        }
+        return dst + body;
+    }
+
+private:
+    string body;
+    map<string, std::uint32_t> str_idxs;
+    vector<const string*> strs;
+
+    static void put32(std::uint32_t v, string* dst) {
+        for (int i = 0; i < 4; i++) {
+            *dst += char((v >> (8 * i)) & 0xff);
+        }
+    }
+};
+
+class BinaryReader {
+public:
+    BinaryReader(const char* data, size_t size)
+        : p(reinterpret_cast<const unsigned char*>(data)), end(p + size) {}
+
+    bool readHeader() {
+        const size_t magic_size = sizeof(kBinaryMagic) - 1;
+        if (size_t(end - p) < magic_size ||
+            std::memcmp(p, kBinaryMagic, magic_size) != 0) {
+            return fail("not a binary pipeline");
+        }
+        p += magic_size;
+        if (u32() != kBinaryVersion) {
+            return fail("unsupported version");
+        }
+        strs.resize(u32());
+        for (auto& s : strs) {
+            s = bytes();
+        }
+        return ok;
+    }
+
+    std::uint8_t u8() {
+        if (!has(1)) return 0;
+        return *p++;
+    }
+    std::uint32_t u32() {
+        if (!has(4)) return 0;
+        std::uint32_t v = 0;
+        for (int i = 0; i < 4; i++) {
+            v |= std::uint32_t(*p++) << (8 * i);
+        }
+        return v;
+    }
+    std::int32_t i32() {
+        return std::int32_t(u32());
+    }
+    const string& str() {
+        static const string empty;
+        std::uint32_t idx = u32();
+        if (idx >= strs.size()) {
+            fail("invalid string index");
+            return empty;
+        }
+        return strs[idx];
+    }
+    string bytes() {
+        std::uint32_t size = u32();
+        if (!has(size)) return {};
+        string dst(reinterpret_cast<const char*>(p), size);
+        p += size;
+        return dst;
+    }
+    // Count of elements, which needs at least a byte for each.
+    std::uint32_t count() {
+        std::uint32_t n = u32();
+        return has(n) ? n : 0;
+    }
+
+    bool fail(const string& msg) {
+        if (ok) {
+            error = msg;
+            ok = false;
+        }
+        return false;
+    }
+
+    bool ok = true;
+    string error;
+
+private:
+    const unsigned char* p;
+    const unsigned char* end;
+    vector<string> strs;
+
+    bool has(size_t n) {
+        if (ok && size_t(end - p) >= n) {
+            return true;
+        }
+        fail("unexpected end of data");
+        return false;
+    }
+};
+
+bool IsWritable(const Variable& v, const TSCMap& tsc_map) {
+    auto it = tsc_map.find(v.getType());
+    return it != tsc_map.end() &&
+           (it->second.encoder || it->second.serializer);
+}
+
+void WriteValue(const Variable& v, const TypeStringConverters& tsc,
+                BinaryWriter* writer) {
+    writer->str(tsc.name);
+    if (!v) {
+        writer->u8(std::uint8_t(ValueEncoding::Empty));
+        writer->bytes("");
+    } else if (tsc.encoder) {
+        writer->u8(std::uint8_t(ValueEncoding::Binary));
+        writer->sized([&](string* dst) { tsc.encoder(v, dst); });
+    } else {
+        writer->u8(std::uint8_t(ValueEncoding::Text));
+        writer->sized([&](string* dst) { tsc.serializeTo(v, dst); });
+    }
+}
+
+bool ReadValue(BinaryReader* reader, const TSCMap& tsc_map, Variable* v) {
+    const string& type = reader->str();
+    auto encoding = ValueEncoding(reader->u8());
+    const string data = reader->bytes();
+    if (!reader->ok) {
+        return false;
+    }
+    for (auto& [t, tsc] : tsc_map) {
+        if (tsc.name != type) {
+            continue;
+        }
+        if (encoding == ValueEncoding::Empty) {
+            *v = Variable{t};
+        } else if (encoding == ValueEncoding::Text && tsc.deserializer) {
+            tsc.deserializer(*v, data);
+        } else if (encoding == ValueEncoding::Binary && tsc.decoder) {
+            tsc.decoder(*v, data);
+        } else {
+            return reader->fail("unknown encoding of " + type);
+        }
+        return true;
+    }
+    return reader->fail("unknown type " + type);
+}
+
+void WriteInOutput(const Node& node, const vector<string>& arg_names,
+                   const TSCMap& tsc_map, BinaryWriter* writer) {
+    vector<size_t> idxs;
+    for (size_t i = 0; i < node.args.size(); i++) {
+        if (IsWritable(node.args[i], tsc_map)) {
+            idxs.emplace_back(i);
+        }
+    }
+    writer->u32(std::uint32_t(idxs.size()));
+    for (size_t i : idxs) {
+        writer->str(arg_names[i]);
+        WriteValue(node.args[i], tsc_map.at(node.args[i].getType()), writer);
+    }
+}
+
+void WritePipeline(const PipelineAPI& pipe, const TSCMap& tsc_map,
+                   BinaryWriter* writer) {
+    auto f_util_map = pipe.getFunctionUtils();
+    auto& nodes = pipe.getNodes();
+
+    WriteInOutput(nodes.at(InputNodeName()),
+                  f_util_map[kInputFuncName].arg_names, tsc_map, writer);
+    WriteInOutput(nodes.at(OutputNodeName()),
+                  f_util_map[kOutputFuncName].arg_names, tsc_map, writer);
+
+    writer->u32(std::uint32_t(nodes.size() - 2));
+    for (auto& [n_name, node] : nodes) {
+        if (n_name == InputNodeName() || n_name == OutputNodeName()) {
+            continue;
+        }
+        writer->str(n_name);
+        writer->str(node.func_name);
+        writer->i32(node.priority);
+        writer->u8(node.side_effect);
+        vector<size_t> idxs;
+        for (size_t i = 0; i < node.args.size(); i++) {
+            if (IsWritable(node.args[i], tsc_map)) {
+                idxs.emplace_back(i);
+            }
+        }
+        writer->u32(std::uint32_t(idxs.size()));
+        for (size_t i : idxs) {
+            writer->u32(std::uint32_t(i));
+            WriteValue(node.args[i], tsc_map.at(node.args[i].getType()),
+                       writer);
+        }
+    }
+
+    auto order = GetRunOrder(nodes, pipe.getLinks());
+    writer->u32(std::uint32_t(order.size()));
+    for (auto& layer : order) {
+        writer->u32(std::uint32_t(layer.size()));
+        for (auto& n_name : layer) {
+            writer->str(n_name);
+        }
+    }
+
+    writer->u32(std::uint32_t(pipe.getLinks().size()));
+    for (auto& link : pipe.getLinks()) {
+        writer->str(link.src_node);
+        writer->u32(std::uint32_t(link.src_arg));
+        writer->str(link.dst_node);
+        writer->u32(std::uint32_t(link.dst_arg));
+    }
+}
+
+bool ReadInOutput(BinaryReader* reader, const string& n_name,
+                  PipelineAPI& pipe_api, const TSCMap& tsc_map) {
+    vector<string> arg_names;
+    vector<Variable> vars;
+    for (std::uint32_t i = reader->count(); i > 0; i--) {
+        arg_names.emplace_back(reader->str());
+        if (!ReadValue(reader, tsc_map, &vars.emplace_back())) {
+            return false;
+        }
+    }
+    bool ok = n_name == InputNodeName() ? pipe_api.supposeInput(arg_names)
+                                        : pipe_api.supposeOutput(arg_names);
+    if (!ok) {
+        return reader->fail("invalid arguments of " + n_name);
+    }
+    for (size_t i = 0; i < vars.size(); i++) {
+        pipe_api.setArgument(n_name, i, vars[i]);
+    }
+    return true;
+}
+
+bool ReadPipeline(BinaryReader* reader, PipelineAPI& pipe_api,
+                  const TSCMap& tsc_map) {
+    if (!ReadInOutput(reader, InputNodeName(), pipe_api, tsc_map) ||
+        !ReadInOutput(reader, OutputNodeName(), pipe_api, tsc_map)) {
+        return false;
+    }
+
+    for (std::uint32_t n = reader->count(); n > 0; n--) {
+        const string& n_name = reader->str();
+        const string& f_name = reader->str();
+        int priority = reader->i32();
+        bool side_effect = reader->u8() != 0;
+        // Nodes may be left without functions.
+        if (!reader->ok || !pipe_api.newNode(n_name) ||
+            (!f_name.empty() && !pipe_api.allocateFunc(f_name, n_name))) {
+            return reader->fail("failed to make node " + n_name);
+        }
+        pipe_api.setPriority(n_name, priority);
+        pipe_api.setSideEffect(n_name, side_effect);
+        for (std::uint32_t i = reader->count(); i > 0; i--) {
+            size_t idx = reader->u32();
+            Variable v;
+            if (!ReadValue(reader, tsc_map, &v)) {
+                return false;
+            }
+            if (!pipe_api.setArgument(n_name, idx, v)) {
+                return reader->fail("invalid argument of " + n_name);
+            }
+        }
+    }
+
+    vector<vector<string>> order(reader->count());
+    for (auto& layer : order) {
+        for (std::uint32_t i = reader->count(); i > 0; i--) {
+            layer.emplace_back(reader->str());
+        }
+    }
+    vector<Link> links(reader->count());
+    for (auto& link : links) {
+        link.src_node = reader->str();
+        link.src_arg = reader->u32();
+        link.dst_node = reader->str();
+        link.dst_arg = reader->u32();
+    }
+    if (!reader->ok || !pipe_api.setLinks(links, order)) {
+        return reader->fail("invalid links");
+    }
+    return true;
+}
+
+// `p_name` following the pipelines called by it.
+vector<string> WithSubPipelines(const string& p_name, const CoreManager& cm) {
+    vector<string> p_names;
+    for (auto& layer : cm.getDependingTree().getDependenceLayer(p_name)) {
+        Extend(layer, &p_names);
+    }
+    std::reverse(p_names.begin(), p_names.end());
+    p_names.emplace_back(p_name);
+    return p_names;
+}
+
+string PipelinesToBinary(const vector<string>& p_names, const CoreManager& cm,
+                         const TSCMap& tsc_map) {
+    BinaryWriter writer;
+    writer.u32(std::uint32_t(p_names.size()));
+    for (auto& name : p_names) {
+        writer.str(name);
+        WritePipeline(cm[name], tsc_map, &writer);
+    }
+    return writer.finish();
+}
+
+} // namespace
+
+std::string PipelineToBinary(const string& p_name, const CoreManager& cm,
+                             const TSCMap& tsc_map) {
+    // Sub pipelines first, as PipelineToString().
+    return PipelinesToBinary(WithSubPipelines(p_name, cm), cm, tsc_map);
+}
+
+std::string AllPipelinesToBinary(const CoreManager& cm,
+                                 const TSCMap& tsc_map) {
+    vector<string> p_names;
+    std::set<string> added;
+    for (auto& p_name : cm.getPipelineNames()) {
+        for (auto& name : WithSubPipelines(p_name, cm)) {
+            if (added.emplace(name).second) {
+                p_names.emplace_back(name);
+            }
+        }
+    }
+    return PipelinesToBinary(p_names, cm, tsc_map);
+}
+
+bool LoadPipelineFromBinary(const char* data, size_t size, CoreManager* pcm,
+                            const TSCMap& tsc_map) {
+    BinaryReader reader(data, size);
+    try {
+        if (reader.readHeader()) {
+            for (std::uint32_t n = reader.count(); n > 0; n--) {
+                const string& p_name = reader.str();
+                if (!reader.ok) {
+                    break;
+                }
+                // Inputs and outputs are passed to other pipelines at once.
+                PipelineAPI& pipe_api = (*pcm)[p_name];
+                pipe_api.beginBatch();
+                bool ok = ReadPipeline(&reader, pipe_api, tsc_map);
+                pipe_api.commit();
+                if (!ok) {
+                    break;
+                }
+            }
+        }
+    } catch (std::exception& e) {
+        // thrown by deserializers.
+        reader.fail(e.what());
+    }
+    if (!reader.ok) {
+        std::cerr << "LoadPipelineFromBinary Error : " << reader.error
+                  << std::endl;
+    }
+    return reader.ok;
+}
+
+} // namespace fase
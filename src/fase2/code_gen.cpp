@@ -1,9 +1,11 @@
 
 #include "common.h"
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <iostream>
+#include <set>
 #include <sstream>
 #include <vector>
 
@@ -195,12 +197,65 @@ std::string genVarDeclaration(const std::string& type_repr,
 }
 
 string getValStr(const Variable& v, const TSCMapW& tsc_map) {
-    if (!tsc_map.count(v.getType()) || !v) {
+    if (!tsc_map.count(v.getType()) || !v ||
+        !tsc_map.at(v.getType()).def_maker) {
         return "";
     }
     return tsc_map.at(v.getType()).def_maker(v);
 }
 
+bool isSettableObject(const FunctionUtils& utils) {
+    return isFunctionObject(utils) && !isConstructableObject(utils);
+}
+
+// Split "Ret(T1, T2, ...)" or "(T1, T2, ...)" into {"T1", "T2", ...}.
+vector<string> SplitArgTypesRepr(const string& arg_types_repr) {
+    vector<string> dst;
+    auto begin = arg_types_repr.find('(');
+    if (begin == string::npos) {
+        return dst;
+    }
+    string buf;
+    int depth = 0;
+    for (size_t i = begin + 1; i < arg_types_repr.size(); i++) {
+        const char c = arg_types_repr[i];
+        if (depth == 0 && (c == ',' || c == ')')) {
+            auto b = buf.find_first_not_of(' ');
+            auto e = buf.find_last_not_of(' ');
+            if (b != string::npos) {
+                dst.emplace_back(buf.substr(b, e - b + 1));
+            }
+            buf.clear();
+            if (c == ')') {
+                break;
+            }
+            continue;
+        }
+        if (c == '<' || c == '(' || c == '[' || c == '{') {
+            depth++;
+        } else if (c == '>' || c == ')' || c == ']' || c == '}') {
+            depth--;
+        }
+        buf += c;
+    }
+    return dst;
+}
+
+// Returns whether each argument can be moved into (by value or rvalue
+// reference). Returns all false if the types are unknown.
+vector<bool> GetMovableArgs(const FunctionUtils& func, size_t n_args) {
+    auto types = SplitArgTypesRepr(func.arg_types_repr);
+    if (types.size() != n_args) {
+        return vector<bool>(n_args, false);
+    }
+    vector<bool> dst;
+    for (auto& type : types) {
+        dst.emplace_back(type.back() != '&' ||
+                         (type.size() > 1 && type[type.size() - 2] == '&'));
+    }
+    return dst;
+}
+
 void genFuncDeclaration(MyStream& code_stream,
                         map<std::string, int>& lv_counter,
                         const map<ArgID, string>& var_names,
@@ -248,87 +303,297 @@ void genFuncDeclaration(MyStream& code_stream,
     code_stream << ") ";
 }
 
-bool genNodeCode(MyStream& native_code, map<std::string, int>& lv_counter,
-                 const map<ArgID, string>& var_names, const string& n_name,
-                 const string& p_name, const TSCMapW& tsc_map,
-                 const map<string, Node>& nodes, const FunctionUtils& func) {
-    const string& func_name = nodes.at(n_name).func_name;
+// Local variables of a generated function.
+struct LocalVars {
+    map<ArgID, string> names;
+    map<string, int> counter;
+    // Index of the statement which uses the variable last.
+    map<string, size_t> last_uses;
+    // Output argument referred by the variable, not to copy it at the end.
+    map<string, string> out_aliases;
+    // Variables which must not be moved (e.g. const input arguments).
+    std::set<string> pinned;
+};
 
-    // Add comment
-    native_code << "// " << func_name << " [" << n_name << "]" << endl;
+size_t getArgLen(const FunctionUtils& func) {
+    return func.arg_names.size() -
+           size_t(!func.arg_names.empty() &&
+                  func.arg_names.back() == kReturnValueID);
+}
 
-    int len_arg = func.arg_names.size() -
-                  int(func.arg_names.back() == kReturnValueID);
-    for (int i = 0; i < len_arg; i++) {
-        string var_name = var_names.at({n_name, i});
-        if (!(lv_counter[var_name]++)) {
-            string type_str = tsc_map.at(func.arg_types[i]).name;
-            string val_str = getValStr(nodes.at(n_name).args[i], tsc_map);
+// Declare variables first used by the node, and returns the left hand side
+// of the assignment of its return value.
+string genNodeDeclarations(MyStream& native_code, LocalVars& lvs,
+                           const string& n_name, const TSCMapW& tsc_map,
+                           const map<string, Node>& nodes,
+                           const FunctionUtils& func) {
+    auto declare = [&](const string& var_name, const string& type_str,
+                       const string& val_str) {
+        if (lvs.out_aliases.count(var_name)) {
+            // Construct the output in place.
+            native_code << type_str << "& " << var_name << " = "
+                        << lvs.out_aliases.at(var_name) << ";" << endl;
+            if (!val_str.empty()) {
+                native_code << var_name << " = " << val_str << ";" << endl;
+            }
+        } else {
             native_code << genVarDeclaration(type_str, val_str, var_name)
                         << endl;
         }
+    };
+
+    const size_t len_arg = getArgLen(func);
+    for (size_t i = 0; i < len_arg; i++) {
+        string var_name = lvs.names.at({n_name, i});
+        if (!(lvs.counter[var_name]++)) {
+            string type_str = tsc_map.at(func.arg_types[i]).name;
+            string val_str = getValStr(nodes.at(n_name).args[i], tsc_map);
+            declare(var_name, type_str, val_str);
+        }
     }
-    if (func.arg_names.back() == kReturnValueID) {
-        string var_name = var_names.at({n_name, len_arg});
-        if (!(lv_counter[var_name]++)) {
-            std::string type_str = tsc_map.at(func.arg_types.back()).name;
-            native_code << type_str << " ";
+    if (len_arg == func.arg_names.size()) {
+        return "";
+    }
+    string var_name = lvs.names.at({n_name, len_arg});
+    if (!(lvs.counter[var_name]++)) {
+        std::string type_str = tsc_map.at(func.arg_types.back()).name;
+        if (lvs.out_aliases.count(var_name)) {
+            declare(var_name, type_str, "");
+        } else {
+            return type_str + " " + var_name + " = ";
         }
-        native_code << var_name << " = ";
     }
+    return var_name + " = ";
+}
 
-    if (isFunctionObject(func)) {
-        native_code << toEnumValueName(n_name, p_name);
+string genCallExpr(const LocalVars& lvs, const size_t stmt_idx,
+                   const string& n_name, const string& p_name,
+                   const map<string, Node>& nodes, const FunctionUtils& func,
+                   const NativeCodeOptions& options) {
+    std::stringstream ss;
+    if (options.timing) {
+        ss << "FaseTimed(" << stmt_idx << ", [&] { return ";
+    }
+    if (isSettableObject(func) && func.callable_type) {
+        ss << "(*" << toEnumValueName(n_name, p_name) << ")";
+    } else if (isFunctionObject(func)) {
+        ss << toEnumValueName(n_name, p_name);
     } else {
-        native_code << func_name;
+        ss << nodes.at(n_name).func_name;
+    }
+    ss << "(";
+
+    // Move variables at their last uses, if the function takes them by value.
+    const size_t len_arg = getArgLen(func);
+    const vector<bool> movables = GetMovableArgs(func, len_arg);
+    map<string, int> n_uses;
+    for (size_t i = 0; i < len_arg; i++) {
+        n_uses[lvs.names.at({n_name, i})]++;
     }
-    native_code << "(";
-    for (int i = 0; i < len_arg; i++) {
-        native_code << var_names.at({n_name, i});
+    for (size_t i = 0; i < len_arg; i++) {
+        const string& var_name = lvs.names.at({n_name, i});
+        if (movables[i] && func.is_input_args[i] && n_uses[var_name] == 1 &&
+            lvs.last_uses.at(var_name) == stmt_idx &&
+            !lvs.pinned.count(var_name) && !lvs.out_aliases.count(var_name)) {
+            ss << "std::move(" << var_name << ")";
+        } else {
+            ss << var_name;
+        }
         if (i != len_arg - 1) {
-            native_code << ", ";
+            ss << ", ";
         }
     }
-    native_code << ");" << endl;
+    ss << ")";
+    if (options.timing) {
+        ss << "; })";
+    }
+    return ss.str();
+}
+
+bool genNodeCode(MyStream& native_code, LocalVars& lvs, const size_t stmt_idx,
+                 const string& n_name, const string& p_name,
+                 const TSCMapW& tsc_map, const map<string, Node>& nodes,
+                 const FunctionUtils& func, const NativeCodeOptions& options) {
+    // Add comment
+    native_code << "// " << nodes.at(n_name).func_name << " [" << n_name << "]"
+                << endl;
+    native_code << genNodeDeclarations(native_code, lvs, n_name, tsc_map, nodes,
+                                       func)
+                << genCallExpr(lvs, stmt_idx, n_name, p_name, nodes, func,
+                               options)
+                << ";" << endl;
     return true;
 }
 
+bool isCostlyNode(const string& n_name, const NativeCodeOptions& options) {
+    if (options.profile == nullptr ||
+        !options.profile->child_reports.count(n_name)) {
+        return true;
+    }
+    return options.profile->child_reports.at(n_name).execution_time >=
+           options.parallel_threshold;
+}
+
+// Generate nodes of a layer, which are independent of each other. Costly ones
+// but the last are run with std::async, and the others are run inline.
+void genLayerCode(MyStream& native_code, LocalVars& lvs,
+                  const vector<string>& node_order, const size_t begin,
+                  const size_t end, const string& p_name,
+                  const TSCMapW& tsc_map, const map<string, Node>& nodes,
+                  const map<string, FunctionUtils>& functions,
+                  const NativeCodeOptions& options) {
+    vector<size_t> tasks;
+    for (size_t i = begin; i < end; i++) {
+        if (isCostlyNode(node_order[i], options)) {
+            tasks.emplace_back(i);
+        }
+    }
+    if (!tasks.empty()) {
+        tasks.pop_back();
+    }
+
+    vector<string> lhs(tasks.size());
+    for (size_t t = 0; t < tasks.size(); t++) {
+        const string& n_name = node_order[tasks[t]];
+        auto& func = functions.at(nodes.at(n_name).func_name);
+        native_code << "// " << nodes.at(n_name).func_name << " [" << n_name
+                    << "] (async)" << endl;
+        lhs[t] = genNodeDeclarations(native_code, lvs, n_name, tsc_map, nodes,
+                                     func);
+        native_code << "auto " << n_name
+                    << "_task = std::async(std::launch::async, [&] { return "
+                    << genCallExpr(lvs, tasks[t], n_name, p_name, nodes, func,
+                                   options)
+                    << "; });" << endl;
+    }
+    for (size_t i = begin; i < end; i++) {
+        if (!exists(i, tasks)) {
+            const string& n_name = node_order[i];
+            genNodeCode(native_code, lvs, i, n_name, p_name, tsc_map, nodes,
+                        functions.at(nodes.at(n_name).func_name), options);
+        }
+    }
+    for (size_t t = 0; t < tasks.size(); t++) {
+        native_code << lhs[t] << node_order[tasks[t]] << "_task.get();"
+                    << endl;
+    }
+}
+
+// Nodes but Input/Output in run order. `layer_ends` is the end of each layer.
+vector<string> GetNodeOrder(const PipelineAPI& papi,
+                            vector<size_t>* layer_ends) {
+    vector<string> node_order;
+    for (auto& layer : GetRunOrder(papi.getNodes(), papi.getLinks())) {
+        for (auto& n_name : layer) {
+            if (n_name != InputNodeName() && n_name != OutputNodeName()) {
+                node_order.emplace_back(n_name);
+            }
+        }
+        if (layer_ends->empty() || layer_ends->back() != node_order.size()) {
+            layer_ends->emplace_back(node_order.size());
+        }
+    }
+    return node_order;
+}
+
 bool genFunctionCode(MyStream& native_code, const string& p_name,
                      const CoreManager& cm, const TSCMapW& tsc_map,
-                     const string& entry_name) {
+                     const string& entry_name,
+                     const NativeCodeOptions& options) {
     auto functions = cm.getFunctionUtils(p_name);
     auto& nodes = cm[p_name].getNodes();
-    auto& links = cm[p_name].getLinks();
-    // Stack for finding runnable node
-    auto node_order = GetRunOrder(nodes, links);
+    vector<size_t> layer_ends;
+    const vector<string> node_order = GetNodeOrder(cm[p_name], &layer_ends);
 
     string pipe_func_name = entry_name;
     if (pipe_func_name.empty()) {
         pipe_func_name = "Pipeline";
     }
 
-    map<ArgID, string> var_names = GenLocalValueName(cm[p_name]);
-    std::map<std::string, int> lv_counter;
+    LocalVars lvs;
+    lvs.names = GenLocalValueName(cm[p_name]);
+    for (auto& [arg_id, var_name] : lvs.names) {
+        if (std::get<0>(arg_id) == InputNodeName()) {
+            lvs.pinned.insert(var_name);
+        }
+    }
+    for (size_t i = 0; i < node_order.size(); i++) {
+        const Node& node = nodes.at(node_order[i]);
+        for (size_t j = 0; j < node.args.size(); j++) {
+            lvs.last_uses[lvs.names.at({node_order[i], j})] = i;
+        }
+    }
+    if (options.parallel) {
+        // Not to move a variable read by another node in parallel.
+        size_t begin = 0;
+        for (size_t end : layer_ends) {
+            map<string, std::set<size_t>> users;
+            for (size_t i = begin; i < end; i++) {
+                for (size_t j = 0; j < nodes.at(node_order[i]).args.size();
+                     j++) {
+                    users[lvs.names.at({node_order[i], j})].insert(i);
+                }
+            }
+            for (auto& [var_name, idxs] : users) {
+                if (idxs.size() > 1 &&
+                    lvs.last_uses.at(var_name) == *idxs.rbegin()) {
+                    lvs.pinned.insert(var_name);
+                }
+            }
+            begin = end;
+        }
+    }
+
+    const size_t n_outputs = functions.at(kOutputFuncName).arg_names.size();
+    vector<string> out_roots(n_outputs);
+    for (size_t i = 0; i < n_outputs; i++) {
+        out_roots[i] = lvs.names.at(
+                SearchRootNodeArg(cm[p_name], OutputNodeName(), i));
+        if (!lvs.pinned.count(out_roots[i]) &&
+            !lvs.out_aliases.count(out_roots[i])) {
+            lvs.out_aliases[out_roots[i]] = lvs.names.at({OutputNodeName(), i});
+        } else {
+            lvs.last_uses[out_roots[i]] = node_order.size() + i;
+        }
+    }
 
-    genFuncDeclaration(native_code, lv_counter, var_names, pipe_func_name,
+    genFuncDeclaration(native_code, lvs.counter, lvs.names, pipe_func_name,
                        nodes, functions, tsc_map);
     native_code << "{" << uil << endl;
+    if (options.timing) {
+        native_code << "const FaseTimer fase_timer{" << node_order.size()
+                    << "};" << endl;
+    }
 
-    for (auto& n_name : to1dim(node_order)) {
-        if (n_name == InputNodeName() || n_name == OutputNodeName()) {
-            continue;
+    if (options.parallel) {
+        size_t begin = 0;
+        for (size_t end : layer_ends) {
+            genLayerCode(native_code, lvs, node_order, begin, end, p_name,
+                         tsc_map, nodes, functions, options);
+            begin = end;
+        }
+    } else {
+        for (size_t i = 0; i < node_order.size(); i++) {
+            const string& n_name = node_order[i];
+            genNodeCode(native_code, lvs, i, n_name, p_name, tsc_map, nodes,
+                        functions.at(nodes.at(n_name).func_name), options);
         }
-        genNodeCode(native_code, lv_counter, var_names, n_name, p_name, tsc_map,
-                    nodes, functions.at(nodes.at(n_name).func_name));
     }
 
-    for (size_t i = 0; i < functions.at(kOutputFuncName).arg_names.size();
-         i++) {
-        native_code
-                << endl
-                << var_names[{OutputNodeName(), i}] << " = "
-                << var_names[SearchRootNodeArg(cm[p_name], OutputNodeName(), i)]
-                << ";";
+    for (size_t i = 0; i < n_outputs; i++) {
+        const string& out_name = lvs.names.at({OutputNodeName(), i});
+        if (lvs.out_aliases.count(out_roots[i]) &&
+            lvs.out_aliases.at(out_roots[i]) == out_name) {
+            continue; // Constructed in place.
+        }
+        native_code << endl << out_name << " = ";
+        if (lvs.last_uses.at(out_roots[i]) == node_order.size() + i &&
+            !lvs.pinned.count(out_roots[i]) &&
+            !lvs.out_aliases.count(out_roots[i])) {
+            native_code << "std::move(" << out_roots[i] << ");";
+        } else {
+            native_code << out_roots[i] << ";";
+        }
     }
 
     native_code << dil << endl << "}";
@@ -373,6 +638,15 @@ void GenFunctionArrays(MyStream& native_code,
                             << " " << toEnumValueName(vs[i].node, vs[i].pipe)
                             << " = " << f_utils.at(f_name).repr << ";" << endl;
             }
+        } else if (f_utils.at(f_name).callable_type) {
+            const string type = type_name(*f_utils.at(f_name).callable_type);
+            native_code << "std::array<std::optional<" << type << ">, "
+                        << vs.size() << "> " << f_name << "s;" << endl;
+            for (size_t i = 0; i < vs.size(); i++) {
+                native_code << "std::optional<" << type << ">& "
+                            << toEnumValueName(vs[i].node, vs[i].pipe) << " = "
+                            << f_name << "s[" << i << "];" << endl;
+            }
         } else {
             native_code << "std::array<std::function<"
                         << f_utils.at(f_name).arg_types_repr << ">, "
@@ -400,17 +674,92 @@ void GenSetters(MyStream& native_code,
                     << ") {" << uil << endl;
         native_code << "for (int i = 0; i < " << vs.size() << "; i++) {" << uil
                     << endl;
-        native_code << f_name << "s[i] = " << f_name << ";";
+        if (f_utils.at(f_name).callable_type) {
+            native_code << f_name << "s[i].emplace(" << f_name << ");";
+        } else {
+            native_code << f_name << "s[i] = " << f_name << ";";
+        }
         native_code << dil << endl << "}";
         native_code << dil << endl << "}" << endl << endl;
     }
 }
 
+// Write lines of `text` at the current indent level.
+void WriteLines(MyStream& native_code, const string& text) {
+    std::stringstream ss(text);
+    string line;
+    while (std::getline(ss, line)) {
+        native_code << line << endl;
+    }
+}
+
+void GenTimingTable(MyStream& native_code, const vector<string>& node_order) {
+    const size_t n = node_order.size();
+    native_code << "// Execution times of the nodes, and of the whole at last."
+                << endl;
+    native_code << "static inline std::array<std::atomic<long long>, " << n + 1
+                << "> fase_times;" << endl;
+    native_code << "static inline std::array<std::atomic<long long>, " << n + 1
+                << "> fase_counts;" << endl;
+    native_code << "static constexpr std::array<const char*, " << n
+                << "> fase_node_names = {{";
+    for (size_t i = 0; i < n; i++) {
+        native_code << (i == 0 ? "" : ", ") << "\"" << node_order[i] << "\"";
+    }
+    native_code << "}};" << endl << endl;
+    WriteLines(native_code, R"(struct FaseTimer {
+    std::size_t idx;
+    std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+    ~FaseTimer() {
+        const auto time = std::chrono::steady_clock::now() - start;
+        fase_times[idx] +=
+                std::chrono::duration_cast<std::chrono::nanoseconds>(time)
+                        .count();
+        fase_counts[idx]++;
+    }
+};
+
+template <class F>
+static decltype(auto) FaseTimed(std::size_t idx, F&& f) {
+    const FaseTimer timer{idx};
+    return f();
+}
+)");
+}
+
+void GenTimingDump(MyStream& native_code) {
+    native_code << "// Mean times of the nodes as fase::ReportToString()."
+                << endl;
+    WriteLines(native_code, R"(static std::string FaseDumpReport() {
+    auto mean = [](std::size_t i) {
+        const long long n = fase_counts[i];
+        return std::to_string(n == 0 ? 0 : fase_times[i] / n);
+    };
+    std::string dst = "{\"child_reports\": {";
+    for (std::size_t i = 0; i < fase_node_names.size(); i++) {
+        dst += std::string(i == 0 ? "" : ", ") + "\"" + fase_node_names[i] +
+               "\": {\"child_reports\": {}, \"execution_time\": " +
+               mean(i) + "}";
+    }
+    return dst + "}, \"execution_time\": " + mean(fase_node_names.size()) +
+           "}";
+}
+
+static void FaseResetStats() {
+    for (std::size_t i = 0; i < fase_times.size(); i++) {
+        fase_times[i] = 0;
+        fase_counts[i] = 0;
+    }
+}
+)");
+}
+
 } // namespace
 
 string GenNativeCode(const string& p_name, const CoreManager& cm,
                      const TSCMap& tsc_map, const string& entry_name,
-                     const string& indent) {
+                     const string& indent, const NativeCodeOptions& options) {
 
     MyStream native_code{indent};
     TSCMapW tsc_map_wraped(tsc_map);
@@ -427,23 +776,37 @@ string GenNativeCode(const string& p_name, const CoreManager& cm,
         auto non_pure_node_map = GetNonPureNodeMap(pipes, cm);
         GenFunctionArrays(native_code, non_pure_node_map,
                           cm.getFunctionUtils(p_name));
+        if (options.timing) {
+            vector<size_t> layer_ends;
+            GenTimingTable(native_code, GetNodeOrder(cm[p_name], &layer_ends));
+        }
 
         native_code << endl;
 
         // write sub pipeline function Definitions.
+        // (The profile is of the main pipeline, and sub pipelines run inline.)
+        NativeCodeOptions sub_options = options;
+        sub_options.parallel = false;
+        sub_options.profile = nullptr;
+        sub_options.timing = false;
         for (auto iter = sub_pipes.rbegin(); iter != sub_pipes.rend(); iter++) {
             for (auto& sub_pipe_name : *iter) {
                 genFunctionCode(native_code, sub_pipe_name, cm, tsc_map_wraped,
-                                sub_pipe_name);
+                                sub_pipe_name, sub_options);
                 native_code << endl << endl;
             }
         }
         native_code << dil << endl << "public:" << uil << endl;
 
         GenSetters(native_code, non_pure_node_map, cm.getFunctionUtils(p_name));
+        if (options.timing) {
+            GenTimingDump(native_code);
+            native_code << endl;
+        }
 
         // write main pipeline function Definitions.
-        genFunctionCode(native_code, p_name, cm, tsc_map_wraped, "operator()");
+        genFunctionCode(native_code, p_name, cm, tsc_map_wraped, "operator()",
+                        options);
 
         native_code << dil << endl << "};";
 
@@ -463,4 +826,108 @@ string GenNativeCode(const string& p_name, const CoreManager& cm,
     }
 }
 
+string GenNativeBenchmarkCode(const string& p_name, const CoreManager& cm,
+                              const TSCMap& tsc_map, const string& entry_name,
+                              const string& prelude, bool per_node) {
+    MyStream code{"    "};
+    TSCMapW tsc_map_wraped(tsc_map);
+    try {
+        auto functions = cm.getFunctionUtils(p_name);
+        auto& nodes = cm[p_name].getNodes();
+
+        code << "#include <algorithm>" << endl
+             << "#include <chrono>" << endl
+             << "#include <cstdlib>" << endl
+             << "#include <iostream>" << endl
+             << endl
+             << prelude << endl
+             << endl;
+        code << "// Runs " << entry_name << " with the saved inputs, and "
+             << "prints the mean Report as JSON." << endl;
+        code << "int main(int argc, char* argv[]) {" << uil << endl;
+        code << "const int fase_n_iterations = argc > 1 ? std::atoi(argv[1]) "
+                ": 100;"
+             << endl;
+        code << entry_name << " fase_pipeline;" << endl;
+
+        vector<string> arg_names;
+        for (auto& f_name : {kInputFuncName, kOutputFuncName}) {
+            const string n_name = f_name == kInputFuncName ? InputNodeName()
+                                                           : OutputNodeName();
+            auto& func = functions.at(f_name);
+            for (size_t i = 0; i < func.arg_names.size(); i++) {
+                string type_str = tsc_map_wraped.at(func.arg_types[i]).name;
+                string val_str =
+                        getValStr(nodes.at(n_name).args[i], tsc_map_wraped);
+                code << genVarDeclaration(type_str,
+                                          val_str.empty() ? "{}" : val_str,
+                                          func.arg_names[i])
+                     << endl;
+                arg_names.emplace_back(func.arg_names[i]);
+            }
+        }
+        string call = "fase_pipeline(";
+        for (size_t i = 0; i < arg_names.size(); i++) {
+            call += (i == 0 ? "" : ", ") + arg_names[i];
+        }
+        call += ");";
+
+        code << endl << call << " // Warm up." << endl;
+        if (per_node) {
+            code << entry_name << "::FaseResetStats();" << endl;
+        } else {
+            code << "const auto fase_start = std::chrono::steady_clock::now();"
+                 << endl;
+        }
+        code << "for (int i = 0; i < fase_n_iterations; i++) {" << uil << endl
+             << call << dil << endl
+             << "}" << endl;
+        if (per_node) {
+            code << "std::cout << " << entry_name
+                 << "::FaseDumpReport() << std::endl;" << endl;
+        } else {
+            code << "const auto fase_time = "
+                    "std::chrono::duration_cast<std::chrono::nanoseconds>("
+                 << uil << uil << endl
+                 << "std::chrono::steady_clock::now() - fase_start);" << dil
+                 << dil << endl;
+            code << "std::cout << \"{\\\"child_reports\\\": {}, "
+                    "\\\"execution_time\\\": \"" << uil << uil << endl
+                 << "<< fase_time.count() / std::max(fase_n_iterations, 1) << "
+                    "\"}\" << std::endl;"
+                 << dil << dil << endl;
+        }
+        code << "return 0;" << dil << endl << "}" << endl;
+        return code.str();
+    } catch (std::exception& e) {
+        std::cerr << "GenNativeBenchmarkCode() Error : " << e.what()
+                  << std::endl;
+        return "";
+    }
+}
+
+string GenNativeBenchmarkCMake(const string& target,
+                               const vector<string>& sources) {
+    std::stringstream ss;
+    ss << "cmake_minimum_required(VERSION 3.8.2)" << std::endl
+       << "project(" << target << " CXX)" << std::endl
+       << std::endl
+       << "set(CMAKE_CXX_STANDARD 17)" << std::endl
+       << "if (NOT CMAKE_BUILD_TYPE)" << std::endl
+       << "    set(CMAKE_BUILD_TYPE Release)" << std::endl
+       << "endif()" << std::endl
+       << "find_package(Threads REQUIRED)" << std::endl
+       << std::endl
+       << "# Add sources of the functions used in the pipeline." << std::endl
+       << "add_executable(" << target;
+    for (auto& source : sources) {
+        ss << std::endl << "    " << source;
+    }
+    ss << std::endl
+       << ")" << std::endl
+       << "target_link_libraries(" << target << " Threads::Threads)"
+       << std::endl;
+    return ss.str();
+}
+
 } // namespace fase
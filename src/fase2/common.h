@@ -3,9 +3,11 @@
 #define COMMON_H_20190217
 
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "variable.h"
@@ -23,6 +25,10 @@ struct Report {
                1e-6f;
     }
 
+    // Calls answered by / added to MemoCache. (see Core::setMemoCache())
+    std::size_t memo_hits = 0;
+    std::size_t memo_misses = 0;
+
     std::map<std::string, Report> child_reports;
 };
 
@@ -33,6 +39,7 @@ struct Node {
     UnivFunc             func = [](auto&, auto) {};
     std::deque<Variable> args;
     int                  priority = 0;
+    bool                 side_effect = false;
 };
 
 struct Link {
@@ -77,6 +84,71 @@ class Core;
 
 class CoreManager;
 
+// Interned name of a node, which is looked up without the name. It stays
+// valid while the node is renamed, and in copies of the CoreManager, until
+// the node is deleted. (see PipelineAPI::findNode())
+// Core still keys its nodes, links and run plans by names, and edits by
+// handles pass the interned names to it.
+class NodeHandle {
+public:
+    static constexpr std::uint32_t kInvalidId = ~std::uint32_t(0);
+
+    NodeHandle() = default;
+
+    explicit operator bool() const noexcept {
+        return id != kInvalidId;
+    }
+    bool operator==(const NodeHandle& a) const noexcept {
+        return id == a.id;
+    }
+    bool operator!=(const NodeHandle& a) const noexcept {
+        return id != a.id;
+    }
+    bool operator<(const NodeHandle& a) const noexcept {
+        return id < a.id;
+    }
+
+private:
+    friend class CoreManager;
+    explicit NodeHandle(std::uint32_t id_) : id(id_) {}
+
+    std::uint32_t id = kInvalidId;
+};
+
+// Interned name of a function of a CoreManager. Functions are never removed,
+// so it stays valid. (see PipelineAPI::findFunction())
+class FunctionHandle {
+public:
+    static constexpr std::uint32_t kInvalidId = ~std::uint32_t(0);
+
+    FunctionHandle() = default;
+
+    explicit operator bool() const noexcept {
+        return id != kInvalidId;
+    }
+    bool operator==(const FunctionHandle& a) const noexcept {
+        return id == a.id;
+    }
+    bool operator!=(const FunctionHandle& a) const noexcept {
+        return id != a.id;
+    }
+    bool operator<(const FunctionHandle& a) const noexcept {
+        return id < a.id;
+    }
+
+private:
+    friend class CoreManager;
+    explicit FunctionHandle(std::uint32_t id_) : id(id_) {}
+
+    std::uint32_t id = kInvalidId;
+};
+
+// Argument of a node.
+struct PortHandle {
+    NodeHandle  node;
+    std::size_t arg;
+};
+
 class PipelineAPI {
 public:
     virtual ~PipelineAPI() {}
@@ -89,6 +161,9 @@ public:
     virtual bool setArgument(const std::string& node, std::size_t idx,
                              Variable& var) = 0;
     virtual bool setPriority(const std::string& node, int priority) = 0;
+    virtual bool setSideEffect(const std::string& node, bool side_effect) = 0;
+    // Keep outputs of the node on disk. (see Core::setCheckpoint())
+    virtual bool setCheckpoint(const std::string& node, bool enable) = 0;
 
     virtual bool allocateFunc(const std::string& work,
                               const std::string& node) = 0;
@@ -99,6 +174,18 @@ public:
                                     std::size_t        dst_arg) = 0;
     virtual bool          unlinkNode(const std::string& dst_node,
                                      std::size_t        dst_arg) = 0;
+    // Replace all links. `order` is their run order. (see Core::setLinks())
+    virtual bool
+    setLinks(const std::vector<Link>&                     links,
+             const std::vector<std::vector<std::string>>& order) = 0;
+
+    // Stage edits until commit(). Links are made at commit(), checked and
+    // sorted at once, and other pipelines see the new inputs and outputs then.
+    // Batches may be nested. commit() returns false if a staged link is
+    // invalid, which is reported and not made, while the others are still
+    // made. If they make a loop, none of them are made.
+    virtual void beginBatch() = 0;
+    virtual bool commit() = 0;
 
     virtual bool supposeInput(const std::vector<std::string>& arg_names) = 0;
     virtual bool supposeOutput(const std::vector<std::string>& arg_names) = 0;
@@ -110,6 +197,45 @@ public:
     virtual const std::map<std::string, Node>&   getNodes() const noexcept = 0;
     virtual const std::vector<Link>&             getLinks() const noexcept = 0;
     virtual std::map<std::string, FunctionUtils> getFunctionUtils() const = 0;
+
+    // Handles are invalid if not found, and their names are empty if invalid.
+    virtual NodeHandle         findNode(const std::string& name) const = 0;
+    virtual FunctionHandle     findFunction(const std::string& name) const = 0;
+    virtual const std::string& getName(NodeHandle node) const = 0;
+    virtual const std::string& getName(FunctionHandle func) const = 0;
+
+    // The same edits by handles, which fail with invalid handles.
+    bool renameNode(NodeHandle node, const std::string& new_name) {
+        return node && renameNode(getName(node), new_name);
+    }
+    bool delNode(NodeHandle node) {
+        return node && delNode(getName(node));
+    }
+    bool setArgument(NodeHandle node, std::size_t idx, Variable& var) {
+        return node && setArgument(getName(node), idx, var);
+    }
+    bool setPriority(NodeHandle node, int priority) {
+        return node && setPriority(getName(node), priority);
+    }
+    bool setSideEffect(NodeHandle node, bool side_effect) {
+        return node && setSideEffect(getName(node), side_effect);
+    }
+    bool setCheckpoint(NodeHandle node, bool enable) {
+        return node && setCheckpoint(getName(node), enable);
+    }
+    bool allocateFunc(FunctionHandle func, NodeHandle node) {
+        return func && node && allocateFunc(getName(func), getName(node));
+    }
+    LinkNodeError smartLink(PortHandle src, PortHandle dst) {
+        if (!src.node || !dst.node) {
+            return LinkNodeError::Another;
+        }
+        return smartLink(getName(src.node), src.arg, getName(dst.node),
+                         dst.arg);
+    }
+    bool unlinkNode(PortHandle dst) {
+        return dst.node && unlinkNode(getName(dst.node), dst.arg);
+    }
 };
 
 struct TypeStringConverters {
@@ -117,13 +243,41 @@ struct TypeStringConverters {
     using Deserializer = std::function<void(Variable&, const std::string&)>;
     using Checker = std::function<bool(const Variable&)>;
     using DefMaker = Serializer;
+    // Append the result of Serializer to the buffer. (optional)
+    using Appender = std::function<void(const Variable&, std::string*)>;
+    // Binary codec, preferred to the text if given. (optional)
+    // Encoder appends bytes to the buffer, and Decoder makes the value of the
+    // bytes. Decoder throws if the bytes are broken.
+    using Encoder = std::function<void(const Variable&, std::string*)>;
+    using Decoder = std::function<void(Variable&, std::string_view)>;
+    // Hash of the value for MemoCache. (optional, the bytes of Encoder are
+    // hashed if not given)
+    using Hasher = std::function<std::size_t(const Variable&)>;
 
     Serializer   serializer;
     Deserializer deserializer;
     Checker      checker;
     DefMaker     def_maker;
+    Appender     appender;
+    Encoder      encoder;
+    Decoder      decoder;
+    Hasher       hasher;
 
     std::string name;
+
+    // Written as base64 of Encoder in JSON, instead of the text. (e.g. arrays)
+    // Types without Serializer are also written so.
+    bool bulk = false;
+
+    // Append the serialized `v` to `dst`, without a temporary string if
+    // `appender` is given.
+    void serializeTo(const Variable& v, std::string* dst) const {
+        if (appender) {
+            appender(v, dst);
+        } else {
+            *dst += serializer(v);
+        }
+    }
 };
 
 using TSCMap = std::map<std::type_index, TypeStringConverters>;
@@ -132,16 +286,69 @@ std::vector<std::vector<std::string>>
 GetRunOrder(const std::map<std::string, Node>& nodes,
             const std::vector<Link>&           links);
 
+struct NativeCodeOptions {
+    // Run costly nodes of the same layer in parallel with std::async.
+    // (only in the main pipeline)
+    bool parallel = false;
+    // Nodes whose execution time in `profile` is shorter than this are run
+    // inline. Nodes not in `profile` are regarded as costly.
+    Report::TimeType parallel_threshold = std::chrono::microseconds(100);
+    // Report of a run of the pipeline. (e.g. by PipelineAPI::run())
+    const Report* profile = nullptr;
+    // Measure the nodes of the main pipeline. Their mean times are dumped by
+    // the static function FaseDumpReport() of the generated class.
+    bool timing = false;
+};
+
 std::string GenNativeCode(const std::string& pipeline_name,
                           const CoreManager& cm, const TSCMap& utils,
                           const std::string& entry_name = "",
-                          const std::string& indent = "    ");
+                          const std::string& indent = "    ",
+                          const NativeCodeOptions& options = {});
+
+// Generate a program which runs the class `entry_name` of GenNativeCode()
+// with the saved inputs `argv[1]` (default 100) times, and prints the mean
+// time as ReportToString(). `prelude` should include the class. With
+// `per_node`, the class should be generated with NativeCodeOptions::timing,
+// and the times of nodes are also printed.
+std::string GenNativeBenchmarkCode(const std::string& pipeline_name,
+                                   const CoreManager& cm, const TSCMap& utils,
+                                   const std::string& entry_name,
+                                   const std::string& prelude,
+                                   bool               per_node = false);
+
+// CMakeLists.txt to build the program of GenNativeBenchmarkCode().
+std::string GenNativeBenchmarkCMake(const std::string&              target,
+                                    const std::vector<std::string>& sources);
 
 std::string PipelineToString(const std::string& pipeline_name,
                              const CoreManager& cm, const TSCMap& utils);
+// Append the JSON of PipelineToString() to `out`. It is written directly from
+// the pipelines, without a JSON tree.
+void PipelineToJson(const std::string& pipeline_name, const CoreManager& cm,
+                    const TSCMap& utils, std::string* out);
 
 bool LoadPipelineFromString(const std::string& str, CoreManager* pcm,
                             const TSCMap& utils);
+// Read the JSON in a single pass, calling PipelineAPI while parsing it.
+bool LoadPipelineFromJson(const char* data, std::size_t size, CoreManager* pcm,
+                          const TSCMap& utils);
+
+// Binary container of the pipelines saved by PipelineToString(), with their
+// run orders. Names are stored once in a string table, and values are blobs
+// of their types. SavePipeline() and LoadPipelineFromFile() use it for files
+// with the extension kBinaryPipelineExt.
+std::string PipelineToBinary(const std::string& pipeline_name,
+                             const CoreManager& cm, const TSCMap& utils);
+bool LoadPipelineFromBinary(const char* data, std::size_t size,
+                            CoreManager* pcm, const TSCMap& utils);
+// All pipelines of `cm` in the container of PipelineToBinary().
+std::string AllPipelinesToBinary(const CoreManager& cm, const TSCMap& utils);
+
+// JSON of Report, also printed by the generated benchmark.
+//   {"execution_time": <nanoseconds>, "child_reports": {"<node>": {...}}}
+std::string ReportToString(const Report& report);
+bool LoadReportFromString(const std::string& str, Report* report);
 
 bool SavePipeline(const std::string& pipeline_name, const CoreManager& cm,
                   const std::string& filename, const TSCMap& utils);
@@ -149,6 +356,10 @@ bool SavePipeline(const std::string& pipeline_name, const CoreManager& cm,
 bool LoadPipelineFromFile(const std::string& filename, CoreManager* pcm,
                           const TSCMap& utils);
 
+// Call `func` with the bytes of the file, mapped into memory if possible.
+bool ReadMappedFile(const std::string& filename,
+                    const std::function<bool(const char*, std::size_t)>& func);
+
 } // namespace fase
 
 #endif // COMMON_H_20190217
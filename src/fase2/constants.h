@@ -11,6 +11,14 @@ constexpr char kOutputFuncName[] = "FASE::OutputFunc";
 
 constexpr char kReturnValueID[] = "[[returned]]";
 
+// Extension of pipeline files saved in binary. (see PipelineToBinary())
+constexpr char kBinaryPipelineExt[] = "fpb";
+// Extension of checkpoint files of node outputs. (see Core::setCheckpoint())
+constexpr char kCheckpointExt[] = "fck";
+// Files in the directory of EditJournal.
+constexpr char kJournalLogFile[] = "journal.fjl";
+constexpr char kJournalSnapshotFile[] = "snapshot.fpb";
+
 static inline std::string InputNodeName() {
     return "Input";
 }
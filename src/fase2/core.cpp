@@ -1,14 +1,28 @@
 
 #include "core.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <optional>
+#include <set>
+#include <string_view>
+#include <thread>
+#include <tuple>
 #include <vector>
 
 #include <future>
 
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "constants.h"
 #include "utils.h"
 
@@ -91,11 +105,221 @@ vector<vector<string>> GetRunOrder(const map<string, Node>& nodes,
     }
 }
 
+namespace {
+
 struct FuncProps {
     UnivFunc func = [](auto&, auto) {};
     Vars default_args;
+    bool is_pure = false;
+    vector<bool> is_input_args;
+};
+
+// One unit of the execution plan.
+// A step runs a single node, or a fused chain of pure nodes in order.
+struct Step {
+    vector<string> n_names;
+
+    // Private argument slots of a fused chain (one deque per node).
+    vector<Vars> args;
+    // Slots which refer to Node::args, re-bound at every run.
+    vector<std::tuple<size_t, size_t>> shared_args;
+
+    // Name used in errors and Report.
+    string name;
+};
+
+struct Plan {
+    vector<vector<string>> order;
+    vector<vector<Step>> layers;
+    // Links between nodes of this plan, in binding order.
+    vector<Link> links;
+    vector<bool> demanded_outputs;
+
+    // Constant nodes, evaluated at the first run of this plan.
+    vector<Step> folded_steps;
+    vector<string> folded;
+    bool folded_evaluated = false;
 };
 
+bool IsSameTypes(const Vars& a, const Vars& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!a[i].isSameType(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Copy the value of `src` into `dst`, reusing its substance if possible.
+void CopyVar(const Variable& src, Variable* dst) {
+    if (src && src.isSameType(*dst)) {
+        src.copyTo(*dst);
+    } else {
+        *dst = src;
+    }
+}
+
+void CopyVars(const Vars& src, Vars* dst) {
+    if (src.size() != dst->size()) {
+        *dst = src;
+        return;
+    }
+    for (size_t i = 0; i < src.size(); i++) {
+        CopyVar(src[i], &(*dst)[i]);
+    }
+}
+
+string FusedReportName(const vector<string>& n_names) {
+    string dst;
+    for (auto& n_name : n_names) {
+        if (!dst.empty()) dst += "+";
+        dst += n_name;
+    }
+    return dst;
+}
+
+// Add `v` to the hash, unless its type has no encoder.
+bool HashValue(const Variable& v, const TSCMap& converters, string* buf,
+               Fnv1aHasher* hasher) {
+    auto it = converters.find(v.getType());
+    if (it == converters.end() || !it->second.encoder) {
+        return false;
+    }
+    hasher->add(it->second.name);
+    hasher->add(std::uint64_t(bool(v)));
+    if (v) {
+        buf->clear();
+        it->second.encoder(v, buf);
+        hasher->add(*buf);
+    }
+    return true;
+}
+
+// Layout : "FASECKPT" u32:n_values { u32:arg_idx u32:size bytes }...
+// Integers are little-endian.
+constexpr std::string_view kCheckpointMagic = "FASECKPT";
+
+void AppendU32(std::uint32_t v, string* dst) {
+    for (int i = 0; i < 4; i++) {
+        *dst += char((v >> (8 * i)) & 0xff);
+    }
+}
+
+string CheckpointPath(const CheckpointStore& store, std::uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.",
+                  static_cast<unsigned long long>(key));
+    return store.dir + "/" + name + kCheckpointExt;
+}
+
+// Write the outputs (non-input arguments) of `node`.
+bool SaveCheckpoint(const CheckpointStore& store, std::uint64_t key,
+                    const Node& node, const vector<bool>& is_input_args) {
+    string data(kCheckpointMagic);
+    const size_t count_pos = data.size();
+    AppendU32(0, &data);
+    std::uint32_t count = 0;
+    for (size_t i = 0; i < node.args.size(); i++) {
+        if (is_input_args[i]) {
+            continue;
+        }
+        auto it = store.converters.find(node.args[i].getType());
+        if (it == store.converters.end() || !it->second.encoder ||
+            !node.args[i]) {
+            return false;
+        }
+        AppendU32(std::uint32_t(i), &data);
+        const size_t size_pos = data.size();
+        AppendU32(0, &data);
+        it->second.encoder(node.args[i], &data);
+        string size;
+        AppendU32(std::uint32_t(data.size() - size_pos - 4), &size);
+        data.replace(size_pos, 4, size);
+        count++;
+    }
+    string count_str;
+    AppendU32(count, &count_str);
+    data.replace(count_pos, 4, count_str);
+
+    const string path = CheckpointPath(store, key);
+    // Written to a temporary file, not to load a half-written one.
+    string tmp = path + "." +
+                 std::to_string(std::hash<std::thread::id>()(
+                         std::this_thread::get_id()));
+#ifndef _WIN32
+    mkdir(store.dir.c_str(), 0755);
+    tmp += "." + std::to_string(getpid());
+#endif
+    {
+        std::ofstream ofs(tmp, std::ios::binary);
+        ofs.write(data.data(), std::streamsize(data.size()));
+        if (!ofs) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Read the outputs of `node` written by SaveCheckpoint().
+bool LoadCheckpoint(const CheckpointStore& store, std::uint64_t key,
+                    Node* node, const vector<bool>& is_input_args) {
+    const string path = CheckpointPath(store, key);
+    if (!std::ifstream(path)) {
+        return false;
+    }
+    return ReadMappedFile(path, [&](const char* data, size_t size) {
+        std::string_view rest(data, size);
+        auto take = [&](size_t n) {
+            if (rest.size() < n) {
+                throw std::runtime_error("truncated");
+            }
+            std::string_view dst = rest.substr(0, n);
+            rest.remove_prefix(n);
+            return dst;
+        };
+        auto u32 = [&] {
+            std::string_view bytes = take(4);
+            std::uint32_t v = 0;
+            for (int i = 3; i >= 0; i--) {
+                v = v << 8 | static_cast<unsigned char>(bytes[size_t(i)]);
+            }
+            return v;
+        };
+        try {
+            if (take(kCheckpointMagic.size()) != kCheckpointMagic) {
+                return false;
+            }
+            for (std::uint32_t n = u32(); n > 0; n--) {
+                const std::uint32_t idx = u32();
+                std::string_view bytes = take(u32());
+                if (idx >= node->args.size() || is_input_args[idx]) {
+                    return false;
+                }
+                auto it = store.converters.find(node->args[idx].getType());
+                if (it == store.converters.end() || !it->second.decoder) {
+                    return false;
+                }
+                it->second.decoder(node->args[idx], bytes);
+            }
+        } catch (std::exception& e) {
+            std::cerr << "Core::run() : broken checkpoint " << path << " ("
+                      << e.what() << ")" << std::endl;
+            return false;
+        }
+        return rest.empty();
+    });
+}
+
+} // namespace
+
 class Core::Impl {
 public:
     Impl();
@@ -103,6 +327,44 @@ public:
     // ======= unstable API =========
     bool addUnivFunc(const UnivFunc& func, const string& f_name,
                      std::deque<Variable>&& default_args);
+    bool addUnivFunc(const UnivFunc& func, const string& f_name,
+                     std::deque<Variable>&& default_args,
+                     const FunctionUtils& utils);
+    bool replaceUnivFunc(const UnivFunc& func, const string& f_name,
+                         std::deque<Variable>&& default_args,
+                         const FunctionUtils& utils) {
+        funcs[f_name] = {func, std::move(default_args),
+                         utils.type == FOGtype::Pure, utils.is_input_args};
+        invalidatePlan();
+        for (auto& [n_name, node] : nodes) {
+            if (node.func_name == f_name) {
+                node.func = func;
+            }
+        }
+        return true;
+    }
+
+    void setPlanOptions(const PlanOptions& options_) {
+        options = options_;
+        invalidatePlan();
+    }
+    const PlanOptions& getPlanOptions() const noexcept {
+        return options;
+    }
+
+    bool inlineNode(const string& n_name, const Impl& sub);
+    bool resetStatefulNodes(const Impl& origin);
+    bool setLinks(const vector<Link>& links_,
+                  const vector<vector<string>>& order);
+
+    void setCheckpointStore(std::shared_ptr<const CheckpointStore> store) {
+        checkpoint_store = std::move(store);
+    }
+    bool setCheckpoint(const string& n_name, bool enable);
+
+    void setMemoCache(std::shared_ptr<MemoCache> cache) {
+        memo_cache = std::move(cache);
+    }
 
     // ======= stable API =========
     bool newNode(const string& n_name);
@@ -112,6 +374,7 @@ public:
 
     bool setArgument(const string& node, size_t idx, Variable& var);
     bool setPriority(const std::string& node, int priority);
+    bool setSideEffect(const std::string& node, bool side_effect);
 
     bool allocateFunc(const string& work, const string& node);
     LinkNodeError linkNode(const string& src_node, size_t src_arg,
@@ -120,8 +383,10 @@ public:
 
     bool supposeInput(std::deque<Variable>& vars);
     bool supposeOutput(std::deque<Variable>& vars);
+    bool bindVariables(std::deque<Variable>& vars);
 
     bool run(Report* preport);
+    bool run(const vector<size_t>& output_idxs, Report* preport);
 
     const auto& getNodes() const noexcept {
         return nodes;
@@ -139,6 +404,55 @@ private:
     Vars inputs;
     Vars outputs;
 
+    PlanOptions options;
+    // Reused by run() not to allocate at every call.
+    vector<bool> demanded_buf;
+
+    // Execution plan, built lazily by run().
+    // A copied Core builds its own, since fused steps refer to Node::args.
+    struct PlanHolder {
+        PlanHolder() = default;
+        PlanHolder(const PlanHolder&) {}
+        PlanHolder& operator=(const PlanHolder&) {
+            plan.reset();
+            return *this;
+        }
+        std::unique_ptr<Plan> plan;
+    } plan_holder;
+    // Run order given by setLinks(), until nodes or links are modified.
+    vector<vector<string>> known_order;
+
+    void invalidatePlan() {
+        plan_holder.plan.reset();
+        known_order.clear();
+    }
+
+    // Checkpointed nodes, and where their outputs are kept.
+    std::set<string> checkpoints;
+    std::shared_ptr<const CheckpointStore> checkpoint_store;
+
+    using KeyMemo = map<string, std::optional<std::uint64_t>>;
+    std::optional<std::uint64_t> checkpointKey(const string& n_name,
+                                               KeyMemo* memo) const;
+    void restoreCheckpoints(const Plan& plan, vector<string>* restored,
+                            map<string, std::uint64_t>* misses);
+    std::set<string> findSkippableNodes(const Plan& plan,
+                                        const vector<string>& restored) const;
+
+    std::shared_ptr<MemoCache> memo_cache;
+    void callNode(const Node& node, Vars& args, Report* preport,
+                  Report* counts);
+    Plan* buildPlan(const vector<bool>& demanded_outputs);
+    bool isPureNode(const string& n_name) const;
+    vector<string> findLiveNodes(const vector<bool>& demanded_outputs) const;
+    vector<string> findConstantNodes(const vector<vector<string>>& order,
+                                     const vector<Link>& live_links) const;
+    vector<vector<string>> findPureChains(const vector<string>& folded,
+                                          const vector<Link>& live_links) const;
+    bool runPlan(const vector<bool>& demanded_outputs, Report* preport);
+    Step makeFusedStep(const vector<string>& chain);
+    void runStep(Step& step, Report* preport);
+
     std::deque<Variable>& defaultArgs(const std::string& n_name) {
         return funcs[nodes[n_name].func_name].default_args;
     }
@@ -158,11 +472,13 @@ Core::Impl::Impl() {
     nodes[InputNodeName()] = {kInputFuncName,
                               funcs[kInputFuncName].func,
                               {},
-                              std::numeric_limits<int>::max()};
+                              std::numeric_limits<int>::max(),
+                              false};
     nodes[OutputNodeName()] = {kOutputFuncName,
                                funcs[kOutputFuncName].func,
                                {},
-                               std::numeric_limits<int>::min()};
+                               std::numeric_limits<int>::min(),
+                               false};
 }
 void Core::Impl::unlinkSrc(const string& src_n_name, std::size_t src_arg) {
     for (auto& link : links) {
@@ -227,7 +543,8 @@ void Core::Impl::tryDoTaskKeepingLinks(const std::string& n_name, Task&& task) {
 
 bool Core::Impl::addUnivFunc(const UnivFunc& func, const string& f_name,
                              std::deque<Variable>&& default_args) {
-    funcs[f_name] = {func, std::move(default_args)};
+    funcs[f_name] = {func, std::move(default_args), false, {}};
+    invalidatePlan();
 
     for (auto& [node_name, node] : nodes) {
         if (node.func_name == f_name) {
@@ -237,11 +554,196 @@ bool Core::Impl::addUnivFunc(const UnivFunc& func, const string& f_name,
     return true;
 }
 
+bool Core::Impl::addUnivFunc(const UnivFunc& func, const string& f_name,
+                             std::deque<Variable>&& default_args,
+                             const FunctionUtils& utils) {
+    if (!addUnivFunc(func, f_name, std::move(default_args))) {
+        return false;
+    }
+    funcs[f_name].is_pure = utils.type == FOGtype::Pure;
+    funcs[f_name].is_input_args = utils.is_input_args;
+    return true;
+}
+
+bool Core::Impl::inlineNode(const string& n_name, const Impl& sub) {
+    if (!nodes.count(n_name) || n_name == InputNodeName() ||
+        n_name == OutputNodeName()) {
+        return false;
+    }
+    const size_t i_size = sub.inputs.size();
+    const Vars n_args = nodes[n_name].args;
+    if (n_args.size() != i_size + sub.outputs.size()) {
+        return false;
+    }
+    auto prefixed = [&](const string& s_n_name) {
+        return n_name + "." + s_n_name;
+    };
+    for (auto& [s_n_name, node] : sub.nodes) {
+        if (nodes.count(prefixed(s_n_name))) {
+            return false;
+        }
+    }
+
+    // Where the value of the `idx`th argument of `n_name` comes from.
+    // An empty node name means the constant `n_args[idx]`.
+    using Port = std::tuple<string, size_t>;
+    auto parent_src = [&](size_t idx) -> Port {
+        for (auto& link : links) {
+            if (link.dst_node == n_name && link.dst_arg == idx) {
+                return {link.src_node, link.src_arg};
+            }
+        }
+        return {"", idx};
+    };
+    auto port_src = [&](size_t idx) -> Port {
+        if (idx < i_size) {
+            return parent_src(idx);
+        }
+        for (auto& link : sub.links) {
+            if (link.dst_node != OutputNodeName() ||
+                link.dst_arg != idx - i_size) {
+                continue;
+            } else if (link.src_node == InputNodeName()) {
+                return parent_src(link.src_arg);
+            }
+            return {prefixed(link.src_node), link.src_arg};
+        }
+        return parent_src(idx);
+    };
+    // Bind the value of the argument `idx` of `n_name` to (dst, dst_arg).
+    vector<Link> new_links;
+    auto connect = [&](size_t idx, const string& dst, size_t dst_arg) {
+        auto [src, src_arg] = port_src(idx);
+        if (src.empty()) {
+            nodes[dst].args[dst_arg] = n_args[src_arg].clone();
+        } else {
+            new_links.emplace_back(Link{src, src_arg, dst, dst_arg});
+        }
+    };
+
+    bool side_effect = nodes[n_name].side_effect;
+    vector<Link> out_links = get_all_if(
+            links, [&](auto& l) { return l.src_node == n_name; });
+
+    for (auto& [s_n_name, node] : sub.nodes) {
+        if (s_n_name == InputNodeName() || s_n_name == OutputNodeName()) {
+            continue;
+        }
+        if (!funcs.count(node.func_name)) {
+            funcs[node.func_name] = sub.funcs.at(node.func_name);
+        }
+        Node& new_node = nodes[prefixed(s_n_name)] = node;
+        new_node.side_effect |= side_effect;
+    }
+    for (auto& link : sub.links) {
+        if (link.dst_node == OutputNodeName()) {
+            continue;
+        } else if (link.src_node == InputNodeName()) {
+            connect(link.src_arg, prefixed(link.dst_node), link.dst_arg);
+        } else {
+            new_links.emplace_back(Link{prefixed(link.src_node), link.src_arg,
+                                        prefixed(link.dst_node),
+                                        link.dst_arg});
+        }
+    }
+    for (auto& link : out_links) {
+        connect(link.src_arg, link.dst_node, link.dst_arg);
+    }
+
+    unlinkAll(n_name);
+    nodes.erase(n_name);
+    Extend(std::move(new_links), &links);
+    invalidatePlan();
+    return true;
+}
+
+bool Core::Impl::resetStatefulNodes(const Impl& origin) {
+    if (nodes.size() != origin.nodes.size()) {
+        return false;
+    }
+    vector<string> statefuls;
+    for (auto& [n_name, node] : origin.nodes) {
+        if (!nodes.count(n_name) ||
+            nodes[n_name].args.size() != node.args.size()) {
+            return false;
+        } else if (n_name != InputNodeName() && n_name != OutputNodeName() &&
+                   !isPureNode(n_name)) {
+            statefuls.emplace_back(n_name);
+        }
+    }
+    // Linked arguments refer to outputs of other nodes, which must not be
+    // overwritten.
+    std::set<std::tuple<string, size_t>> linked;
+    for (auto& link : links) {
+        linked.emplace(link.dst_node, link.dst_arg);
+    }
+    for (auto& n_name : statefuls) {
+        const Node& node = origin.nodes.at(n_name);
+        nodes[n_name].func = node.func;
+        for (size_t i = 0; i < node.args.size(); i++) {
+            if (!linked.count({n_name, i})) {
+                CopyVar(node.args[i], &nodes[n_name].args[i]);
+            }
+        }
+    }
+    // Folded values may have been written by the reset nodes.
+    if (plan_holder.plan) {
+        plan_holder.plan->folded_evaluated = false;
+    }
+    return true;
+}
+
+bool Core::Impl::setLinks(const vector<Link>& links_,
+                          const vector<vector<string>>& order) {
+    map<string, size_t> layer_idxs;
+    for (size_t i = 0; i < order.size(); i++) {
+        for (auto& n_name : order[i]) {
+            if (!nodes.count(n_name) || !layer_idxs.emplace(n_name, i).second) {
+                return false;
+            }
+        }
+    }
+    if (layer_idxs.size() != nodes.size()) {
+        return false;
+    }
+    std::set<std::tuple<string, size_t>> dsts;
+    for (auto& link : links_) {
+        if (!nodes.count(link.src_node) || !nodes.count(link.dst_node) ||
+            nodes[link.src_node].args.size() <= link.src_arg ||
+            nodes[link.dst_node].args.size() <= link.dst_arg ||
+            !defaultArgs(link.src_node)[link.src_arg].isSameType(
+                    defaultArgs(link.dst_node)[link.dst_arg]) ||
+            layer_idxs[link.src_node] >= layer_idxs[link.dst_node] ||
+            !dsts.emplace(link.dst_node, link.dst_arg).second) {
+            return false;
+        }
+    }
+    links = links_;
+    invalidatePlan();
+    known_order = order;
+    return true;
+}
+
+bool Core::Impl::setCheckpoint(const string& n_name, bool enable) {
+    if (!nodes.count(n_name) || n_name == InputNodeName() ||
+        n_name == OutputNodeName()) {
+        return false;
+    }
+    if (enable) {
+        checkpoints.emplace(n_name);
+    } else {
+        checkpoints.erase(n_name);
+    }
+    invalidatePlan(); // not to fold or fuse it.
+    return true;
+}
+
 bool Core::Impl::newNode(const string& n_name) {
     if (nodes.count(n_name) || n_name.empty()) {
         return false;
     }
     nodes[n_name];
+    invalidatePlan();
     return true;
 }
 
@@ -252,11 +754,15 @@ bool Core::Impl::renameNode(const std::string& old_n_name,
         return false;
     }
     nodes[new_n_name] = std::move(nodes[old_n_name]);
+    if (checkpoints.erase(old_n_name)) {
+        checkpoints.emplace(new_n_name);
+    }
     for (auto& link : links) {
         if (link.dst_node == old_n_name) link.dst_node = new_n_name;
         if (link.src_node == old_n_name) link.src_node = new_n_name;
     }
     delNode(old_n_name);
+    invalidatePlan();
     return true;
 }
 
@@ -265,6 +771,8 @@ bool Core::Impl::delNode(const string& n_name) {
         n_name != OutputNodeName()) {
         unlinkAll(n_name);
         nodes.erase(n_name);
+        checkpoints.erase(n_name);
+        invalidatePlan();
         return true;
     }
     return false;
@@ -275,12 +783,25 @@ bool Core::Impl::setArgument(const string& node, size_t idx, Variable& var) {
         return false;
     }
     nodes[node].args[idx] = var.ref();
+    if (plan_holder.plan && exists(node, plan_holder.plan->folded)) {
+        plan_holder.plan->folded_evaluated = false;
+    }
     return true;
 }
 
 bool Core::Impl::setPriority(const string& node, int priority) {
     if (nodes.count(node)) {
         nodes[node].priority = priority;
+        invalidatePlan();
+        return true;
+    }
+    return false;
+}
+
+bool Core::Impl::setSideEffect(const string& node, bool side_effect) {
+    if (nodes.count(node)) {
+        nodes[node].side_effect = side_effect;
+        invalidatePlan();
         return true;
     }
     return false;
@@ -297,6 +818,7 @@ bool Core::Impl::allocateFunc(const string& func, const string& node_name) {
             node.args = funcs[func].default_args;
             node.func = funcs[func].func;
         });
+        invalidatePlan();
         return true;
     }
     return false;
@@ -319,6 +841,7 @@ LinkNodeError Core::Impl::linkNode(const string& s_n_name, size_t s_idx,
         links.pop_back();
         return LinkNodeError::LoopCreated;
     }
+    invalidatePlan();
     return LinkNodeError::None;
 }
 
@@ -327,6 +850,7 @@ bool Core::Impl::unlinkNode(const std::string& dst_n_name,
     for (size_t i = 0; i < links.size(); i++) {
         if (links[i].dst_node == dst_n_name && links[i].dst_arg == dst_arg) {
             links.erase(links.begin() + long(i));
+            invalidatePlan();
             return true;
         }
     }
@@ -334,6 +858,12 @@ bool Core::Impl::unlinkNode(const std::string& dst_n_name,
 }
 
 bool Core::Impl::supposeInput(std::deque<Variable>& vars) {
+    if (IsSameTypes(vars, inputs)) {
+        // links are still valid.
+        RefCopy(vars, &inputs);
+        CopyVars(inputs, &nodes[InputNodeName()].args);
+        return true;
+    }
     tryDoTaskKeepingLinks(InputNodeName(), [&]() {
         RefCopy(vars, &inputs);
         nodes[InputNodeName()].args = inputs;
@@ -343,6 +873,11 @@ bool Core::Impl::supposeInput(std::deque<Variable>& vars) {
 }
 
 bool Core::Impl::supposeOutput(std::deque<Variable>& vars) {
+    if (IsSameTypes(vars, outputs)) {
+        RefCopy(vars, &outputs);
+        RefCopy(vars, &nodes[OutputNodeName()].args);
+        return true;
+    }
     tryDoTaskKeepingLinks(OutputNodeName(), [&]() {
         RefCopy(vars, &outputs);
         RefCopy(vars, &nodes[OutputNodeName()].args);
@@ -351,32 +886,473 @@ bool Core::Impl::supposeOutput(std::deque<Variable>& vars) {
     return true;
 }
 
+bool Core::Impl::bindVariables(std::deque<Variable>& vars) {
+    Vars& o_args = nodes[OutputNodeName()].args;
+    if (vars.size() != inputs.size() + outputs.size() ||
+        o_args.size() != outputs.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < vars.size(); i++) {
+        const Variable& v = i < inputs.size() ? inputs[i]
+                                              : outputs[i - inputs.size()];
+        if (!vars[i].isSameType(v)) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < inputs.size(); i++) {
+        inputs[i] = vars[i].ref();
+    }
+    for (size_t i = 0; i < outputs.size(); i++) {
+        outputs[i] = vars[i + inputs.size()].ref();
+        o_args[i] = vars[i + inputs.size()].ref();
+    }
+    return true;
+}
+
+bool Core::Impl::isPureNode(const string& n_name) const {
+    if (n_name == InputNodeName() || n_name == OutputNodeName()) {
+        return false;
+    }
+    const Node& node = nodes.at(n_name);
+    auto it = funcs.find(node.func_name);
+    return it != funcs.end() && it->second.is_pure &&
+           it->second.is_input_args.size() == node.args.size();
+}
+
+vector<string>
+Core::Impl::findLiveNodes(const vector<bool>& demanded_outputs) const {
+    // Only pure nodes are pruned, since others may write out something.
+    vector<string> stack;
+    for (auto& [n_name, node] : nodes) {
+        if (node.side_effect || !isPureNode(n_name)) {
+            stack.emplace_back(n_name);
+        }
+    }
+    for (auto& link : links) {
+        if (link.dst_node == OutputNodeName() &&
+            link.dst_arg < demanded_outputs.size() &&
+            demanded_outputs[link.dst_arg]) {
+            stack.emplace_back(link.src_node);
+        }
+    }
+
+    vector<string> dst = {InputNodeName(), OutputNodeName()};
+    while (!stack.empty()) {
+        string n_name = std::move(stack.back());
+        stack.pop_back();
+        if (exists(n_name, dst)) {
+            continue;
+        }
+        for (auto& link : links) {
+            if (link.dst_node == n_name) {
+                stack.emplace_back(link.src_node);
+            }
+        }
+        dst.emplace_back(std::move(n_name));
+    }
+    return dst;
+}
+
+vector<string>
+Core::Impl::findConstantNodes(const vector<vector<string>>& order,
+                              const vector<Link>& live_links) const {
+    // whether the destination of the link may be written by its node.
+    auto is_written = [&](const Link& link) {
+        if (link.dst_node == OutputNodeName()) {
+            return false;
+        }
+        auto it = funcs.find(nodes.at(link.dst_node).func_name);
+        return it == funcs.end() ||
+               it->second.is_input_args.size() <= link.dst_arg ||
+               !it->second.is_input_args[link.dst_arg];
+    };
+
+    vector<string> dst;
+    for (auto& n_name : to1dim(order)) {
+        if (isPureNode(n_name) && !checkpoints.count(n_name)) {
+            dst.emplace_back(n_name);
+        }
+    }
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto& link : live_links) {
+            bool src_c = exists(link.src_node, dst);
+            bool dst_c = exists(link.dst_node, dst);
+            if (dst_c && !src_c) {
+                erase_all(dst, link.dst_node);
+                changed = true;
+            } else if (src_c && !dst_c && is_written(link)) {
+                erase_all(dst, link.src_node);
+                changed = true;
+            }
+        }
+    }
+    return dst;
+}
+
+vector<vector<string>>
+Core::Impl::findPureChains(const vector<string>& folded,
+                           const vector<Link>& live_links) const {
+    auto is_fusable = [&](const string& n_name) {
+        return isPureNode(n_name) && !exists(n_name, folded) &&
+               !checkpoints.count(n_name);
+    };
+    map<string, vector<string>> producers, consumers;
+    for (auto& link : live_links) {
+        if (link.src_node != InputNodeName() &&
+            !exists(link.src_node, folded) &&
+            !exists(link.src_node, producers[link.dst_node])) {
+            producers[link.dst_node].emplace_back(link.src_node);
+        }
+        if (!exists(link.dst_node, consumers[link.src_node])) {
+            consumers[link.src_node].emplace_back(link.dst_node);
+        }
+    }
+    // n_name -> the node fused after it.
+    auto next_of = [&](const string& n_name) -> string {
+        if (!is_fusable(n_name) || consumers[n_name].size() != 1) {
+            return "";
+        }
+        const string& next = consumers[n_name][0];
+        if (!is_fusable(next) || producers[next].size() != 1) {
+            return "";
+        }
+        return next;
+    };
+
+    vector<vector<string>> chains;
+    for (auto& [n_name, node] : nodes) {
+        if (!producers[n_name].empty() &&
+            !next_of(producers[n_name][0]).empty()) {
+            continue; // not a head of chain.
+        }
+        vector<string> chain = {n_name};
+        for (string next = next_of(n_name); !next.empty();
+             next = next_of(next)) {
+            chain.emplace_back(next);
+        }
+        if (chain.size() > 1) {
+            chains.emplace_back(std::move(chain));
+        }
+    }
+    return chains;
+}
+
+Step Core::Impl::makeFusedStep(const vector<string>& chain) {
+    Step step;
+    step.n_names = chain;
+    step.name = FusedReportName(chain);
+    step.args.resize(chain.size());
+    for (size_t i = 0; i < chain.size(); i++) {
+        Node& node = nodes[chain[i]];
+        const auto& is_inputs = funcs[node.func_name].is_input_args;
+        for (size_t j = 0; j < node.args.size(); j++) {
+            auto link = std::find_if(links.begin(), links.end(), [&](auto& l) {
+                return l.dst_node == chain[i] && l.dst_arg == j;
+            });
+            if (i != 0 && link != links.end() &&
+                link->src_node == chain[i - 1]) {
+                // intermediate value passed inside the chain.
+                step.args[i].emplace_back(step.args[i - 1][link->src_arg].ref());
+            } else if (i + 1 != chain.size() && !is_inputs[j] &&
+                       link == links.end()) {
+                // output of non-tail node, read only by the next one.
+                step.args[i].emplace_back(node.args[j].clone());
+            } else {
+                step.args[i].emplace_back();
+                step.shared_args.emplace_back(i, j);
+            }
+        }
+    }
+    return step;
+}
+
+Plan* Core::Impl::buildPlan(const vector<bool>& demanded_outputs) {
+    if (plan_holder.plan &&
+        plan_holder.plan->demanded_outputs == demanded_outputs) {
+        return plan_holder.plan.get();
+    }
+    invalidatePlan();
+    auto plan = std::make_unique<Plan>();
+    plan->order = known_order.empty() ? GetRunOrder(nodes, links)
+                                      : known_order;
+    if (plan->order.empty()) {
+        return nullptr;
+    }
+    sortLink(plan->order);
+    plan->demanded_outputs = demanded_outputs;
+
+    bool is_partial = !std::all_of(demanded_outputs.begin(),
+                                   demanded_outputs.end(),
+                                   [](bool b) { return b; });
+    if (options.prune_dead_nodes || is_partial) {
+        vector<string> lives = findLiveNodes(demanded_outputs);
+        for (auto& node_names : plan->order) {
+            node_names.erase(std::remove_if(node_names.begin(),
+                                            node_names.end(),
+                                            [&](auto& n_name) {
+                                                return !exists(n_name, lives);
+                                            }),
+                             node_names.end());
+        }
+        for (auto& link : links) {
+            if (!exists(link.dst_node, lives) ||
+                (link.dst_node == OutputNodeName() &&
+                 !demanded_outputs[link.dst_arg])) {
+                continue;
+            }
+            plan->links.emplace_back(link);
+        }
+    } else {
+        plan->links = links;
+    }
+
+    if (options.fold_constants) {
+        plan->folded = findConstantNodes(plan->order, plan->links);
+        for (auto& n_name : plan->folded) {
+            plan->folded_steps.emplace_back(Step{{n_name}, {}, {}, n_name});
+        }
+    }
+
+    map<string, vector<string>> chains; // head -> chain
+    vector<string> fused_members;
+    if (options.fuse_pure_chains) {
+        for (auto& chain : findPureChains(plan->folded, plan->links)) {
+            Extend(chain, &fused_members);
+            chains[chain[0]] = std::move(chain);
+        }
+    }
+
+    for (auto& node_names : plan->order) {
+        vector<Step> layer;
+        for (auto& n_name : node_names) {
+            if (chains.count(n_name)) {
+                layer.emplace_back(makeFusedStep(chains[n_name]));
+            } else if (!exists(n_name, fused_members) &&
+                       !exists(n_name, plan->folded)) {
+                layer.emplace_back(Step{{n_name}, {}, {}, n_name});
+            }
+        }
+        plan->layers.emplace_back(std::move(layer));
+    }
+    plan_holder.plan = std::move(plan);
+    return plan_holder.plan.get();
+}
+
+std::optional<std::uint64_t> Core::Impl::checkpointKey(const string& n_name,
+                                                       KeyMemo* memo) const {
+    if (auto it = memo->find(n_name); it != memo->end()) {
+        return it->second;
+    }
+    auto& key = (*memo)[n_name];
+    const TSCMap& converters = checkpoint_store->converters;
+    const Node& node = nodes.at(n_name);
+    Fnv1aHasher hasher;
+    string buf;
+    hasher.add(node.func_name);
+    if (n_name == InputNodeName()) {
+        for (auto& arg : node.args) {
+            if (!HashValue(arg, converters, &buf, &hasher)) {
+                return std::nullopt;
+            }
+        }
+        return key = hasher.value();
+    } else if (!isPureNode(n_name)) {
+        return std::nullopt; // results may differ with the same arguments.
+    }
+
+    const auto& is_input_args = funcs.at(node.func_name).is_input_args;
+    for (size_t i = 0; i < node.args.size(); i++) {
+        auto link = std::find_if(links.begin(), links.end(), [&](auto& l) {
+            return l.dst_node == n_name && l.dst_arg == i;
+        });
+        if (link != links.end()) {
+            auto src_key = checkpointKey(link->src_node, memo);
+            if (!src_key) {
+                return std::nullopt;
+            }
+            hasher.add(*src_key);
+            hasher.add(std::uint64_t(link->src_arg));
+        } else if (is_input_args[i]) {
+            if (!HashValue(node.args[i], converters, &buf, &hasher)) {
+                return std::nullopt;
+            }
+        } else {
+            hasher.add(std::uint64_t(-1)); // output
+        }
+    }
+    return key = hasher.value();
+}
+
+void Core::Impl::restoreCheckpoints(const Plan& plan, vector<string>* restored,
+                                    map<string, std::uint64_t>* misses) {
+    KeyMemo memo;
+    for (auto& n_name : to1dim(plan.order)) {
+        if (!checkpoints.count(n_name)) {
+            continue;
+        }
+        auto key = checkpointKey(n_name, &memo);
+        if (!key) {
+            continue;
+        }
+        Node& node = nodes[n_name];
+        if (LoadCheckpoint(*checkpoint_store, *key, &node,
+                           funcs[node.func_name].is_input_args)) {
+            restored->emplace_back(n_name);
+        } else {
+            (*misses)[n_name] = *key;
+        }
+    }
+}
+
+std::set<string>
+Core::Impl::findSkippableNodes(const Plan& plan,
+                               const vector<string>& restored) const {
+    std::set<string> dst(restored.begin(), restored.end());
+    if (dst.empty()) {
+        return dst;
+    }
+    map<string, vector<string>> consumers;
+    for (auto& link : plan.links) {
+        consumers[link.src_node].emplace_back(link.dst_node);
+    }
+    // Nodes all of whose consumers are skipped, from the downstream.
+    for (auto it = plan.order.rbegin(); it != plan.order.rend(); it++) {
+        for (auto& n_name : *it) {
+            auto& dsts = consumers[n_name];
+            if (n_name == InputNodeName() || nodes.at(n_name).side_effect ||
+                dsts.empty()) {
+                continue;
+            }
+            if (std::all_of(dsts.begin(), dsts.end(),
+                            [&](auto& d) { return dst.count(d) > 0; })) {
+                dst.emplace(n_name);
+            }
+        }
+    }
+    return dst;
+}
+
+void Core::Impl::callNode(const Node& node, Vars& args, Report* preport,
+                          Report* counts) {
+    if (!memo_cache || !memo_cache->isEnabled(node.func_name)) {
+        node.func(args, preport);
+        return;
+    }
+    const FuncProps& props = funcs.at(node.func_name);
+    std::optional<MemoCache::Key> key;
+    if (props.is_pure && props.is_input_args.size() == args.size()) {
+        key = memo_cache->makeKey(node.func_name, args, props.is_input_args);
+    }
+    if (key && memo_cache->load(*key, node.func_name, args)) {
+        if (counts != nullptr) counts->memo_hits++;
+        return;
+    }
+    node.func(args, preport);
+    if (key) {
+        memo_cache->store(*key, node.func_name, args, props.is_input_args);
+        if (counts != nullptr) counts->memo_misses++;
+    }
+}
+
+void Core::Impl::runStep(Step& step, Report* preport) {
+    if (step.n_names.size() == 1) {
+        Report* p = nullptr;
+        if (preport != nullptr) {
+            p = &preport->child_reports[step.n_names[0]];
+        }
+        Node& node = nodes[step.n_names[0]];
+        callNode(node, node.args, p, p);
+        return;
+    }
+
+    for (auto& [i, j] : step.shared_args) {
+        step.args[i][j] = nodes[step.n_names[i]].args[j].ref();
+    }
+    Report* p = nullptr;
+    if (preport != nullptr) {
+        p = &preport->child_reports[step.name];
+    }
+    auto start = std::chrono::system_clock::now();
+    for (size_t i = 0; i < step.n_names.size(); i++) {
+        callNode(nodes[step.n_names[i]], step.args[i], nullptr, p);
+    }
+    if (p != nullptr) {
+        p->execution_time = std::chrono::system_clock::now() - start;
+    }
+}
+
 bool Core::Impl::run(Report* preport) {
-    vector<vector<string>> order = GetRunOrder(nodes, links);
-    if (order.size() == 0) {
+    demanded_buf.assign(outputs.size(), true);
+    return runPlan(demanded_buf, preport);
+}
+
+bool Core::Impl::run(const vector<size_t>& output_idxs, Report* preport) {
+    demanded_buf.assign(outputs.size(), false);
+    for (size_t idx : output_idxs) {
+        if (idx >= outputs.size()) {
+            return false;
+        }
+        demanded_buf[idx] = true;
+    }
+    return runPlan(demanded_buf, preport);
+}
+
+bool Core::Impl::runPlan(const vector<bool>& demanded_outputs,
+                         Report* preport) {
+    Plan* plan = buildPlan(demanded_outputs);
+    if (plan == nullptr) {
         return false;
     }
 
-    nodes[InputNodeName()].args = inputs;
+    if (!WrapError(InputNodeName(), [&]() {
+            CopyVars(inputs, &nodes[InputNodeName()].args);
+        })) {
+        return false;
+    }
     nodes[OutputNodeName()].args.resize(outputs.size());
 
-    sortLink(order);
-    for (auto& link : links) {
+    for (auto& link : plan->links) {
         nodes[link.dst_node].args[link.dst_arg] =
                 nodes[link.src_node].args[link.src_arg].ref();
     }
 
     auto start = std::chrono::system_clock::now();
+
+    // Nodes loaded from checkpoints, and nodes needed only by them.
+    vector<string> restored;
+    map<string, std::uint64_t> misses;
+    std::set<string> skipped;
+    if (checkpoint_store && !checkpoints.empty()) {
+        restoreCheckpoints(*plan, &restored, &misses);
+        skipped = findSkippableNodes(*plan, restored);
+    }
+    auto is_skipped = [&](const Step& step) {
+        return !skipped.empty() &&
+               std::all_of(step.n_names.begin(), step.n_names.end(),
+                           [&](auto& n_name) { return skipped.count(n_name); });
+    };
+
+    if (!plan->folded_evaluated) {
+        bool all_evaluated = true;
+        for (auto& step : plan->folded_steps) {
+            if (is_skipped(step)) {
+                all_evaluated = false;
+                continue;
+            }
+            if (!WrapError(step.name, [&]() { runStep(step, preport); })) {
+                return false;
+            }
+        }
+        plan->folded_evaluated = all_evaluated;
+    }
 #if 1
-    for (auto& node_names : order) {
-        for (auto& n_name : node_names) {
-            Report* p = nullptr;
-            if (preport != nullptr) {
-                p = &preport->child_reports[n_name];
+    for (auto& steps : plan->layers) {
+        for (auto& step : steps) {
+            if (is_skipped(step)) {
+                continue;
             }
-            if (!WrapError(n_name, [&]() {
-                    nodes[n_name].func(nodes[n_name].args, p);
-                })) {
+            if (!WrapError(step.name, [&]() { runStep(step, preport); })) {
                 return false;
             }
         }
@@ -384,30 +1360,38 @@ bool Core::Impl::run(Report* preport) {
 #else
     std::launch policy = std::launch::async | std::launch::deferred;
 
-    for (auto& node_names : order) {
-        map<string, std::future<void>> futures;
-        for (auto& n_name : node_names) {
-            Report* p = nullptr;
-            if (preport != nullptr) {
-                p = &preport->child_reports[n_name];
+    for (auto& steps : plan->layers) {
+        vector<std::future<void>> futures;
+        for (auto& step : steps) {
+            if (is_skipped(step)) {
+                futures.emplace_back(std::async(std::launch::deferred, [] {}));
+                continue;
             }
-            futures[n_name] = std::async(policy, [&]() {
-                nodes[n_name].func(nodes[n_name].args, p);
-            });
+            futures.emplace_back(std::async(
+                    policy, [&]() { runStep(step, preport); }));
         }
-        for (auto& n_name : node_names) {
-            if (!WrapError(n_name, [&]() { futures[n_name].wait(); })) {
+        for (size_t i = 0; i < steps.size(); i++) {
+            if (!WrapError(steps[i].name, [&]() { futures[i].get(); })) {
                 return false;
             }
         }
     }
 #endif
+    for (auto& [n_name, key] : misses) {
+        if (!skipped.count(n_name)) {
+            const Node& node = nodes[n_name];
+            SaveCheckpoint(*checkpoint_store, key, node,
+                           funcs[node.func_name].is_input_args);
+        }
+    }
     if (preport != nullptr) {
         preport->execution_time = std::chrono::system_clock::now() - start;
     }
 
     for (size_t i = 0; i < outputs.size(); i++) {
-        nodes[OutputNodeName()].args[i].copyTo(outputs[i]);
+        if (demanded_outputs[i]) {
+            nodes[OutputNodeName()].args[i].copyTo(outputs[i]);
+        }
     }
     return true;
 }
@@ -439,6 +1423,54 @@ bool Core::addUnivFunc(const UnivFunc& func, const string& f_name,
                               std::forward<std::deque<Variable>>(default_args));
 }
 
+bool Core::addUnivFunc(const UnivFunc& func, const string& f_name,
+                       std::deque<Variable>&& default_args,
+                       const FunctionUtils& utils) {
+    return pimpl->addUnivFunc(
+            func, f_name, std::forward<std::deque<Variable>>(default_args),
+            utils);
+}
+
+bool Core::replaceUnivFunc(const UnivFunc& func, const string& f_name,
+                           std::deque<Variable>&& default_args,
+                           const FunctionUtils& utils) {
+    return pimpl->replaceUnivFunc(func, f_name, std::move(default_args),
+                                  utils);
+}
+
+bool Core::inlineNode(const string& n_name, const Core& sub) {
+    return pimpl->inlineNode(n_name, *sub.pimpl);
+}
+
+bool Core::resetStatefulNodes(const Core& origin) {
+    return pimpl->resetStatefulNodes(*origin.pimpl);
+}
+
+bool Core::setLinks(const std::vector<Link>&                     links,
+                    const std::vector<std::vector<std::string>>& order) {
+    return pimpl->setLinks(links, order);
+}
+
+void Core::setCheckpointStore(std::shared_ptr<const CheckpointStore> store) {
+    pimpl->setCheckpointStore(std::move(store));
+}
+
+bool Core::setCheckpoint(const string& n_name, bool enable) {
+    return pimpl->setCheckpoint(n_name, enable);
+}
+
+void Core::setMemoCache(std::shared_ptr<MemoCache> cache) {
+    pimpl->setMemoCache(std::move(cache));
+}
+
+void Core::setPlanOptions(const PlanOptions& options) {
+    pimpl->setPlanOptions(options);
+}
+
+const PlanOptions& Core::getPlanOptions() const noexcept {
+    return pimpl->getPlanOptions();
+}
+
 // ======= stable API =========
 bool Core::newNode(const string& n_name) {
     return pimpl->newNode(n_name);
@@ -459,6 +1491,10 @@ bool Core::setPriority(const std::string& node, int priority) {
     return pimpl->setPriority(node, priority);
 }
 
+bool Core::setSideEffect(const std::string& node, bool side_effect) {
+    return pimpl->setSideEffect(node, side_effect);
+}
+
 bool Core::allocateFunc(const string& work, const string& node) {
     return pimpl->allocateFunc(work, node);
 }
@@ -479,10 +1515,18 @@ bool Core::supposeOutput(std::deque<Variable>& vars) {
     return pimpl->supposeOutput(vars);
 }
 
+bool Core::bindVariables(std::deque<Variable>& vars) {
+    return pimpl->bindVariables(vars);
+}
+
 bool Core::run(Report* preport) {
     return pimpl->run(preport);
 }
 
+bool Core::run(const std::vector<std::size_t>& output_idxs, Report* preport) {
+    return pimpl->run(output_idxs, preport);
+}
+
 const std::map<std::string, Node>& Core::getNodes() const noexcept {
     return pimpl->getNodes();
 }
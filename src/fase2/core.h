@@ -5,14 +5,38 @@
 #include <exception>
 #include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "common.h"
+#include "memo_cache.h"
 #include "variable.h"
 
 namespace fase {
 
+// Optimization passes applied when Core builds its execution plan.
+struct PlanOptions {
+    // Run single-producer/single-consumer chains of pure nodes as one step.
+    // Intermediate values of a fused chain are kept in the plan and are not
+    // written back to Node::args.
+    bool fuse_pure_chains = false;
+    // Evaluate pure nodes whose whole upstream is free of links from Input
+    // or from impure nodes only once, and reuse their results until one of
+    // their arguments is set again.
+    bool fold_constants = false;
+    // Skip pure nodes whose results reach neither Output nor an impure node
+    // or a node marked by Core::setSideEffect().
+    bool prune_dead_nodes = false;
+};
+
+// Where Core keeps outputs of checkpointed nodes. (see Core::setCheckpoint())
+struct CheckpointStore {
+    std::string dir;
+    // Values are written with `encoder` and read with `decoder`.
+    TSCMap converters;
+};
+
 class Core {
 public:
     Core();
@@ -27,6 +51,48 @@ public:
     // ======= unstable API =========
     bool addUnivFunc(const UnivFunc& func, const std::string& f_name,
                      std::deque<Variable>&& default_args);
+    bool addUnivFunc(const UnivFunc& func, const std::string& f_name,
+                     std::deque<Variable>&& default_args,
+                     const FunctionUtils&   utils);
+    // As addUnivFunc(), but nodes which already call `f_name` keep their
+    // arguments, and only their functions are replaced. For updates which
+    // keep the argument types.
+    bool replaceUnivFunc(const UnivFunc& func, const std::string& f_name,
+                         std::deque<Variable>&& default_args,
+                         const FunctionUtils&   utils);
+
+    void               setPlanOptions(const PlanOptions& options);
+    const PlanOptions& getPlanOptions() const noexcept;
+
+    // Replace node `n_name`, which calls the pipeline `sub`, with the nodes
+    // of `sub`. They are named `n_name + "." + <node name in sub>`.
+    // The nodes are copied with their states for each inlined node, so
+    // non-Pure nodes no longer share their states with other callers of `sub`.
+    bool inlineNode(const std::string& n_name, const Core& sub);
+
+    // Restore functions and arguments of the nodes which may have states
+    // (all but FOGtype::Pure ones) from `origin`, which this was copied from.
+    bool resetStatefulNodes(const Core& origin);
+
+    // Replace all links with `links`. `order` is their run order known in
+    // advance (e.g. saved with the pipeline). It is checked instead of
+    // searching loops link by link, and used by the next run.
+    bool setLinks(const std::vector<Link>&                     links,
+                  const std::vector<std::vector<std::string>>& order);
+
+    // Save outputs of the node `n_name` into the store after it runs, keyed by
+    // a hash of its function, its arguments and the keys of upstream nodes.
+    // If the file of the key exists at a run, the outputs are loaded from it
+    // instead, and the upstream nodes needed only by it are skipped.
+    // Only pure nodes whose upstream is pure and whose values have binary
+    // codecs are checkpointed. Others simply run.
+    void setCheckpointStore(std::shared_ptr<const CheckpointStore> store);
+    bool setCheckpoint(const std::string& n_name, bool enable);
+
+    // Look up results of pure nodes in `cache` before calling their
+    // functions, if enabled in it. Hits and misses are counted in the Report
+    // of the node (or of the fused step).
+    void setMemoCache(std::shared_ptr<MemoCache> cache);
 
     // ======= stable API =========
     bool newNode(const std::string& n_name);
@@ -36,6 +102,7 @@ public:
 
     bool setArgument(const std::string& n_name, std::size_t idx, Variable& var);
     bool setPriority(const std::string& n_name, int priority);
+    bool setSideEffect(const std::string& n_name, bool side_effect);
 
     bool allocateFunc(const std::string& f_name, const std::string& n_name);
     LinkNodeError linkNode(const std::string& src_node, std::size_t src_arg,
@@ -44,8 +111,15 @@ public:
 
     bool supposeInput(std::deque<Variable>& vars);
     bool supposeOutput(std::deque<Variable>& vars);
+    // Refer to `vars` as the inputs followed by the outputs, if they have the
+    // same types as the current ones. No memory is allocated.
+    bool bindVariables(std::deque<Variable>& vars);
 
     bool run(Report* preport = nullptr);
+    // Run only nodes needed for the outputs of `output_idxs` (and side effect
+    // nodes). Other outputs are left untouched.
+    bool run(const std::vector<std::size_t>& output_idxs,
+             Report*                         preport = nullptr);
 
     const std::map<std::string, Node>& getNodes() const noexcept;
     const std::vector<Link>&           getLinks() const noexcept;
@@ -59,6 +59,47 @@ public:
                         std::function<T(const std::string&)>&& deserializer,
                         std::function<std::string(const T&)>&& def_maker);
 
+    /**
+     * @brief
+     *      add binary codec of the type, used when save/load as binary.
+     *      It is preferred to the text one, if both are registered.
+     *
+     * @tparam T
+     *      User defined type
+     *
+     * @param name
+     *      string of the type (same as the one of registerTextIO)
+     * @param writer
+     *      appends bytes of the value to the buffer.
+     * @param reader
+     *      makes the value of the bytes. should throw if they are broken.
+     *
+     * @return
+     *      succeeded or not (maybe this will be allways return true.)
+     */
+    template <typename T>
+    bool registerBinaryIO(const std::string&                            name,
+                          std::function<void(const T&, std::string*)>&& writer,
+                          std::function<T(std::string_view)>&&          reader);
+
+    /**
+     * @brief
+     *      add hash function of the type, used by MemoCache to find results
+     *      of the same inputs. Without it, bytes of the binary codec are
+     *      hashed. The binary codec is still needed to compare the inputs.
+     *
+     * @tparam T
+     *      User defined type
+     *
+     * @param hasher
+     *      returns the same value for the equal values.
+     *
+     * @return
+     *      succeeded or not (maybe this will be allways return true.)
+     */
+    template <typename T>
+    bool registerHasher(std::function<std::size_t(const T&)>&& hasher);
+
 private:
     class APIImpl;
 
@@ -124,6 +165,9 @@ private:
                                           def_maker);                          \
     }();
 
+#define FaseRegisterBinaryIO(app, type, writer, reader)                        \
+    [&] { app.template registerBinaryIO<type>(#type, writer, reader); }();
+
 // =============================================================================
 // =========================== Non User Interface ==============================
 // =============================================================================
@@ -247,6 +291,9 @@ inline bool Fase<Parts...>::registerTextIO(
                 return serializer(*v.getReader<T>());
             };
 
+    // The built-in appender, if any, does not match `serializer`.
+    getAPIImpl().converter_map[typeid(T)].appender = nullptr;
+
     getAPIImpl().converter_map[typeid(T)].deserializer =
             [deserializer = std::move(deserializer)](Variable&          v,
                                                      const std::string& str) {
@@ -266,12 +313,49 @@ inline bool Fase<Parts...>::registerTextIO(
     return true;
 }
 
+template <class... Parts>
+template <typename T>
+inline bool Fase<Parts...>::registerBinaryIO(
+        const std::string&                            name,
+        std::function<void(const T&, std::string*)>&& writer,
+        std::function<T(std::string_view)>&&          reader) {
+    auto& tsc = getAPIImpl().converter_map[typeid(T)];
+    tsc.encoder = [writer = std::move(writer)](const Variable& v,
+                                               std::string*    dst) {
+        writer(*v.getReader<T>(), dst);
+    };
+    tsc.decoder = [reader = std::move(reader)](Variable&        v,
+                                               std::string_view bytes) {
+        v.create<T>(reader(bytes));
+    };
+    tsc.checker = [](const Variable& v) { return v.isSameType<T>(); };
+    tsc.name = name;
+    return true;
+}
+
+template <class... Parts>
+template <typename T>
+inline bool Fase<Parts...>::registerHasher(
+        std::function<std::size_t(const T&)>&& hasher) {
+    getAPIImpl().converter_map[typeid(T)].hasher =
+            [hasher = std::move(hasher)](const Variable& v) {
+                return hasher(*v.getReader<T>());
+            };
+    return true;
+}
+
 template <class... Parts>
 inline std::tuple<std::shared_lock<std::shared_timed_mutex>,
                   std::shared_ptr<const CoreManager>>
 Fase<Parts...>::APIImpl::getReader(
         const std::chrono::nanoseconds& wait_time) const {
-    std::shared_lock<std::shared_timed_mutex> lock(cm_mutex, wait_time);
+    // Negative `wait_time` waits until locked.
+    std::shared_lock<std::shared_timed_mutex> lock(cm_mutex, std::defer_lock);
+    if (wait_time < wait_time.zero()) {
+        lock.lock();
+    } else {
+        lock.try_lock_for(wait_time);
+    }
     if (lock)
         return {std::move(lock),
                 std::static_pointer_cast<const CoreManager>(pcm)};
@@ -282,7 +366,13 @@ template <class... Parts>
 inline std::tuple<std::unique_lock<std::shared_timed_mutex>,
                   std::shared_ptr<CoreManager>>
 Fase<Parts...>::APIImpl::getWriter(const std::chrono::nanoseconds& wait_time) {
-    std::unique_lock<std::shared_timed_mutex> lock(cm_mutex, wait_time);
+    // Negative `wait_time` waits until locked.
+    std::unique_lock<std::shared_timed_mutex> lock(cm_mutex, std::defer_lock);
+    if (wait_time < wait_time.zero()) {
+        lock.lock();
+    } else {
+        lock.try_lock_for(wait_time);
+    }
     if (lock) {
         return {std::move(lock), pcm};
     }
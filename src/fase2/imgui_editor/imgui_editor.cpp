@@ -76,7 +76,7 @@ private:
     vector<OptionalButton> optional_buttons;
     InputText new_core_name_it{64, ImGuiInputTextFlags_EnterReturnsTrue};
     // for save pipeline
-    InputPath filename_it{{int(10e3), 15, {".json"}}};
+    InputPath filename_it{{int(10e3), 15, {".json", ".fpb"}}};
     // for store native code
     std::string native_code;
 
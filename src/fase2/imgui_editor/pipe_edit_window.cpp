@@ -4,6 +4,8 @@
 #include "../constants.h"
 
 #include <cmath>
+#include <fstream>
+#include <sstream>
 
 namespace fase {
 
@@ -256,6 +258,13 @@ void drawNodeContent(const string& n_name, const Node& node,
                 (*pcm)[p_name].setPriority(n_name, priority);
             });
         }
+        bool side_effect = node.side_effect;
+        ImGui::Checkbox(label("side effect"), &side_effect);
+        if (side_effect != node.side_effect) {
+            issues->emplace_back([side_effect, p_name, n_name](auto pcm) {
+                (*pcm)[p_name].setSideEffect(n_name, side_effect);
+            });
+        }
     }
     ImGui::EndGroup();
 }
@@ -749,6 +758,25 @@ void EditWindow::drawReportPannel(const PipelineAPI& core_api,
         }
     }
 
+    // load a report, e.g. dumped by native code with NativeCodeOptions::timing.
+    bool load_f = false;
+    if (auto raii = BeginPopupContext(label("report canvas"), true, 1)) {
+        ImGui::MenuItem(label("load report..."), "", &load_f);
+    }
+    if (auto p_raii = BeginPopupModal(label("load report popup"), load_f)) {
+        report_path_it.draw(label("filename"));
+        if (ImGui::Button(label("OK"))) {
+            std::ifstream ifs(report_path_it.text());
+            std::stringstream ss;
+            ss << ifs.rdbuf();
+            if (!ifs || !LoadReportFromString(ss.str(), &report)) {
+                err_message = "Failed to load a report from " +
+                              report_path_it.text();
+            }
+            ImGui::CloseCurrentPopup();
+        }
+    }
+
     // run this pipeline.
     if (GetIsKeyPressed('r', true)) {
         issues->emplace_back([this](auto pcm) {
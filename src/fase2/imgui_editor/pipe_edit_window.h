@@ -44,6 +44,9 @@ private:
     std::vector<InputText> input_arg_name_its;
     std::vector<InputText> output_arg_name_its;
 
+    // for load report popup
+    InputPath report_path_it{{int(10e3), 15, {".json", ".txt"}}};
+
     bool small_node_mode = false;
 
     std::map<std::string, EditWindow> children;
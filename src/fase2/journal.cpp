@@ -0,0 +1,588 @@
+#include "journal.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include "constants.h"
+#include "manager.h"
+
+namespace fase {
+
+using std::string, std::vector;
+using size_t = std::size_t;
+
+// Layout of the log (integers are little endian)
+//   "FASEJRNL" u32:checksum of the snapshot
+//   { u32:size u32:checksum u8:op str:pipeline <fields of op> }...
+// where `size` and `checksum` (FNV-1a) are of the bytes after them, and
+//   str   = u32:size bytes
+//   value = str:type u8:encoding str:bytes (as PipelineToBinary())
+// The log of another snapshot is ignored. (e.g. left by a crash in compact())
+constexpr char kJournalMagic[] = "FASEJRNL";
+
+namespace {
+
+constexpr size_t kHeaderSize = sizeof(kJournalMagic) - 1 + 4;
+
+enum class EditOp : std::uint8_t {
+    NewPipeline = 1,
+    NewNode,
+    RenameNode,
+    DelNode,
+    SetArgument,
+    SetPriority,
+    SetSideEffect,
+    SetCheckpoint,
+    AllocateFunc,
+    SmartLink,
+    UnlinkNode,
+    SetLinks,
+    BeginBatch,
+    Commit,
+    SupposeInput,
+    SupposeOutput,
+};
+
+enum class ValueEncoding : std::uint8_t {
+    Empty = 0,
+    Text = 1,
+    Binary = 2,
+};
+
+std::uint32_t Checksum(std::string_view bytes) {
+    std::uint32_t h = 2166136261u;
+    for (char c : bytes) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void AppendU32(std::uint32_t v, string* dst) {
+    for (int i = 0; i < 4; i++) {
+        *dst += char((v >> (8 * i)) & 0xff);
+    }
+}
+
+std::uint32_t ReadU32(std::string_view bytes) {
+    std::uint32_t v = 0;
+    for (int i = 3; i >= 0; i--) {
+        v = v << 8 | static_cast<unsigned char>(bytes[size_t(i)]);
+    }
+    return v;
+}
+
+string LogHeader(std::uint32_t snapshot_sum) {
+    string dst(kJournalMagic, sizeof(kJournalMagic) - 1);
+    AppendU32(snapshot_sum, &dst);
+    return dst;
+}
+
+bool ReadFile(const string& path, string* dst) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) {
+        return false;
+    }
+    std::ostringstream oss;
+    oss << ifs.rdbuf();
+    *dst = oss.str();
+    return true;
+}
+
+// Replace the file at once, not to leave a half-written one.
+bool WriteFileAtomically(const string& dir, const string& path,
+                         const string& data) {
+#ifndef _WIN32
+    mkdir(dir.c_str(), 0755);
+#endif
+    const string tmp = path + ".tmp";
+    {
+        std::ofstream ofs(tmp, std::ios::binary);
+        ofs.write(data.data(), std::streamsize(data.size()));
+        if (!ofs) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+class RecordWriter {
+public:
+    RecordWriter(EditOp op, const string& p_name) : data(8, '\0') {
+        u8(std::uint8_t(op));
+        str(p_name);
+    }
+
+    void u8(std::uint8_t v) {
+        data += char(v);
+    }
+    void u32(size_t v) {
+        AppendU32(std::uint32_t(v), &data);
+    }
+    void str(const string& s) {
+        u32(s.size());
+        data += s;
+    }
+    void strs(const vector<string>& ss) {
+        u32(ss.size());
+        for (auto& s : ss) {
+            str(s);
+        }
+    }
+    // Returns false if `v` can not be written.
+    bool value(const Variable& v, const TSCMap& converters) {
+        auto it = converters.find(v.getType());
+        if (it == converters.end()) {
+            return false;
+        }
+        const TypeStringConverters& tsc = it->second;
+        string bytes;
+        ValueEncoding encoding = ValueEncoding::Empty;
+        if (!v) {
+        } else if (tsc.encoder) {
+            encoding = ValueEncoding::Binary;
+            tsc.encoder(v, &bytes);
+        } else if (tsc.serializer) {
+            encoding = ValueEncoding::Text;
+            tsc.serializeTo(v, &bytes);
+        } else {
+            return false;
+        }
+        str(tsc.name);
+        u8(std::uint8_t(encoding));
+        str(bytes);
+        return true;
+    }
+
+    // The record following its size and checksum.
+    const string& finish() {
+        string head;
+        AppendU32(std::uint32_t(data.size() - 8), &head);
+        AppendU32(Checksum(std::string_view(data).substr(8)), &head);
+        data.replace(0, 8, head);
+        return data;
+    }
+
+private:
+    string data;
+};
+
+// Reads a record. Throws if it is broken.
+class RecordReader {
+public:
+    explicit RecordReader(std::string_view data) : rest(data) {}
+
+    std::uint8_t u8() {
+        return static_cast<std::uint8_t>(take(1)[0]);
+    }
+    std::uint32_t u32() {
+        return ReadU32(take(4));
+    }
+    string str() {
+        return string(take(u32()));
+    }
+    // Count of elements, which need at least 4 bytes for each.
+    size_t count() {
+        size_t n = u32();
+        if (rest.size() / 4 < n) {
+            throw std::runtime_error("broken count");
+        }
+        return n;
+    }
+    vector<string> strs() {
+        vector<string> dst(count());
+        for (auto& s : dst) {
+            s = str();
+        }
+        return dst;
+    }
+    Variable value(const TSCMap& converters) {
+        const string type = str();
+        auto encoding = ValueEncoding(u8());
+        const string bytes = str();
+        for (auto& [t, tsc] : converters) {
+            if (tsc.name != type) {
+                continue;
+            }
+            Variable v;
+            if (encoding == ValueEncoding::Empty) {
+                v = Variable{t};
+            } else if (encoding == ValueEncoding::Text && tsc.deserializer) {
+                tsc.deserializer(v, bytes);
+            } else if (encoding == ValueEncoding::Binary && tsc.decoder) {
+                tsc.decoder(v, bytes);
+            } else {
+                throw std::runtime_error("unknown encoding of " + type);
+            }
+            return v;
+        }
+        throw std::runtime_error("unknown type " + type);
+    }
+
+private:
+    std::string_view rest;
+
+    std::string_view take(size_t n) {
+        if (rest.size() < n) {
+            throw std::runtime_error("truncated record");
+        }
+        std::string_view dst = rest.substr(0, n);
+        rest.remove_prefix(n);
+        return dst;
+    }
+};
+
+// Call PipelineAPI of the record. Returns false if it fails.
+bool Replay(RecordReader* r, CoreManager* pcm, const TSCMap& converters) {
+    const auto op = EditOp(r->u8());
+    const string p_name = r->str();
+    PipelineAPI& pipe = (*pcm)[p_name];
+    switch (op) {
+        case EditOp::NewPipeline: return true;
+        case EditOp::NewNode: return pipe.newNode(r->str());
+        case EditOp::RenameNode: {
+            const string old_n_name = r->str();
+            return pipe.renameNode(old_n_name, r->str());
+        }
+        case EditOp::DelNode: return pipe.delNode(r->str());
+        case EditOp::SetArgument: {
+            const string n_name = r->str();
+            const size_t idx = r->u32();
+            Variable v = r->value(converters);
+            return pipe.setArgument(n_name, idx, v);
+        }
+        case EditOp::SetPriority: {
+            const string n_name = r->str();
+            return pipe.setPriority(n_name, int(std::int32_t(r->u32())));
+        }
+        case EditOp::SetSideEffect: {
+            const string n_name = r->str();
+            return pipe.setSideEffect(n_name, r->u8() != 0);
+        }
+        case EditOp::SetCheckpoint: {
+            const string n_name = r->str();
+            return pipe.setCheckpoint(n_name, r->u8() != 0);
+        }
+        case EditOp::AllocateFunc: {
+            const string f_name = r->str();
+            return pipe.allocateFunc(f_name, r->str());
+        }
+        case EditOp::SmartLink: {
+            const string src_node = r->str();
+            const size_t src_arg = r->u32();
+            const string dst_node = r->str();
+            const size_t dst_arg = r->u32();
+            return pipe.smartLink(src_node, src_arg, dst_node, dst_arg) ==
+                   LinkNodeError::None;
+        }
+        case EditOp::UnlinkNode: {
+            const string dst_node = r->str();
+            return pipe.unlinkNode(dst_node, r->u32());
+        }
+        case EditOp::SetLinks: {
+            vector<Link> links(r->count());
+            for (auto& link : links) {
+                link.src_node = r->str();
+                link.src_arg = r->u32();
+                link.dst_node = r->str();
+                link.dst_arg = r->u32();
+            }
+            vector<vector<string>> order(r->count());
+            for (auto& layer : order) {
+                layer = r->strs();
+            }
+            return pipe.setLinks(links, order);
+        }
+        case EditOp::BeginBatch: pipe.beginBatch(); return true;
+        // The result of the original commit() is not known.
+        case EditOp::Commit: pipe.commit(); return true;
+        case EditOp::SupposeInput: return pipe.supposeInput(r->strs());
+        case EditOp::SupposeOutput: return pipe.supposeOutput(r->strs());
+    }
+    throw std::runtime_error("unknown edit");
+}
+
+} // namespace
+
+class EditJournal::Impl {
+public:
+    Impl(const string& dir_, const TSCMap& converters_,
+         size_t compaction_bytes_)
+        : dir(dir_), converters(converters_),
+          compaction_bytes(compaction_bytes_) {
+        string data;
+        ReadFile(snapshotPath(), &data);
+        snapshot_sum = Checksum(data);
+        if (ReadFile(logPath(), &data) && isLogOfSnapshot(data)) {
+            log_bytes = data.size();
+        }
+    }
+
+    const string dir;
+    const TSCMap converters;
+    const size_t compaction_bytes;
+
+    std::uint32_t snapshot_sum;
+    std::ofstream log;
+    // Size of the log file, or 0 if it is not of the snapshot.
+    size_t log_bytes = 0;
+
+    string logPath() const {
+        return dir + "/" + kJournalLogFile;
+    }
+    string snapshotPath() const {
+        return dir + "/" + kJournalSnapshotFile;
+    }
+
+    bool isLogOfSnapshot(const string& data) const {
+        return data.size() >= kHeaderSize &&
+               data.compare(0, kHeaderSize, LogHeader(snapshot_sum)) == 0;
+    }
+
+    void append(RecordWriter& writer) {
+        if (!log.is_open()) {
+            if (log_bytes == 0) {
+                // Start the log of the snapshot.
+                const string header = LogHeader(snapshot_sum);
+                if (!WriteFileAtomically(dir, logPath(), header)) {
+                    std::cerr << "EditJournal : failed to write "
+                              << logPath() << std::endl;
+                    return;
+                }
+                log_bytes = header.size();
+            }
+            log.open(logPath(), std::ios::binary | std::ios::app);
+        }
+        const string& record = writer.finish();
+        log.write(record.data(), std::streamsize(record.size()));
+        log.flush();
+        log_bytes += record.size();
+    }
+};
+
+EditJournal::EditJournal(const string& dir, const TSCMap& converters,
+                         size_t compaction_bytes)
+    : pimpl(std::make_unique<Impl>(dir, converters, compaction_bytes)) {}
+
+EditJournal::~EditJournal() = default;
+
+bool EditJournal::recover(CoreManager* pcm) {
+    Impl& p = *pimpl;
+    p.log.close();
+
+    bool ok = true;
+    string snapshot;
+    if (ReadFile(p.snapshotPath(), &snapshot)) {
+        ok = LoadPipelineFromBinary(snapshot.data(), snapshot.size(), pcm,
+                                    p.converters);
+    }
+    p.snapshot_sum = Checksum(snapshot);
+
+    string data;
+    if (!ReadFile(p.logPath(), &data) || !p.isLogOfSnapshot(data)) {
+        p.log_bytes = 0;
+        return ok;
+    }
+    size_t valid = kHeaderSize;
+    std::string_view rest = std::string_view(data).substr(kHeaderSize);
+    while (rest.size() >= 8) {
+        const size_t size = ReadU32(rest.substr(0, 4));
+        if (rest.size() - 8 < size ||
+            Checksum(rest.substr(8, size)) != ReadU32(rest.substr(4, 4))) {
+            break; // torn
+        }
+        try {
+            RecordReader reader(rest.substr(8, size));
+            if (!Replay(&reader, pcm, p.converters)) {
+                std::cerr << "EditJournal : failed to replay the edit at "
+                          << valid << std::endl;
+                ok = false;
+            }
+        } catch (std::exception& e) {
+            std::cerr << "EditJournal : " << e.what() << std::endl;
+            ok = false;
+        }
+        rest.remove_prefix(8 + size);
+        valid += 8 + size;
+    }
+    if (valid < data.size() &&
+        !WriteFileAtomically(p.dir, p.logPath(), data.substr(0, valid))) {
+        // New records can not follow the torn one.
+        valid = 0;
+    }
+    p.log_bytes = valid;
+    return ok;
+}
+
+bool EditJournal::compact(const CoreManager& cm) {
+    Impl& p = *pimpl;
+    string snapshot;
+    try {
+        snapshot = AllPipelinesToBinary(cm, p.converters);
+    } catch (std::exception& e) {
+        std::cerr << "EditJournal : " << e.what() << std::endl;
+        return false;
+    }
+    if (!WriteFileAtomically(p.dir, p.snapshotPath(), snapshot)) {
+        return false;
+    }
+    // The old log is ignored from here, since it is of the old snapshot.
+    p.snapshot_sum = Checksum(snapshot);
+    p.log.close();
+    p.log_bytes = 0;
+    return true;
+}
+
+bool EditJournal::needsCompaction() const noexcept {
+    return pimpl->log_bytes > pimpl->compaction_bytes;
+}
+
+size_t EditJournal::getLogBytes() const noexcept {
+    return pimpl->log_bytes;
+}
+
+void EditJournal::newPipeline(const string& p_name) {
+    RecordWriter writer(EditOp::NewPipeline, p_name);
+    pimpl->append(writer);
+}
+
+void EditJournal::newNode(const string& p_name, const string& n_name) {
+    RecordWriter writer(EditOp::NewNode, p_name);
+    writer.str(n_name);
+    pimpl->append(writer);
+}
+
+void EditJournal::renameNode(const string& p_name, const string& old_n_name,
+                             const string& new_n_name) {
+    RecordWriter writer(EditOp::RenameNode, p_name);
+    writer.str(old_n_name);
+    writer.str(new_n_name);
+    pimpl->append(writer);
+}
+
+void EditJournal::delNode(const string& p_name, const string& n_name) {
+    RecordWriter writer(EditOp::DelNode, p_name);
+    writer.str(n_name);
+    pimpl->append(writer);
+}
+
+void EditJournal::setArgument(const string& p_name, const string& n_name,
+                              size_t idx, const Variable& var) {
+    RecordWriter writer(EditOp::SetArgument, p_name);
+    writer.str(n_name);
+    writer.u32(idx);
+    if (writer.value(var, pimpl->converters)) {
+        pimpl->append(writer);
+    }
+}
+
+void EditJournal::setPriority(const string& p_name, const string& n_name,
+                              int priority) {
+    RecordWriter writer(EditOp::SetPriority, p_name);
+    writer.str(n_name);
+    writer.u32(std::uint32_t(priority));
+    pimpl->append(writer);
+}
+
+void EditJournal::setSideEffect(const string& p_name, const string& n_name,
+                                bool side_effect) {
+    RecordWriter writer(EditOp::SetSideEffect, p_name);
+    writer.str(n_name);
+    writer.u8(side_effect);
+    pimpl->append(writer);
+}
+
+void EditJournal::setCheckpoint(const string& p_name, const string& n_name,
+                                bool enable) {
+    RecordWriter writer(EditOp::SetCheckpoint, p_name);
+    writer.str(n_name);
+    writer.u8(enable);
+    pimpl->append(writer);
+}
+
+void EditJournal::allocateFunc(const string& p_name, const string& f_name,
+                               const string& n_name) {
+    RecordWriter writer(EditOp::AllocateFunc, p_name);
+    writer.str(f_name);
+    writer.str(n_name);
+    pimpl->append(writer);
+}
+
+void EditJournal::smartLink(const string& p_name, const string& src_node,
+                            size_t src_arg, const string& dst_node,
+                            size_t dst_arg) {
+    RecordWriter writer(EditOp::SmartLink, p_name);
+    writer.str(src_node);
+    writer.u32(src_arg);
+    writer.str(dst_node);
+    writer.u32(dst_arg);
+    pimpl->append(writer);
+}
+
+void EditJournal::unlinkNode(const string& p_name, const string& dst_node,
+                             size_t dst_arg) {
+    RecordWriter writer(EditOp::UnlinkNode, p_name);
+    writer.str(dst_node);
+    writer.u32(dst_arg);
+    pimpl->append(writer);
+}
+
+void EditJournal::setLinks(const string& p_name, const vector<Link>& links,
+                           const vector<vector<string>>& order) {
+    RecordWriter writer(EditOp::SetLinks, p_name);
+    writer.u32(links.size());
+    for (auto& link : links) {
+        writer.str(link.src_node);
+        writer.u32(link.src_arg);
+        writer.str(link.dst_node);
+        writer.u32(link.dst_arg);
+    }
+    writer.u32(order.size());
+    for (auto& layer : order) {
+        writer.strs(layer);
+    }
+    pimpl->append(writer);
+}
+
+void EditJournal::beginBatch(const string& p_name) {
+    RecordWriter writer(EditOp::BeginBatch, p_name);
+    pimpl->append(writer);
+}
+
+void EditJournal::commit(const string& p_name) {
+    RecordWriter writer(EditOp::Commit, p_name);
+    pimpl->append(writer);
+}
+
+void EditJournal::supposeInput(const string&         p_name,
+                               const vector<string>& arg_names) {
+    RecordWriter writer(EditOp::SupposeInput, p_name);
+    writer.strs(arg_names);
+    pimpl->append(writer);
+}
+
+void EditJournal::supposeOutput(const string&         p_name,
+                                const vector<string>& arg_names) {
+    RecordWriter writer(EditOp::SupposeOutput, p_name);
+    writer.strs(arg_names);
+    pimpl->append(writer);
+}
+
+} // namespace fase
@@ -0,0 +1,76 @@
+#ifndef JOURNAL_H_20261018
+#define JOURNAL_H_20261018
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "variable.h"
+
+namespace fase {
+
+class CoreManager;
+
+// Append-only log of the edits of pipelines. (see CoreManager::setJournal())
+// Each edit is appended to `dir`/kJournalLogFile as a small record, and the
+// log is compacted into `dir`/kJournalSnapshotFile, which is all pipelines
+// saved by AllPipelinesToBinary(). Values are written with `converters` as
+// PipelineToBinary(), and values which can not be written are not logged.
+class EditJournal {
+public:
+    // The log is compacted when it grows over `compaction_bytes`.
+    EditJournal(const std::string& dir, const TSCMap& converters,
+                std::size_t compaction_bytes = 1 << 20);
+    EditJournal(const EditJournal&) = delete;
+    EditJournal& operator=(const EditJournal&) = delete;
+    ~EditJournal();
+
+    // Load the snapshot, and replay the log on it. `pcm` should have the
+    // functions but no pipelines, and should not log into this yet.
+    // A record torn by a crash is dropped with the following bytes.
+    // Returns false if some of them fail.
+    bool recover(CoreManager* pcm);
+    // Save all pipelines of `cm` as the snapshot, and empty the log.
+    bool compact(const CoreManager& cm);
+    bool        needsCompaction() const noexcept;
+    std::size_t getLogBytes() const noexcept;
+
+    // Records of the edits of PipelineAPI, called by CoreManager.
+    void newPipeline(const std::string& p_name);
+    void newNode(const std::string& p_name, const std::string& n_name);
+    void renameNode(const std::string& p_name, const std::string& old_n_name,
+                    const std::string& new_n_name);
+    void delNode(const std::string& p_name, const std::string& n_name);
+    void setArgument(const std::string& p_name, const std::string& n_name,
+                     std::size_t idx, const Variable& var);
+    void setPriority(const std::string& p_name, const std::string& n_name,
+                     int priority);
+    void setSideEffect(const std::string& p_name, const std::string& n_name,
+                       bool side_effect);
+    void setCheckpoint(const std::string& p_name, const std::string& n_name,
+                       bool enable);
+    void allocateFunc(const std::string& p_name, const std::string& f_name,
+                      const std::string& n_name);
+    void smartLink(const std::string& p_name, const std::string& src_node,
+                   std::size_t src_arg, const std::string& dst_node,
+                   std::size_t dst_arg);
+    void unlinkNode(const std::string& p_name, const std::string& dst_node,
+                    std::size_t dst_arg);
+    void setLinks(const std::string& p_name, const std::vector<Link>& links,
+                  const std::vector<std::vector<std::string>>& order);
+    void beginBatch(const std::string& p_name);
+    void commit(const std::string& p_name);
+    void supposeInput(const std::string&              p_name,
+                      const std::vector<std::string>& arg_names);
+    void supposeOutput(const std::string&              p_name,
+                       const std::vector<std::string>& arg_names);
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pimpl;
+};
+
+} // namespace fase
+
+#endif // JOURNAL_H_20261018
@@ -0,0 +1,768 @@
+#include "common.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "constants.h"
+#include "manager.h"
+
+namespace fase {
+
+using std::string, std::string_view, std::vector, std::map;
+using size_t = std::size_t;
+
+constexpr char kPipelineNameKey[] = "pipeline_name";
+constexpr char kPipelineKey[] = "content";
+
+constexpr char kLinksKey[] = "Links";
+constexpr char kNodesKey[] = "Nodes";
+constexpr char kInputKey[] = "Inputs";
+constexpr char kOutputKey[] = "Outputs";
+
+constexpr char kLinkSrcNNameKey[] = "src_node";
+constexpr char kLinkSrcArgKey[] = "src_arg";
+constexpr char kLinkDstNNameKey[] = "dst_node";
+constexpr char kLinkDstArgKey[] = "dst_arg";
+
+constexpr char kNodeFuncNameKey[] = "func_name";
+constexpr char kNodePriorityKey[] = "priority";
+constexpr char kNodeSideEffectKey[] = "side_effect";
+constexpr char kNodeArgsKey[] = "args";
+
+constexpr char kNodeArgNameKey[] = "name";
+constexpr char kNodeArgValueKey[] = "value";
+constexpr char kNodeArgTypeKey[] = "type";
+constexpr char kNodeArgEncodingKey[] = "encoding";
+constexpr char kNodeArgSizeKey[] = "size";
+
+// Encoding of values written with TypeStringConverters::Encoder.
+constexpr char kBase64Encoding[] = "base64";
+
+namespace {
+
+// Appends JSON to a buffer, formatted as json11::Json::dump().
+class JsonWriter {
+public:
+    explicit JsonWriter(string* out_) : out(out_) {}
+
+    void beginObject() {
+        prefix();
+        *out += '{';
+        firsts.emplace_back(true);
+    }
+    void endObject() {
+        *out += '}';
+        firsts.pop_back();
+    }
+    void beginArray() {
+        prefix();
+        *out += '[';
+        firsts.emplace_back(true);
+    }
+    void endArray() {
+        *out += ']';
+        firsts.pop_back();
+    }
+    void key(string_view k) {
+        prefix();
+        escaped(k);
+        *out += ": ";
+        after_key = true;
+    }
+
+    void value(string_view v) {
+        prefix();
+        escaped(v);
+    }
+    void value(const char* v) {
+        value(string_view(v)); // not to be a bool.
+    }
+    void value(int v) {
+        prefix();
+        *out += std::to_string(v);
+    }
+    void value(bool v) {
+        prefix();
+        *out += v ? "true" : "false";
+    }
+
+    // Empty buffer reused for values, not to allocate strings for each.
+    string& buffer() {
+        buf.clear();
+        return buf;
+    }
+
+private:
+    string* out;
+    vector<bool> firsts;
+    bool after_key = false;
+    string buf;
+
+    void prefix() {
+        if (after_key) {
+            after_key = false;
+        } else if (!firsts.empty()) {
+            if (!firsts.back()) {
+                *out += ", ";
+            }
+            firsts.back() = false;
+        }
+    }
+
+    void escaped(string_view v) {
+        *out += '"';
+        for (size_t i = 0; i < v.size(); i++) {
+            const auto ch = static_cast<unsigned char>(v[i]);
+            if (ch == '\\') {
+                *out += "\\\\";
+            } else if (ch == '"') {
+                *out += "\\\"";
+            } else if (ch == '\b') {
+                *out += "\\b";
+            } else if (ch == '\f') {
+                *out += "\\f";
+            } else if (ch == '\n') {
+                *out += "\\n";
+            } else if (ch == '\r') {
+                *out += "\\r";
+            } else if (ch == '\t') {
+                *out += "\\t";
+            } else if (ch <= 0x1f) {
+                char esc[8];
+                std::snprintf(esc, sizeof(esc), "\\u%04x", ch);
+                *out += esc;
+            } else if (ch == 0xe2 && i + 2 < v.size() &&
+                       static_cast<unsigned char>(v[i + 1]) == 0x80 &&
+                       (static_cast<unsigned char>(v[i + 2]) == 0xa8 ||
+                        static_cast<unsigned char>(v[i + 2]) == 0xa9)) {
+                // U+2028 and U+2029 break JavaScript.
+                *out += static_cast<unsigned char>(v[i + 2]) == 0xa8
+                                ? "\\u2028"
+                                : "\\u2029";
+                i += 2;
+            } else {
+                *out += v[i];
+            }
+        }
+        *out += '"';
+    }
+};
+
+// Pull parser reading JSON in place. Throws std::runtime_error if the JSON is
+// broken.
+class JsonReader {
+public:
+    JsonReader(const char* begin_, const char* end_)
+        : begin(begin_), p(begin_), end(end_) {}
+
+    // Call `f(key)` for each member, which has to read or skip the value.
+    // `key` is valid until the value is read.
+    template <typename F>
+    void object(F&& f) {
+        expect('{');
+        if (consume('}')) {
+            return;
+        }
+        do {
+            string_view k = str();
+            expect(':');
+            f(k);
+        } while (consume(','));
+        expect('}');
+    }
+    // Call `f()` for each element, which has to read or skip it.
+    template <typename F>
+    void array(F&& f) {
+        expect('[');
+        if (consume(']')) {
+            return;
+        }
+        do {
+            f();
+        } while (consume(','));
+        expect(']');
+    }
+
+    // The returned view is valid until the next string is read.
+    string_view str() {
+        expect('"');
+        const char* start = p;
+        while (p < end && *p != '"' && *p != '\\') {
+            p++;
+        }
+        if (p < end && *p == '"') {
+            return string_view(start, size_t(p++ - start));
+        }
+        buf.assign(start, p);
+        while (p < end && *p != '"') {
+            if (*p != '\\') {
+                buf += *p++;
+                continue;
+            }
+            if (++p == end) break;
+            switch (*p++) {
+                case 'b': buf += '\b'; break;
+                case 'f': buf += '\f'; break;
+                case 'n': buf += '\n'; break;
+                case 'r': buf += '\r'; break;
+                case 't': buf += '\t'; break;
+                case 'u': unicode(); break;
+                default: buf += p[-1]; break;
+            }
+        }
+        expect('"', false);
+        return buf;
+    }
+    int integer() {
+        skipSpaces();
+        char num[32];
+        size_t n = 0;
+        while (p < end && n + 1 < sizeof(num) &&
+               (std::isdigit(static_cast<unsigned char>(*p)) ||
+                (*p != '\0' && std::strchr("+-.eE", *p) != nullptr))) {
+            num[n++] = *p++;
+        }
+        num[n] = '\0';
+        char* num_end = nullptr;
+        double v = std::strtod(num, &num_end);
+        if (n == 0 || num_end != num + n) {
+            error("number");
+        }
+        return int(v);
+    }
+    bool boolean() {
+        skipSpaces();
+        if (literal("true")) return true;
+        if (literal("false")) return false;
+        error("boolean");
+        return false;
+    }
+
+    // Skip a value, and return its text.
+    string_view skip() {
+        skipSpaces();
+        const char* start = p;
+        if (p == end) {
+            error("value");
+        } else if (*p == '{') {
+            object([&](auto) { skip(); });
+        } else if (*p == '[') {
+            array([&] { skip(); });
+        } else if (*p == '"') {
+            str();
+        } else if (!literal("true") && !literal("false") && !literal("null")) {
+            integer();
+        }
+        return string_view(start, size_t(p - start));
+    }
+
+    void finish() {
+        skipSpaces();
+        if (p != end) {
+            error("end of data");
+        }
+    }
+
+private:
+    const char* begin;
+    const char* p;
+    const char* end;
+    string buf;
+
+    [[noreturn]] void error(const char* expected) const {
+        throw std::runtime_error(string("JSON error : expected ") + expected +
+                                 " at " + std::to_string(p - begin));
+    }
+    void skipSpaces() {
+        while (p < end && std::isspace(static_cast<unsigned char>(*p))) {
+            p++;
+        }
+    }
+    bool consume(char c) {
+        skipSpaces();
+        if (p < end && *p == c) {
+            p++;
+            return true;
+        }
+        return false;
+    }
+    void expect(char c, bool skip_spaces = true) {
+        if (skip_spaces) skipSpaces();
+        if (p == end || *p != c) {
+            const char expected[] = {c, '\0'};
+            error(expected);
+        }
+        p++;
+    }
+    bool literal(string_view lit) {
+        if (size_t(end - p) >= lit.size() &&
+            string_view(p, lit.size()) == lit) {
+            p += lit.size();
+            return true;
+        }
+        return false;
+    }
+    std::uint32_t hex4() {
+        if (end - p < 4) error("\\uXXXX");
+        std::uint32_t v = 0;
+        for (int i = 0; i < 4; i++) {
+            const char c = *p++;
+            v <<= 4;
+            if ('0' <= c && c <= '9') v |= std::uint32_t(c - '0');
+            else if ('a' <= c && c <= 'f') v |= std::uint32_t(c - 'a' + 10);
+            else if ('A' <= c && c <= 'F') v |= std::uint32_t(c - 'A' + 10);
+            else error("\\uXXXX");
+        }
+        return v;
+    }
+    void unicode() {
+        std::uint32_t cp = hex4();
+        if (0xd800 <= cp && cp < 0xdc00 && end - p >= 6 && p[0] == '\\' &&
+            p[1] == 'u') {
+            p += 2;
+            std::uint32_t low = hex4();
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+        }
+        if (cp < 0x80) {
+            buf += char(cp);
+        } else if (cp < 0x800) {
+            buf += char(0xc0 | (cp >> 6));
+            buf += char(0x80 | (cp & 0x3f));
+        } else if (cp < 0x10000) {
+            buf += char(0xe0 | (cp >> 12));
+            buf += char(0x80 | ((cp >> 6) & 0x3f));
+            buf += char(0x80 | (cp & 0x3f));
+        } else {
+            buf += char(0xf0 | (cp >> 18));
+            buf += char(0x80 | ((cp >> 12) & 0x3f));
+            buf += char(0x80 | ((cp >> 6) & 0x3f));
+            buf += char(0x80 | (cp & 0x3f));
+        }
+    }
+};
+
+size_t ArgNameToIdx(const string& arg_name, const FunctionUtils& f_utils) {
+    for (size_t i = 0; i < f_utils.arg_names.size(); i++) {
+        if (f_utils.arg_names[i] == arg_name) {
+            return i;
+        }
+    }
+    return size_t(-1);
+}
+
+constexpr char kBase64Chars[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+void AppendBase64(string_view src, string* dst) {
+    dst->reserve(dst->size() + (src.size() + 2) / 3 * 4);
+    auto byte = [&](size_t i) -> std::uint32_t {
+        return i < src.size() ? static_cast<unsigned char>(src[i]) : 0;
+    };
+    for (size_t i = 0; i < src.size(); i += 3) {
+        const std::uint32_t n = byte(i) << 16 | byte(i + 1) << 8 | byte(i + 2);
+        *dst += kBase64Chars[(n >> 18) & 0x3f];
+        *dst += kBase64Chars[(n >> 12) & 0x3f];
+        *dst += i + 1 < src.size() ? kBase64Chars[(n >> 6) & 0x3f] : '=';
+        *dst += i + 2 < src.size() ? kBase64Chars[n & 0x3f] : '=';
+    }
+}
+
+bool DecodeBase64(string_view src, string* dst) {
+    static const auto table = [] {
+        std::array<std::int8_t, 256> t;
+        t.fill(-1);
+        for (int i = 0; i < 64; i++) {
+            t[static_cast<unsigned char>(kBase64Chars[i])] = std::int8_t(i);
+        }
+        return t;
+    }();
+    if (src.size() % 4 != 0) {
+        return false;
+    }
+    size_t pad = 0;
+    while (pad < 2 && pad < src.size() && src[src.size() - 1 - pad] == '=') {
+        pad++;
+    }
+    dst->resize(src.size() / 4 * 3 - pad);
+    char* out = dst->data();
+    const char* out_end = out + dst->size();
+    for (size_t i = 0; i < src.size(); i += 4) {
+        std::uint32_t n = 0;
+        for (size_t j = 0; j < 4; j++) {
+            const char c = src[i + j];
+            const int v = table[static_cast<unsigned char>(c)];
+            if (v < 0 && !(c == '=' && i + j >= src.size() - pad)) {
+                return false;
+            }
+            n = n << 6 | std::uint32_t(v < 0 ? 0 : v);
+        }
+        for (int shift = 16; shift >= 0 && out < out_end; shift -= 8) {
+            *out++ = char((n >> shift) & 0xff);
+        }
+    }
+    return true;
+}
+
+const TypeStringConverters* FindConverters(const string& type,
+                                           const TSCMap& tsc_map,
+                                           std::type_index* t) {
+    for (auto& [t_, tsc] : tsc_map) {
+        if (tsc.name == type) {
+            *t = t_;
+            return &tsc;
+        }
+    }
+    return nullptr;
+}
+
+// Read an argument of a node, and return its name.
+string ReadArg(JsonReader& reader, const TSCMap& tsc_map, Variable* v) {
+    string arg_name, value, type, encoding;
+    int size = -1;
+    reader.object([&](string_view key) {
+        if (key == kNodeArgNameKey) {
+            arg_name = reader.str();
+        } else if (key == kNodeArgValueKey) {
+            value = reader.str();
+        } else if (key == kNodeArgTypeKey) {
+            type = reader.str();
+        } else if (key == kNodeArgEncodingKey) {
+            encoding = reader.str();
+        } else if (key == kNodeArgSizeKey) {
+            size = reader.integer();
+        } else {
+            reader.skip();
+        }
+    });
+
+    std::type_index t = typeid(void);
+    const TypeStringConverters* tsc = FindConverters(type, tsc_map, &t);
+    if (tsc == nullptr) {
+        return arg_name;
+    }
+    if (encoding == kBase64Encoding) {
+        string bytes;
+        if (!tsc->decoder || !DecodeBase64(value, &bytes) ||
+            (size >= 0 && size_t(size) != bytes.size())) {
+            throw std::runtime_error("broken value of " + arg_name + " (" +
+                                     type + ")");
+        }
+        tsc->decoder(*v, bytes);
+    } else if (!encoding.empty()) {
+        throw std::runtime_error("unknown encoding " + encoding);
+    } else if (!value.empty() && tsc->deserializer) {
+        tsc->deserializer(*v, value);
+    } else {
+        v->free();
+        *v = Variable{t};
+    }
+    return arg_name;
+}
+
+// ================================= Writing ===================================
+
+void WriteNodeArgs(const Node& node, const FunctionUtils& f_utils,
+                   const TSCMap& utils, JsonWriter* writer) {
+    string bytes;
+    writer->beginArray();
+    for (size_t i = 0; i < node.args.size(); i++) {
+        const Variable& arg = node.args[i];
+        auto tsc_it = utils.find(arg.getType());
+        if (tsc_it == utils.end() ||
+            (!tsc_it->second.serializer && !tsc_it->second.encoder)) {
+            continue;
+        }
+        auto& tsc = tsc_it->second;
+        const bool binary =
+                arg && tsc.encoder && (tsc.bulk || !tsc.serializer);
+        writer->beginObject();
+        writer->key(kNodeArgNameKey);
+        writer->value(f_utils.arg_names[i]);
+        writer->key(kNodeArgTypeKey);
+        writer->value(tsc.name);
+        string& value = writer->buffer();
+        if (binary) {
+            bytes.clear();
+            tsc.encoder(arg, &bytes);
+            AppendBase64(bytes, &value);
+            writer->key(kNodeArgEncodingKey);
+            writer->value(kBase64Encoding);
+            writer->key(kNodeArgSizeKey);
+            writer->value(int(bytes.size()));
+        } else if (arg) {
+            tsc.serializeTo(arg, &value);
+        }
+        writer->key(kNodeArgValueKey);
+        writer->value(value);
+        writer->endObject();
+    }
+    writer->endArray();
+}
+
+// Members are written in the order needed by ReadPipeline(), so that it can
+// read them at once.
+void WritePipeline(const PipelineAPI& pipe, const TSCMap& utils,
+                   JsonWriter* writer) {
+    auto f_util_map = pipe.getFunctionUtils();
+    auto& nodes = pipe.getNodes();
+
+    writer->beginObject();
+    writer->key(kInputKey);
+    WriteNodeArgs(nodes.at(InputNodeName()), f_util_map[kInputFuncName], utils,
+                  writer);
+    writer->key(kOutputKey);
+    WriteNodeArgs(nodes.at(OutputNodeName()), f_util_map[kOutputFuncName],
+                  utils, writer);
+
+    writer->key(kNodesKey);
+    writer->beginObject();
+    for (auto& [n_name, node] : nodes) {
+        if (n_name == InputNodeName() || n_name == OutputNodeName()) {
+            continue;
+        }
+        writer->key(n_name);
+        writer->beginObject();
+        writer->key(kNodeArgsKey);
+        WriteNodeArgs(node, f_util_map[node.func_name], utils, writer);
+        writer->key(kNodeFuncNameKey);
+        writer->value(node.func_name);
+        writer->key(kNodePriorityKey);
+        writer->value(node.priority);
+        writer->key(kNodeSideEffectKey);
+        writer->value(node.side_effect);
+        writer->endObject();
+    }
+    writer->endObject();
+
+    auto arg_name = [&](const string& n_name, size_t idx) -> const string& {
+        return f_util_map[nodes.at(n_name).func_name].arg_names.at(idx);
+    };
+    writer->key(kLinksKey);
+    writer->beginArray();
+    for (auto& link : pipe.getLinks()) {
+        writer->beginObject();
+        writer->key(kLinkDstArgKey);
+        writer->value(arg_name(link.dst_node, link.dst_arg));
+        writer->key(kLinkDstNNameKey);
+        writer->value(link.dst_node);
+        writer->key(kLinkSrcArgKey);
+        writer->value(arg_name(link.src_node, link.src_arg));
+        writer->key(kLinkSrcNNameKey);
+        writer->value(link.src_node);
+        writer->endObject();
+    }
+    writer->endArray();
+    writer->endObject();
+}
+
+// ================================= Reading ===================================
+
+void ReadInOutput(JsonReader& reader, const string& n_name,
+                  PipelineAPI& pipe_api, const TSCMap& tsc_map) {
+    vector<string> arg_names;
+    vector<Variable> vars;
+    reader.array([&] {
+        arg_names.emplace_back(ReadArg(reader, tsc_map, &vars.emplace_back()));
+    });
+    if (n_name == InputNodeName()) {
+        pipe_api.supposeInput(arg_names);
+    } else {
+        pipe_api.supposeOutput(arg_names);
+    }
+    for (size_t i = 0; i < vars.size(); i++) {
+        pipe_api.setArgument(n_name, i, vars[i]);
+    }
+}
+
+void ReadNode(JsonReader& reader, const string& n_name, PipelineAPI& pipe_api,
+              const TSCMap&                     tsc_map,
+              const map<string, FunctionUtils>& f_util_map) {
+    pipe_api.newNode(n_name);
+    // Arguments may precede the function in files written by json11.
+    string f_name;
+    vector<std::tuple<string, Variable>> args;
+    auto set_arg = [&](const string& arg_name, Variable& v) {
+        size_t idx = ArgNameToIdx(arg_name, f_util_map.at(f_name));
+        pipe_api.setArgument(n_name, idx, v);
+    };
+    reader.object([&](string_view key) {
+        if (key == kNodeFuncNameKey) {
+            f_name = reader.str();
+            pipe_api.allocateFunc(f_name, n_name);
+            for (auto& [arg_name, v] : args) {
+                set_arg(arg_name, v);
+            }
+            args.clear();
+        } else if (key == kNodePriorityKey) {
+            pipe_api.setPriority(n_name, reader.integer());
+        } else if (key == kNodeSideEffectKey) {
+            pipe_api.setSideEffect(n_name, reader.boolean());
+        } else if (key == kNodeArgsKey) {
+            reader.array([&] {
+                Variable v;
+                string arg_name = ReadArg(reader, tsc_map, &v);
+                if (f_name.empty()) {
+                    args.emplace_back(std::move(arg_name), std::move(v));
+                } else {
+                    set_arg(arg_name, v);
+                }
+            });
+        } else {
+            reader.skip();
+        }
+    });
+}
+
+void ReadLinks(JsonReader& reader, PipelineAPI& pipe_api) {
+    auto f_util_map = pipe_api.getFunctionUtils();
+    auto arg_idx = [&](const string& n_name, const string& arg_name) {
+        auto& func_name = pipe_api.getNodes().at(n_name).func_name;
+        return ArgNameToIdx(arg_name, f_util_map.at(func_name));
+    };
+    reader.array([&] {
+        string src_node, src_arg, dst_node, dst_arg;
+        reader.object([&](string_view key) {
+            if (key == kLinkSrcNNameKey) {
+                src_node = reader.str();
+            } else if (key == kLinkSrcArgKey) {
+                src_arg = reader.str();
+            } else if (key == kLinkDstNNameKey) {
+                dst_node = reader.str();
+            } else if (key == kLinkDstArgKey) {
+                dst_arg = reader.str();
+            } else {
+                reader.skip();
+            }
+        });
+        pipe_api.smartLink(src_node, arg_idx(src_node, src_arg), dst_node,
+                           arg_idx(dst_node, dst_arg));
+    });
+}
+
+void ReadPipelineMembers(JsonReader& reader, PipelineAPI& pipe_api,
+                         const TSCMap& tsc_map) {
+    // Links are read after the others. They are deferred if they come first,
+    // as in files written by json11, which sorts the keys.
+    string_view links;
+    bool has_inputs = false, has_outputs = false, has_nodes = false;
+    auto f_util_map = pipe_api.getFunctionUtils();
+    reader.object([&](string_view key) {
+        if (key == kInputKey) {
+            ReadInOutput(reader, InputNodeName(), pipe_api, tsc_map);
+            has_inputs = true;
+        } else if (key == kOutputKey) {
+            ReadInOutput(reader, OutputNodeName(), pipe_api, tsc_map);
+            has_outputs = true;
+        } else if (key == kNodesKey) {
+            reader.object([&](string_view n_name) {
+                ReadNode(reader, string(n_name), pipe_api, tsc_map,
+                         f_util_map);
+            });
+            has_nodes = true;
+        } else if (key == kLinksKey) {
+            if (has_inputs && has_outputs && has_nodes) {
+                ReadLinks(reader, pipe_api);
+            } else {
+                links = reader.skip();
+            }
+        } else {
+            reader.skip();
+        }
+    });
+    if (!links.empty()) {
+        JsonReader links_reader(links.data(), links.data() + links.size());
+        ReadLinks(links_reader, pipe_api);
+    }
+}
+
+void ReadPipeline(JsonReader& reader, PipelineAPI& pipe_api,
+                  const TSCMap& tsc_map) {
+    pipe_api.beginBatch();
+    try {
+        ReadPipelineMembers(reader, pipe_api, tsc_map);
+    } catch (...) {
+        pipe_api.commit();
+        throw;
+    }
+    pipe_api.commit();
+}
+
+} // namespace
+
+void PipelineToJson(const string& p_name, const CoreManager& cm,
+                    const TSCMap& tsc_map, string* out) {
+    vector<string> p_names;
+    for (auto& layer : cm.getDependingTree().getDependenceLayer(p_name)) {
+        Extend(layer, &p_names);
+    }
+    std::reverse(p_names.begin(), p_names.end());
+    p_names.emplace_back(p_name);
+
+    JsonWriter writer(out);
+    writer.beginArray();
+    for (auto& name : p_names) {
+        writer.beginObject();
+        writer.key(kPipelineNameKey);
+        writer.value(name);
+        writer.key(kPipelineKey);
+        WritePipeline(cm[name], tsc_map, &writer);
+        writer.endObject();
+    }
+    writer.endArray();
+}
+
+std::string PipelineToString(const string& p_name, const CoreManager& cm,
+                             const TSCMap& tsc_map) {
+    string dst;
+    PipelineToJson(p_name, cm, tsc_map, &dst);
+    return dst;
+}
+
+bool LoadPipelineFromJson(const char* data, size_t size, CoreManager* pcm,
+                          const TSCMap& tsc_map) {
+    try {
+        JsonReader reader(data, data + size);
+        reader.array([&] {
+            // The content is read again after the name, if it comes first.
+            string p_name;
+            string_view content;
+            reader.object([&](string_view key) {
+                if (key == kPipelineNameKey) {
+                    p_name = reader.str();
+                } else if (key == kPipelineKey && !p_name.empty()) {
+                    ReadPipeline(reader, (*pcm)[p_name], tsc_map);
+                } else if (key == kPipelineKey) {
+                    content = reader.skip();
+                } else {
+                    reader.skip();
+                }
+            });
+            if (!content.empty()) {
+                JsonReader content_reader(content.data(),
+                                          content.data() + content.size());
+                ReadPipeline(content_reader, (*pcm)[p_name], tsc_map);
+            }
+        });
+        reader.finish();
+        return true;
+    } catch (std::exception& e) {
+        std::cerr << "LoadPipelineFromJson Error : " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool LoadPipelineFromString(const std::string& str, CoreManager* pcm,
+                            const TSCMap& tsc_map) {
+    return LoadPipelineFromJson(str.data(), str.size(), pcm, tsc_map);
+}
+
+} // namespace fase
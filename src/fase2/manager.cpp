@@ -1,9 +1,14 @@
 
 #include "manager.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <map>
+#include <mutex>
+#include <set>
 #include <string>
+#include <utility>
 
 #include "constants.h"
 #include "core.h"
@@ -62,23 +67,32 @@ vector<std::type_index> getTypes(const deque<Variable>& vars) {
 }
 
 void CallCore(Core* pcore, const string& c_name, deque<Variable>& vs,
-              Report* preport) {
+              Report* preport, const vector<size_t>* output_idxs = nullptr) {
     size_t i_size = pcore->getNodes().at(InputNodeName()).args.size();
     size_t o_size = pcore->getNodes().at(OutputNodeName()).args.size();
     if (vs.size() != i_size + o_size) {
         throw std::logic_error("Invalid size of variables at Binded Pipe.");
     }
-    deque<Variable> inputs, outputs;
-    RefCopy(vs.begin(), vs.begin() + long(i_size), &inputs);
-    RefCopy(vs.begin() + long(i_size), vs.end(), &outputs);
+    if (!pcore->bindVariables(vs)) {
+        deque<Variable> inputs, outputs;
+        RefCopy(vs.begin(), vs.begin() + long(i_size), &inputs);
+        RefCopy(vs.begin() + long(i_size), vs.end(), &outputs);
 
-    pcore->supposeInput(inputs);
-    pcore->supposeOutput(outputs);
-    if (!pcore->run(preport)) {
+        pcore->supposeInput(inputs);
+        pcore->supposeOutput(outputs);
+    }
+    bool ok = output_idxs == nullptr ? pcore->run(preport)
+                                     : pcore->run(*output_idxs, preport);
+    if (!ok) {
         throw(std::runtime_error(c_name + " is failed!"));
     }
 }
 
+std::uint64_t NewVersion() {
+    static std::atomic<std::uint64_t> count{0};
+    return ++count;
+}
+
 } // namespace
 
 class FaildDummy : public PipelineAPI {
@@ -98,6 +112,12 @@ class FaildDummy : public PipelineAPI {
     bool setPriority(const std::string&, int) override {
         return false;
     }
+    bool setSideEffect(const std::string&, bool) override {
+        return false;
+    }
+    bool setCheckpoint(const std::string&, bool) override {
+        return false;
+    }
 
     bool allocateFunc(const std::string&, const std::string&) override {
         return false;
@@ -110,6 +130,15 @@ class FaildDummy : public PipelineAPI {
     bool unlinkNode(const std::string&, size_t) override {
         return false;
     }
+    bool setLinks(const std::vector<Link>&,
+                  const std::vector<std::vector<std::string>>&) override {
+        return false;
+    }
+
+    void beginBatch() override {}
+    bool commit() override {
+        return false;
+    }
 
     bool supposeInput(const std::vector<std::string>&) override {
         return false;
@@ -137,9 +166,23 @@ class FaildDummy : public PipelineAPI {
         return {};
     }
 
+    NodeHandle findNode(const std::string&) const override {
+        return {};
+    }
+    FunctionHandle findFunction(const std::string&) const override {
+        return {};
+    }
+    const std::string& getName(NodeHandle) const override {
+        return dum_s;
+    }
+    const std::string& getName(FunctionHandle) const override {
+        return dum_s;
+    }
+
 private:
     std::map<std::string, Node> dum_n;
     std::vector<Link> dum_l;
+    std::string dum_s;
 };
 
 // ============================== CoreManager ==================================
@@ -148,16 +191,63 @@ struct Function {
     UnivFunc func;
     deque<Variable> default_args;
     FunctionUtils utils;
+    // Counted up at each update of a pipeline.
+    size_t version = 0;
+};
+
+// Contents of a pipeline. They are shared by copies of CoreManager, and copied
+// at the first write. (see CoreManager::Impl::detach())
+struct PipeData {
+    Core core;
+
+    deque<Variable> inputs;
+    deque<Variable> outputs;
+    vector<string> input_var_names;
+    vector<string> output_var_names;
+
+    // Function::version of the functions added to `core`.
+    map<string, size_t> func_versions;
+
+    // Interned names of the nodes, indexed by the ids of NodeHandle. Ids are
+    // not reused, and the names of deleted nodes are empty.
+    vector<string> node_names = {InputNodeName(), OutputNodeName()};
+    map<string, std::uint32_t> node_ids = {{InputNodeName(), 0},
+                                           {OutputNodeName(), 1}};
+};
+
+// Pipelines and functions of a CoreManager. A copy of CoreManager shares this
+// with the original, and copies it at its first write. Only the tables are
+// copied then, and PipeData are copied as they are written.
+// (see CoreManager::Impl::writeRoot())
+struct Root {
+    struct Pipeline {
+        string name;
+        std::shared_ptr<PipeData> data;
+    };
+    // Indexed by the ids of PipelineHandle, given in the order of creation.
+    vector<Pipeline> pipelines;
+    map<string, std::uint32_t> ids;
+
+    // Shared by copies as PipeData. Functions are replaced instead of being
+    // modified.
+    map<string, std::shared_ptr<Function>> functions;
+    // Interned names of `functions`, indexed by the ids of FunctionHandle.
+    vector<string> function_names;
+    map<string, std::uint32_t> function_ids;
+    std::shared_ptr<DependenceTree> dependence_tree =
+            std::make_shared<DependenceTree>();
 };
 
 class CoreManager::Impl {
 public:
     Impl() = default;
-    Impl(const Impl&) = default;
+    Impl(const Impl& a) {
+        *this = a;
+    }
     Impl(Impl&&) = delete;
-    Impl& operator=(const Impl&) = default;
+    Impl& operator=(const Impl& a);
     Impl& operator=(Impl&&) = delete;
-    ~Impl() = default;
+    ~Impl();
 
     bool addUnivFunc(const UnivFunc& func, const std::string& name,
                      std::deque<Variable>&& default_args,
@@ -166,6 +256,13 @@ public:
     PipelineAPI& operator[](const string& c_name);
     const PipelineAPI& operator[](const string& c_name) const;
 
+    // Ids of PipelineHandle.
+    std::uint32_t getPipelineId(const string& c_name);
+    std::uint32_t findPipelineId(const string& c_name) const;
+    PipelineAPI& operator[](std::uint32_t id);
+    const PipelineAPI& operator[](std::uint32_t id) const;
+    const string& getPipelineName(std::uint32_t id) const;
+
     void setFocusedPipeline(const std::string& p_name) {
         focused_pipeline_name = p_name;
     }
@@ -174,94 +271,238 @@ public:
     }
 
     ExportedPipe exportPipe(const std::string& name) const;
+    ExportedPipe exportPipe(const std::string& name,
+                            const vector<string>& output_names) const;
 
     vector<string> getPipelineNames() const;
+    std::uint64_t getVersion() const {
+        return version;
+    }
     map<string, FunctionUtils> getFunctionUtils(const string& p_name) const;
     const DependenceTree& getDependingTree() const {
-        return dependence_tree;
+        return *root->dependence_tree;
     }
 
+    void setCheckpointStore(std::shared_ptr<const CheckpointStore> store);
+    void setMemoCache(std::shared_ptr<MemoCache> cache);
+    void setJournal(std::shared_ptr<EditJournal> journal_) {
+        journal = std::move(journal_);
+    }
+
+    // CoreManager of this, which is compacted into the journal.
+    CoreManager* owner = nullptr;
+
 private:
     class WrapedCore;
 
-    map<string, WrapedCore> wrapeds;
-    map<string, Function> functions;
+    // Maybe shared with copies of this. Written through writeRoot().
+    std::shared_ptr<Root> root = std::make_shared<Root>();
+
+    // PipelineAPI of the pipelines, indexed by the ids. They are made at the
+    // first access, also by const ones, so that copying this does not visit
+    // the pipelines.
+    mutable vector<std::unique_ptr<WrapedCore>> wrapeds;
+    mutable std::mutex wrapeds_mutex;
 
-    DependenceTree dependence_tree;
+    std::uint64_t version = NewVersion();
 
     string focused_pipeline_name;
 
+    std::shared_ptr<const CheckpointStore> checkpoint_store;
+    std::shared_ptr<MemoCache> memo_cache;
+    // Not copied, to record only the edits of the owner.
+    std::shared_ptr<EditJournal> journal;
+
     FaildDummy dum;
 
+    WrapedCore& wrap(std::uint32_t id) const;
+    bool hasPipeline(const string& c_name) const {
+        return root->ids.count(c_name);
+    }
+    const PipeData& readData(const string& c_name) const {
+        return *root->pipelines[root->ids.at(c_name)].data;
+    }
+
+    // Record an edit with `log`, and compact the journal if it has grown
+    // outside of batches.
+    template <typename Log>
+    void logEdit(Log&& log);
+
     bool newPipeline(const string& c_name);
     bool addFunction(const string& f_name, const string& c_name);
+    // As addFunction(), but the nodes calling it keep their arguments.
+    bool replaceFunction(const string& f_name, const string& c_name);
     bool updateBindedPipes(const string& c_name);
+    // Function which calls the current PipeData of `c_name`.
+    std::shared_ptr<Function> bindPipeline(const string& c_name);
+
+    // Make the Root owned only by this before writing it.
+    Root& writeRoot();
+    // Make the PipeData of `c_name` owned only by this before writing it, and
+    // of the pipelines called by it if `with_callees`. (Running a pipeline
+    // writes the ones called by it.) Pipelines which call the copied ones are
+    // also copied if shared, and call the copies.
+    void detach(const string& c_name, bool with_callees);
+    PipeData& writeData(const string& c_name);
+    // As writeData(), to run `c_name`.
+    PipeData& runData(const string& c_name);
+    DependenceTree& writeDependenceTree();
 };
 
 class CoreManager::Impl::WrapedCore : public PipelineAPI {
 public:
-    WrapedCore(CoreManager::Impl& cm) : cm_ref(std::ref(cm)) {}
+    WrapedCore(CoreManager::Impl& cm, const string& c_name_,
+               std::uint32_t id_)
+        : cm_ref(std::ref(cm)), c_name(c_name_), id(id_) {}
     ~WrapedCore() = default;
 
     bool newNode(const string& n_name) override {
         if (!CheckGoodVarName(n_name)) return false;
-        return core.newNode(n_name);
+        auto& d = write();
+        if (!d.core.newNode(n_name)) {
+            return false;
+        }
+        d.node_ids.emplace(n_name, std::uint32_t(d.node_names.size()));
+        d.node_names.emplace_back(n_name);
+        return logged(true, [&](EditJournal& j) {
+            j.newNode(myname(), n_name);
+        });
     }
 
     bool renameNode(const string& old_n_name,
                     const string& new_n_name) override {
         if (!CheckGoodVarName(new_n_name)) return false;
-        return core.renameNode(old_n_name, new_n_name);
+        auto& d = write();
+        if (!logged(d.core.renameNode(old_n_name, new_n_name),
+                    [&](EditJournal& j) {
+                        j.renameNode(myname(), old_n_name, new_n_name);
+                    })) {
+            return false;
+        }
+        // `old_n_name` may be the interned name itself.
+        auto it = d.node_ids.find(old_n_name);
+        std::uint32_t n_id = it->second;
+        d.node_ids.erase(it);
+        d.node_ids.emplace(new_n_name, n_id);
+        d.node_names[n_id] = new_n_name;
+        return true;
     }
     bool delNode(const string& n_name) override {
-        auto& d_tree = cm_ref.get().dependence_tree;
-        d_tree.del(myname(), core.getNodes().at(n_name).func_name);
-        return core.delNode(n_name);
+        auto& d = write();
+        if (!d.core.getNodes().count(n_name)) {
+            return false;
+        }
+        auto& d_tree = cm_ref.get().writeDependenceTree();
+        d_tree.del(myname(), d.core.getNodes().at(n_name).func_name);
+        if (!logged(d.core.delNode(n_name), [&](EditJournal& j) {
+                j.delNode(myname(), n_name);
+            })) {
+            return false;
+        }
+        auto it = d.node_ids.find(n_name);
+        d.node_names[it->second].clear();
+        d.node_ids.erase(it);
+        return true;
     }
 
     bool setArgument(const string& n_name, size_t idx, Variable& var) override {
+        auto& d = write();
+        bool ok = true;
         if (n_name == InputNodeName()) {
-            inputs[idx] = var.ref();
-            core.supposeInput(inputs);
-            cm_ref.get().updateBindedPipes(myname());
-            return true;
+            d.inputs[idx] = var.ref();
+            d.core.supposeInput(d.inputs);
+            updateBindedPipes();
         } else if (n_name == OutputNodeName()) {
-            outputs[idx] = var.ref();
-            core.supposeOutput(outputs);
-            cm_ref.get().updateBindedPipes(myname());
-            return true;
-        } else if (core.setArgument(n_name, idx, var)) {
-            return true;
+            d.outputs[idx] = var.ref();
+            d.core.supposeOutput(d.outputs);
+            updateBindedPipes();
         } else {
-            return false;
+            ok = d.core.setArgument(n_name, idx, var);
         }
+        return logged(ok, [&](EditJournal& j) {
+            j.setArgument(myname(), n_name, idx, var);
+        });
     }
     bool setPriority(const string& n_name, int priority) override {
-        return core.setPriority(n_name, priority);
+        return logged(write().core.setPriority(n_name, priority),
+                      [&](EditJournal& j) {
+                          j.setPriority(myname(), n_name, priority);
+                      });
+    }
+    bool setSideEffect(const string& n_name, bool side_effect) override {
+        return logged(write().core.setSideEffect(n_name, side_effect),
+                      [&](EditJournal& j) {
+                          j.setSideEffect(myname(), n_name, side_effect);
+                      });
+    }
+    bool setCheckpoint(const string& n_name, bool enable) override {
+        return logged(write().core.setCheckpoint(n_name, enable),
+                      [&](EditJournal& j) {
+                          j.setCheckpoint(myname(), n_name, enable);
+                      });
     }
 
     bool allocateFunc(const string& f_name, const string& n_name) override {
-        if (!core.getNodes().count(n_name)) {
+        auto& d = write();
+        if (!d.core.getNodes().count(n_name)) {
             return false;
         }
-        auto& d_tree = cm_ref.get().dependence_tree;
-        if (cm_ref.get().wrapeds.count(core.getNodes().at(n_name).func_name)) {
-            d_tree.del(myname(), core.getNodes().at(n_name).func_name);
+        auto& cm = cm_ref.get();
+        const string& old_f_name = d.core.getNodes().at(n_name).func_name;
+        if (cm.hasPipeline(old_f_name)) {
+            cm.writeDependenceTree().del(myname(), old_f_name);
         }
-        if (cm_ref.get().wrapeds.count(f_name)) {
-            if (d_tree.add(myname(), f_name)) {
-                return core.allocateFunc(f_name, n_name);
-            } else {
+        if (cm.hasPipeline(f_name)) {
+            if (!cm.writeDependenceTree().add(myname(), f_name)) {
                 return false;
             }
+            // Pipelines which did not call it are not updated at once.
+            if (d.func_versions[f_name] !=
+                cm.root->functions.at(f_name)->version) {
+                cm.replaceFunction(f_name, myname());
+            }
         }
-        return core.allocateFunc(f_name, n_name);
+        return logged(d.core.allocateFunc(f_name, n_name),
+                      [&](EditJournal& j) {
+                          j.allocateFunc(myname(), f_name, n_name);
+                      });
     }
 
     LinkNodeError smartLink(const string& src_node, size_t src_arg,
-                            const string& dst_node, size_t dst_arg) override;
+                            const string& dst_node, size_t dst_arg) override {
+        LinkNodeError err = link(src_node, src_arg, dst_node, dst_arg);
+        logged(err == LinkNodeError::None, [&](EditJournal& j) {
+            j.smartLink(myname(), src_node, src_arg, dst_node, dst_arg);
+        });
+        return err;
+    }
     bool unlinkNode(const string& dst_node, size_t dst_arg) override {
-        return core.unlinkNode(dst_node, dst_arg);
+        bool staged = erase_staged(dst_node, dst_arg);
+        return logged(write().core.unlinkNode(dst_node, dst_arg) || staged,
+                      [&](EditJournal& j) {
+                          j.unlinkNode(myname(), dst_node, dst_arg);
+                      });
+    }
+    bool setLinks(const vector<Link>&           links,
+                  const vector<vector<string>>& order) override {
+        staged_links.clear();
+        return logged(write().core.setLinks(links, order),
+                      [&](EditJournal& j) {
+                          j.setLinks(myname(), links, order);
+                      });
+    }
+
+    void beginBatch() override {
+        batch_depth++;
+        logged(true, [&](EditJournal& j) { j.beginBatch(myname()); });
+    }
+    bool commit() override {
+        if (batch_depth == 0) {
+            return false;
+        }
+        bool ok = applyCommit();
+        logged(true, [&](EditJournal& j) { j.commit(myname()); });
+        return ok;
     }
 
     bool supposeInput(const std::vector<std::string>& arg_names) override {
@@ -270,14 +511,17 @@ public:
                 return false;
             }
         }
-        if (CheckRepetition(arg_names, output_var_names)) {
+        auto& d = write();
+        if (CheckRepetition(arg_names, d.output_var_names)) {
             return false;
         }
-        inputs.resize(arg_names.size());
-        if (core.supposeInput(inputs)) {
-            input_var_names = arg_names;
-            cm_ref.get().updateBindedPipes(myname());
-            return true;
+        d.inputs.resize(arg_names.size());
+        if (d.core.supposeInput(d.inputs)) {
+            d.input_var_names = arg_names;
+            updateBindedPipes();
+            return logged(true, [&](EditJournal& j) {
+                j.supposeInput(myname(), arg_names);
+            });
         }
         return false;
     }
@@ -288,14 +532,17 @@ public:
                 return false;
             }
         }
-        if (CheckRepetition(arg_names, input_var_names)) {
+        auto& d = write();
+        if (CheckRepetition(arg_names, d.input_var_names)) {
             return false;
         }
-        outputs.resize(arg_names.size());
-        if (core.supposeOutput(outputs)) {
-            output_var_names = arg_names;
-            cm_ref.get().updateBindedPipes(myname());
-            return true;
+        d.outputs.resize(arg_names.size());
+        if (d.core.supposeOutput(d.outputs)) {
+            d.output_var_names = arg_names;
+            updateBindedPipes();
+            return logged(true, [&](EditJournal& j) {
+                j.supposeOutput(myname(), arg_names);
+            });
         }
         return false;
     }
@@ -304,157 +551,387 @@ public:
     bool run(Report* preport = nullptr) override;
 
     const map<string, Node>& getNodes() const noexcept override {
-        return core.getNodes();
+        return read().core.getNodes();
     }
     const vector<Link>& getLinks() const noexcept override {
-        return core.getLinks();
+        return read().core.getLinks();
     }
     map<string, FunctionUtils> getFunctionUtils() const override {
         return cm_ref.get().getFunctionUtils(myname());
     }
 
-    Core core;
+    NodeHandle findNode(const string& n_name) const override {
+        auto& ids = read().node_ids;
+        auto it = ids.find(n_name);
+        return it == ids.end() ? NodeHandle() : NodeHandle(it->second);
+    }
+    FunctionHandle findFunction(const string& f_name) const override {
+        auto& ids = cm_ref.get().root->function_ids;
+        auto it = ids.find(f_name);
+        return it == ids.end() ? FunctionHandle() : FunctionHandle(it->second);
+    }
+    const string& getName(NodeHandle node) const override {
+        auto& names = read().node_names;
+        return node.id < names.size() ? names[node.id] : empty_name;
+    }
+    const string& getName(FunctionHandle func) const override {
+        auto& names = cm_ref.get().root->function_names;
+        return func.id < names.size() ? names[func.id] : empty_name;
+    }
+
     std::reference_wrapper<Impl> cm_ref;
+    string c_name;
+    std::uint32_t id;
 
-    deque<Variable> inputs;
-    deque<Variable> outputs;
-    vector<string> input_var_names;
-    vector<string> output_var_names;
+    static inline const string empty_name;
+
+    // Edits in beginBatch() ~ commit().
+    int batch_depth = 0;
+    vector<Link> staged_links;
+    bool binding_changed = false;
+
+    const PipeData& read() const {
+        return *cm_ref.get().root->pipelines[id].data;
+    }
+    PipeData& write() {
+        return cm_ref.get().writeData(myname());
+    }
 
-    const string& myname() const {
-        for (auto& [c_name, wrapeds] : cm_ref.get().wrapeds) {
-            if (&wrapeds == this) return c_name;
+    // Record the edit into the journal if it succeeded.
+    template <typename Log>
+    bool logged(bool ok, Log&& log) {
+        if (ok) {
+            cm_ref.get().logEdit(log);
         }
-        throw std::logic_error("myname is not found!");
+        return ok;
+    }
+
+    LinkNodeError link(const string& src_node, size_t src_arg,
+                       const string& dst_node, size_t dst_arg);
+    // The outermost commit() applies the staged links.
+    bool applyCommit();
+
+    bool erase_staged(const string& dst_node, size_t dst_arg) {
+        auto it = std::remove_if(
+                staged_links.begin(), staged_links.end(), [&](auto& l) {
+                    return l.dst_node == dst_node && l.dst_arg == dst_arg;
+                });
+        bool found = it != staged_links.end();
+        staged_links.erase(it, staged_links.end());
+        return found;
+    }
+
+    void updateBindedPipes() {
+        if (batch_depth > 0) {
+            binding_changed = true;
+        } else {
+            cm_ref.get().updateBindedPipes(myname());
+        }
+    }
+
+    const string& myname() const noexcept {
+        return c_name;
     }
 };
 
 // ======================== WrapedCore Member Functions ========================
 
-LinkNodeError CoreManager::Impl::WrapedCore::smartLink(const string& src_node,
-                                                       size_t src_arg,
-                                                       const string& dst_node,
-                                                       size_t dst_arg) {
-    LinkNodeError err = core.linkNode(src_node, src_arg, dst_node, dst_arg);
+LinkNodeError CoreManager::Impl::WrapedCore::link(const string& src_node,
+                                                  size_t src_arg,
+                                                  const string& dst_node,
+                                                  size_t dst_arg) {
+    if (batch_depth > 0) {
+        // The current link to the destination is replaced at commit().
+        erase_staged(dst_node, dst_arg);
+        staged_links.emplace_back(Link{src_node, src_arg, dst_node, dst_arg});
+        return LinkNodeError::None;
+    }
+    auto& d = write();
+    LinkNodeError err = d.core.linkNode(src_node, src_arg, dst_node, dst_arg);
     if (err != LinkNodeError::InvalidType) return err;
 
     if (InputNodeName() == src_node) {
-        inputs[src_arg] = core.getNodes().at(dst_node).args[dst_arg];
-        core.supposeInput(inputs);
-        cm_ref.get().updateBindedPipes(myname());
-        return core.linkNode(src_node, src_arg, dst_node, dst_arg);
+        d.inputs[src_arg] = d.core.getNodes().at(dst_node).args[dst_arg];
+        d.core.supposeInput(d.inputs);
+        updateBindedPipes();
+        return d.core.linkNode(src_node, src_arg, dst_node, dst_arg);
 
     } else if (OutputNodeName() == dst_node) {
-        outputs[dst_arg] = core.getNodes().at(src_node).args[src_arg];
-        core.supposeOutput(outputs);
-        cm_ref.get().updateBindedPipes(myname());
-        return core.linkNode(src_node, src_arg, dst_node, dst_arg);
+        d.outputs[dst_arg] = d.core.getNodes().at(src_node).args[src_arg];
+        d.core.supposeOutput(d.outputs);
+        updateBindedPipes();
+        return d.core.linkNode(src_node, src_arg, dst_node, dst_arg);
     }
     return err;
 }
 
+bool CoreManager::Impl::WrapedCore::applyCommit() {
+    if (--batch_depth > 0) {
+        return true;
+    }
+
+    // Check the staged links one by one as smartLink(), and find the types of
+    // inputs and outputs given by them. Invalid ones are reported and skipped.
+    auto& d = write();
+    auto& nodes = d.core.getNodes();
+    deque<Variable> new_inputs, new_outputs;
+    RefCopy(d.inputs, &new_inputs);
+    RefCopy(d.outputs, &new_outputs);
+    // Ports of inputs and outputs typed by the staged links.
+    std::set<size_t> typed_inputs, typed_outputs;
+    auto arg = [&](const string& n_name, size_t idx) -> const Variable& {
+        if (n_name == InputNodeName()) {
+            return new_inputs[idx];
+        } else if (n_name == OutputNodeName()) {
+            return new_outputs[idx];
+        }
+        return nodes.at(n_name).args[idx];
+    };
+    vector<Link> accepteds;
+    bool ok = true;
+    for (auto& link : staged_links) {
+        bool valid = nodes.count(link.src_node) && nodes.count(link.dst_node) &&
+                     link.src_arg < nodes.at(link.src_node).args.size() &&
+                     link.dst_arg < nodes.at(link.dst_node).args.size();
+        if (!valid || arg(link.src_node, link.src_arg)
+                              .isSameType(arg(link.dst_node, link.dst_arg))) {
+        } else if (link.src_node == InputNodeName() &&
+                   typed_inputs.emplace(link.src_arg).second) {
+            new_inputs[link.src_arg] = arg(link.dst_node, link.dst_arg);
+        } else if (link.dst_node == OutputNodeName() &&
+                   typed_outputs.emplace(link.dst_arg).second) {
+            new_outputs[link.dst_arg] = arg(link.src_node, link.src_arg);
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            std::cerr << "PipelineAPI::commit() : " << link.src_node << ":"
+                      << link.src_arg << " -> " << link.dst_node << ":"
+                      << link.dst_arg << " in " << myname()
+                      << " is invalid, and not made." << std::endl;
+            ok = false;
+            continue;
+        }
+        accepteds.emplace_back(std::move(link));
+    }
+    staged_links.clear();
+
+    if (!accepteds.empty()) {
+        // The current links are kept unless replaced, or broken by the new
+        // types of inputs and outputs as supposeInput() does.
+        vector<Link> links;
+        for (auto& link : d.core.getLinks()) {
+            auto replaced = std::find_if(
+                    accepteds.begin(), accepteds.end(), [&](auto& l) {
+                        return l.dst_node == link.dst_node &&
+                               l.dst_arg == link.dst_arg;
+                    });
+            if (replaced == accepteds.end() &&
+                arg(link.src_node, link.src_arg)
+                        .isSameType(arg(link.dst_node, link.dst_arg))) {
+                links.emplace_back(link);
+            }
+        }
+        Extend(std::move(accepteds), &links);
+
+        vector<vector<string>> order = GetRunOrder(nodes, links);
+        if (order.empty()) {
+            ok = false; // loop
+        } else {
+            if (getTypes(d.inputs) != getTypes(new_inputs)) {
+                d.inputs = std::move(new_inputs);
+                d.core.supposeInput(d.inputs);
+                binding_changed = true;
+            }
+            if (getTypes(d.outputs) != getTypes(new_outputs)) {
+                d.outputs = std::move(new_outputs);
+                d.core.supposeOutput(d.outputs);
+                binding_changed = true;
+            }
+            ok &= d.core.setLinks(links, order);
+        }
+    }
+    if (binding_changed) {
+        binding_changed = false;
+        cm_ref.get().updateBindedPipes(myname());
+    }
+    return ok;
+}
+
 bool CoreManager::Impl::WrapedCore::call(deque<Variable>& args) {
-    if (args.size() != inputs.size() + outputs.size()) {
+    auto& d = cm_ref.get().runData(myname());
+    if (args.size() != d.inputs.size() + d.outputs.size()) {
         return false;
     }
-    for (size_t i = 0; i < inputs.size(); i++) {
-        if (args[i].getType() != inputs[i].getType()) {
+    for (size_t i = 0; i < d.inputs.size(); i++) {
+        if (args[i].getType() != d.inputs[i].getType()) {
             return false;
         }
     }
-    for (size_t i = 0; i < outputs.size(); i++) {
-        if (args[i + inputs.size()].getType() != outputs[i].getType()) {
+    for (size_t i = 0; i < d.outputs.size(); i++) {
+        if (args[i + d.inputs.size()].getType() != d.outputs[i].getType()) {
             return false;
         }
     }
 
-    CallCore(&core, myname(), args, nullptr);
+    CallCore(&d.core, myname(), args, nullptr);
     return true;
 }
 
 bool CoreManager::Impl::WrapedCore::run(Report* preport) {
-    return core.run(preport);
+    return cm_ref.get().runData(myname()).core.run(preport);
 }
 
 // ========================== Impl Member Functions ============================
 
+CoreManager::Impl::~Impl() = default;
+
+CoreManager::Impl::WrapedCore& CoreManager::Impl::wrap(std::uint32_t id) const {
+    std::lock_guard<std::mutex> lock(wrapeds_mutex);
+    if (wrapeds.size() <= id) {
+        wrapeds.resize(id + 1);
+    }
+    if (!wrapeds[id]) {
+        // Views of a const CoreManager are const too. (see operator[]())
+        wrapeds[id] = std::make_unique<WrapedCore>(const_cast<Impl&>(*this),
+                                                   root->pipelines[id].name,
+                                                   id);
+    }
+    return *wrapeds[id];
+}
+
 bool CoreManager::Impl::addFunction(const string& func, const string& core) {
+    PipeData& d = writeData(core);
+    Function& f = *root->functions.at(func);
     deque<Variable> vs;
-    RefCopy(functions[func].default_args, &vs);
-    return wrapeds.at(core).core.addUnivFunc(functions[func].func, func,
-                                             std::move(vs));
+    RefCopy(f.default_args, &vs);
+    d.func_versions[func] = f.version;
+    return d.core.addUnivFunc(f.func, func, std::move(vs), f.utils);
+}
+
+bool CoreManager::Impl::replaceFunction(const string& func,
+                                        const string& core) {
+    PipeData& d = writeData(core);
+    Function& f = *root->functions.at(func);
+    deque<Variable> vs;
+    RefCopy(f.default_args, &vs);
+    d.func_versions[func] = f.version;
+    return d.core.replaceUnivFunc(f.func, func, std::move(vs), f.utils);
 }
 
 bool CoreManager::Impl::addUnivFunc(const UnivFunc& func, const string& f_name,
                                     deque<Variable>&& default_args,
                                     FunctionUtils&& utils) {
-    if (wrapeds.count(f_name)) return false;
+    if (hasPipeline(f_name)) return false;
 
-    functions[f_name] = {
+    version = NewVersion();
+    Root& r = writeRoot();
+    r.functions[f_name] = std::make_shared<Function>(Function{
             func,
             std::move(default_args),
             std::move(utils),
-    };
-    for (auto& [c_name, _] : wrapeds) {
+    });
+    auto f_id = std::uint32_t(r.function_names.size());
+    if (r.function_ids.emplace(f_name, f_id).second) {
+        r.function_names.emplace_back(f_name);
+    }
+    for (auto& [c_name, _] : root->ids) {
         if (!addFunction(f_name, c_name)) return false;
     }
     return true;
 }
 
 bool CoreManager::Impl::newPipeline(const string& c_name) {
-    if (wrapeds.count(c_name) || functions.count(c_name)) return false;
+    if (hasPipeline(c_name) || root->functions.count(c_name)) return false;
 
     addUnivFunc(
             {}, c_name, {},
             {{}, {}, {}, FOGtype::OtherPipe, "", {}, "", "Another pipeline"});
 
-    wrapeds.emplace(c_name, *this); // create new WrapedCore.
-    for (auto& [f_name, func] : functions) {
+    // create new PipeData.
+    Root& r = writeRoot();
+    r.ids.emplace(c_name, std::uint32_t(r.pipelines.size()));
+    r.pipelines.push_back({c_name, std::make_shared<PipeData>()});
+    r.pipelines.back().data->core.setCheckpointStore(checkpoint_store);
+    r.pipelines.back().data->core.setMemoCache(memo_cache);
+    for (auto& [f_name, func] : r.functions) {
         if (c_name != f_name) {
             addFunction(f_name, c_name);
         }
     }
     updateBindedPipes(c_name);
+    logEdit([&](EditJournal& j) { j.newPipeline(c_name); });
     return true;
 }
 
-bool CoreManager::Impl::updateBindedPipes(const string& c_name) {
-    Function& func = functions[c_name];
-    auto& core = wrapeds.at(c_name).core;
+template <typename Log>
+void CoreManager::Impl::logEdit(Log&& log) {
+    if (!journal) {
+        return;
+    }
+    log(*journal);
+    if (!journal->needsCompaction()) {
+        return;
+    }
+    for (auto& wrapped : wrapeds) {
+        if (wrapped && wrapped->batch_depth > 0) {
+            return;
+        }
+    }
+    journal->compact(*owner);
+}
+
+std::shared_ptr<Function>
+CoreManager::Impl::bindPipeline(const string& c_name) {
+    PipeData& d = *root->pipelines[root->ids.at(c_name)].data;
+    auto func = std::make_shared<Function>();
+    func->version = root->functions.at(c_name)->version + 1;
+    func->utils = root->functions.at(c_name)->utils;
 
     // Update Function::func (UnivFunc)
-    func.func = [&core, c_name](deque<Variable>& vs, Report* preport) {
-        CallCore(&core, c_name, vs, preport);
+    Core* pcore = &d.core;
+    func->func = [pcore, c_name](deque<Variable>& vs, Report* preport) {
+        CallCore(pcore, c_name, vs, preport);
     };
 
     // Update Function::default_args.
-    size_t i_size = core.getNodes().at(InputNodeName()).args.size();
-    RefCopy(wrapeds.at(c_name).inputs, &func.default_args);
-    func.default_args.resize(i_size + wrapeds.at(c_name).outputs.size());
-    for (size_t i = 0; i < wrapeds.at(c_name).outputs.size(); i++) {
-        func.default_args[i + i_size] = wrapeds.at(c_name).outputs[i].ref();
+    RefCopy(d.inputs, &func->default_args);
+    for (auto& v : d.outputs) {
+        func->default_args.emplace_back(v.ref());
     }
 
     // Update Function::utils::arg_names.
-    func.utils.arg_names = wrapeds.at(c_name).input_var_names;
-    Extend(wrapeds.at(c_name).output_var_names, &func.utils.arg_names);
+    func->utils.arg_names = d.input_var_names;
+    Extend(d.output_var_names, &func->utils.arg_names);
 
     // Update Function::utils::arg_types and is_input_args
-    func.utils.arg_types.clear();
-    func.utils.is_input_args.clear();
-    for (auto& var : wrapeds.at(c_name).inputs) {
-        func.utils.arg_types.emplace_back(var.getType());
-        func.utils.is_input_args.emplace_back(true);
+    func->utils.arg_types.clear();
+    func->utils.is_input_args.clear();
+    for (auto& var : d.inputs) {
+        func->utils.arg_types.emplace_back(var.getType());
+        func->utils.is_input_args.emplace_back(true);
     }
-    for (auto& var : wrapeds.at(c_name).outputs) {
-        func.utils.arg_types.emplace_back(var.getType());
-        func.utils.is_input_args.emplace_back(false);
+    for (auto& var : d.outputs) {
+        func->utils.arg_types.emplace_back(var.getType());
+        func->utils.is_input_args.emplace_back(false);
     }
+    return func;
+}
 
-    // Add updated function to other pipelines.
-    for (auto& [other_c_name, _] : wrapeds) {
-        if (other_c_name == c_name) {
-        } else if (!addFunction(c_name, other_c_name)) {
+bool CoreManager::Impl::updateBindedPipes(const string& c_name) {
+    auto func = bindPipeline(c_name);
+    Root& r = writeRoot();
+    const FunctionUtils& old_utils = r.functions.at(c_name)->utils;
+    const bool changed = old_utils.arg_types != func->utils.arg_types ||
+                         old_utils.is_input_args != func->utils.is_input_args;
+    r.functions[c_name] = std::move(func);
+
+    // Update the pipelines which call this. Their nodes are reallocated only
+    // if the arguments are changed. Others get it when they allocate it.
+    // (see WrapedCore::allocateFunc())
+    for (auto& other_c_name : r.dependence_tree->getDependeds(c_name)) {
+        if (changed ? !addFunction(c_name, other_c_name)
+                    : !replaceFunction(c_name, other_c_name)) {
             std::cerr << "CoreManager::updateBindedPipes(\"" + c_name +
                                  "\") : something went wrong at "
                       << other_c_name << std::endl;
@@ -464,23 +941,167 @@ bool CoreManager::Impl::updateBindedPipes(const string& c_name) {
     return true;
 }
 
-PipelineAPI& CoreManager::Impl::operator[](const string& c_name) {
-    if (!wrapeds.count(c_name) &&
+Root& CoreManager::Impl::writeRoot() {
+    if (root.use_count() > 1) {
+        // PipeData, functions and the tree are shared with the copies here.
+        root = std::make_shared<Root>(*root);
+    }
+    return *root;
+}
+
+void CoreManager::Impl::detach(const string& c_name, bool with_callees) {
+    Root& r = writeRoot();
+    auto copy = [&](const string& name) {
+        auto& data = r.pipelines[r.ids.at(name)].data;
+        if (data.use_count() == 1) {
+            return false;
+        }
+        data = std::make_shared<PipeData>(*data);
+        // Bind the copied inputs and outputs to the copied Core.
+        data->core.supposeInput(data->inputs);
+        data->core.supposeOutput(data->outputs);
+        return true;
+    };
+
+    std::set<string> copieds;
+    if (copy(c_name)) {
+        copieds.emplace(c_name);
+    }
+    if (with_callees) {
+        for (auto& layer : r.dependence_tree->getDependenceLayer(c_name)) {
+            for (auto& name : layer) {
+                if (copy(name)) {
+                    copieds.emplace(name);
+                }
+            }
+        }
+    }
+    if (copieds.empty()) {
+        return;
+    }
+
+    // Pipelines which call the copied ones.
+    std::set<string> callers;
+    for (auto& name : copieds) {
+        for (auto& caller : r.dependence_tree->getAllDependeds(name)) {
+            callers.emplace(caller);
+        }
+    }
+    for (auto& caller : callers) {
+        if (copy(caller)) {
+            copieds.emplace(caller);
+        }
+    }
+
+    // Call the copies.
+    for (auto& name : copieds) {
+        r.functions[name] = bindPipeline(name);
+    }
+    for (auto& caller : callers) {
+        PipeData& d = *r.pipelines[r.ids.at(caller)].data;
+        for (auto& name : r.dependence_tree->getDependings(caller)) {
+            if (!copieds.count(name)) {
+                continue;
+            }
+            Function& f = *r.functions.at(name);
+            deque<Variable> vs;
+            RefCopy(f.default_args, &vs);
+            d.func_versions[name] = f.version;
+            d.core.replaceUnivFunc(f.func, name, std::move(vs), f.utils);
+        }
+    }
+}
+
+PipeData& CoreManager::Impl::writeData(const string& c_name) {
+    version = NewVersion();
+    detach(c_name, false);
+    return *root->pipelines[root->ids.at(c_name)].data;
+}
+
+PipeData& CoreManager::Impl::runData(const string& c_name) {
+    detach(c_name, true);
+    return *root->pipelines[root->ids.at(c_name)].data;
+}
+
+DependenceTree& CoreManager::Impl::writeDependenceTree() {
+    version = NewVersion();
+    Root& r = writeRoot();
+    if (r.dependence_tree.use_count() > 1) {
+        r.dependence_tree =
+                std::make_shared<DependenceTree>(*r.dependence_tree);
+    }
+    return *r.dependence_tree;
+}
+
+CoreManager::Impl& CoreManager::Impl::operator=(const Impl& a) {
+    if (this == &a) {
+        return *this;
+    }
+    // Shared with `a` until either of them is written.
+    root = a.root;
+    version = a.version;
+    focused_pipeline_name = a.focused_pipeline_name;
+    checkpoint_store = a.checkpoint_store;
+    memo_cache = a.memo_cache;
+    // Views of the old pipelines, with their batches.
+    wrapeds.clear();
+
+    // The pipelines are replaced without records, so save all of them.
+    if (journal && !journal->compact(*owner)) {
+        std::cerr << "CoreManager : failed to save assigned pipelines into "
+                     "the journal, which is detached."
+                  << std::endl;
+        journal.reset();
+    }
+    return *this;
+}
+
+std::uint32_t CoreManager::Impl::getPipelineId(const string& c_name) {
+    if (!hasPipeline(c_name) &&
         (!CheckGoodVarName(c_name) || !newPipeline(c_name))) {
+        return PipelineHandle::kInvalidId;
+    }
+    return root->ids.at(c_name);
+}
+
+std::uint32_t CoreManager::Impl::findPipelineId(const string& c_name) const {
+    auto it = root->ids.find(c_name);
+    return it == root->ids.end() ? PipelineHandle::kInvalidId : it->second;
+}
+
+PipelineAPI& CoreManager::Impl::operator[](std::uint32_t id) {
+    if (root->pipelines.size() <= id) {
         return dum;
     }
-    return wrapeds.at(c_name);
+    return wrap(id);
 }
 
-const PipelineAPI& CoreManager::Impl::operator[](const string& c_name) const {
-    if (!wrapeds.count(c_name)) {
+const PipelineAPI& CoreManager::Impl::operator[](std::uint32_t id) const {
+    if (root->pipelines.size() <= id) {
+        return dum;
+    }
+    return wrap(id);
+}
+
+const string& CoreManager::Impl::getPipelineName(std::uint32_t id) const {
+    static const string empty;
+    return root->pipelines.size() <= id ? empty : wrap(id).myname();
+}
+
+PipelineAPI& CoreManager::Impl::operator[](const string& c_name) {
+    std::uint32_t id = getPipelineId(c_name);
+    if (id == PipelineHandle::kInvalidId) {
         return dum;
     }
-    return wrapeds.at(c_name);
+    return wrap(id);
+}
+
+const PipelineAPI& CoreManager::Impl::operator[](const string& c_name) const {
+    return (*this)[findPipelineId(c_name)];
 }
 
 bool ExportedPipe::operator()(std::deque<Variable>& vs) {
-    if (!reseter) {
+    if (!program) {
         return false;
     }
     if (vs.size() != types.size()) {
@@ -492,65 +1113,145 @@ bool ExportedPipe::operator()(std::deque<Variable>& vs) {
         }
     }
 
-    CallCore(&core, "ExportedPipe", vs, nullptr);
+    if (compiling.valid() && compiling.wait_for(std::chrono::seconds(0)) ==
+                                     std::future_status::ready) {
+        swapToNative();
+    }
+    if (native) {
+        if (!native_state) {
+            native_state = native->create();
+        } else if (native_state.use_count() > 1) {
+            native_state = native->clone(native_state.get());
+        }
+        native->call(native_state.get(), vs);
+        return true;
+    }
+
+    if (!state) {
+        state = std::make_shared<Core>(*program);
+    } else if (state.use_count() > 1) {
+        state = std::make_shared<Core>(*state);
+    }
+    CallCore(state.get(), "ExportedPipe", vs, nullptr, &output_idxs);
     return true;
 }
 
+void ExportedPipe::reset() {
+    native_state.reset();
+    if (state && state.use_count() == 1 &&
+        state->resetStatefulNodes(*program)) {
+        return;
+    }
+    state.reset(); // copied from `program` again at next call.
+}
+
+void ExportedPipe::compileInBackground(const std::string& code,
+                                       const NativeCompileOptions& options) {
+    if (!program) {
+        return;
+    }
+    compiling = std::async(std::launch::async, [code, options]() {
+                    return CompileNativeModule(code, options);
+                }).share();
+}
+
+bool ExportedPipe::waitNative() {
+    if (compiling.valid()) {
+        swapToNative();
+    }
+    return bool(native);
+}
+
+void ExportedPipe::swapToNative() {
+    native = compiling.get();
+    compiling = {};
+    native_state.reset();
+}
+
 ExportedPipe CoreManager::Impl::exportPipe(const std::string& e_c_name) const {
-    if (!wrapeds.count(e_c_name)) {
+    if (!hasPipeline(e_c_name)) {
         return {{}, {}, {}};
     }
-    auto d_layer = dependence_tree.getDependenceLayer(e_c_name);
-    d_layer.emplace(d_layer.begin(), vector<string>{e_c_name});
+    return exportPipe(e_c_name, readData(e_c_name).output_var_names);
+}
 
-    map<string, Core> cores;
-    map<string, deque<Variable>> default_args_map;
-    for (auto& cs : d_layer) {
-        for (auto& c_name : cs) {
-            cores.emplace(c_name, wrapeds.at(c_name).core);
-            deque<Variable> default_args = wrapeds.at(c_name).inputs;
-            Extend(wrapeds.at(c_name).outputs, &default_args);
-            default_args_map.emplace(c_name, std::move(default_args));
+ExportedPipe
+CoreManager::Impl::exportPipe(const std::string& e_c_name,
+                              const vector<string>& output_names) const {
+    if (!hasPipeline(e_c_name)) {
+        return {{}, {}, {}};
+    }
+    auto& o_names = readData(e_c_name).output_var_names;
+    vector<size_t> output_idxs;
+    for (auto& name : output_names) {
+        auto it = std::find(o_names.begin(), o_names.end(), name);
+        if (it == o_names.end()) {
+            return {{}, {}, {}};
         }
+        output_idxs.emplace_back(size_t(it - o_names.begin()));
     }
 
-    for (auto it = d_layer.rbegin() + 1; it != d_layer.rend(); it++) {
+    auto d_layer = root->dependence_tree->getDependenceLayer(e_c_name);
+    d_layer.emplace(d_layer.begin(), vector<string>{e_c_name});
+
+    PlanOptions options;
+    options.fuse_pure_chains = true;
+    options.fold_constants = true;
+    options.prune_dead_nodes = true;
+
+    // Inline sub pipelines from the deepest ones, so that the exported
+    // pipeline is a flat graph of functions. Unlike in the editor, each
+    // calling node has its own states of the sub pipeline.
+    map<string, Core> cores;
+    for (auto it = d_layer.rbegin(); it != d_layer.rend(); it++) {
         for (auto& c_name : *it) {
-            for (auto d_c_name : dependence_tree.getDependings(c_name)) {
-                struct {
-                    Core core;
-                    const string c_name;
-                    void operator()(deque<Variable>& vs, Report*) {
-                        CallCore(&core, c_name, vs, nullptr);
-                    }
-                } f = {cores.at(d_c_name), d_c_name};
-                cores.at(c_name).addUnivFunc(
-                        std::move(f), d_c_name,
-                        deque<Variable>{default_args_map.at(d_c_name)});
+            if (cores.count(c_name)) {
+                continue;
+            }
+            const Core& origin = readData(c_name).core;
+            Core core = origin;
+            for (auto& [n_name, node] : origin.getNodes()) {
+                if (cores.count(node.func_name) &&
+                    !core.inlineNode(n_name, cores.at(node.func_name))) {
+                    return {{}, {}, {}};
+                }
             }
+            core.setPlanOptions(options);
+            cores.emplace(c_name, std::move(core));
         }
     }
     vector<std::type_index> types;
-    for (auto& v : wrapeds.at(e_c_name).inputs) {
+    for (auto& v : readData(e_c_name).inputs) {
         types.emplace_back(v.getType());
     }
-    for (auto& v : wrapeds.at(e_c_name).outputs) {
+    for (auto& v : readData(e_c_name).outputs) {
         types.emplace_back(v.getType());
     }
 
-    Core core = std::move(cores.at(e_c_name));
-    Core core2 = core;
+    return ExportedPipe{std::make_shared<const Core>(
+                                std::move(cores.at(e_c_name))),
+                        std::move(types), std::move(output_idxs)};
+}
+
 
-    return ExportedPipe{std::move(core),
-                        [default_core = std::move(core2)](Core* pcore) {
-                            *pcore = default_core;
-                        },
-                        std::move(types)};
+void CoreManager::Impl::setCheckpointStore(
+        std::shared_ptr<const CheckpointStore> store) {
+    checkpoint_store = std::move(store);
+    for (auto& [c_name, _] : writeRoot().ids) {
+        writeData(c_name).core.setCheckpointStore(checkpoint_store);
+    }
+}
+
+void CoreManager::Impl::setMemoCache(std::shared_ptr<MemoCache> cache) {
+    memo_cache = std::move(cache);
+    for (auto& [c_name, _] : writeRoot().ids) {
+        writeData(c_name).core.setMemoCache(memo_cache);
+    }
 }
 
 vector<string> CoreManager::Impl::getPipelineNames() const {
     vector<string> dst;
-    for (auto& [c_name, _] : wrapeds) {
+    for (auto& [c_name, _] : root->ids) {
         dst.emplace_back(c_name);
     }
     return dst;
@@ -558,23 +1259,24 @@ vector<string> CoreManager::Impl::getPipelineNames() const {
 
 map<string, FunctionUtils>
 CoreManager::Impl::getFunctionUtils(const string& p_name) const {
-    if (!wrapeds.count(p_name)) {
+    if (!hasPipeline(p_name)) {
         return {};
     }
     map<string, FunctionUtils> dst;
     dst[""];
-    auto& i_names = wrapeds.at(p_name).input_var_names;
+    const PipeData& d = readData(p_name);
+    auto& i_names = d.input_var_names;
     dst[kInputFuncName] = {i_names,
-                           getTypes(wrapeds.at(p_name).inputs),
+                           getTypes(d.inputs),
                            vector<bool>(i_names.size(), false),
                            FOGtype::Special,
                            "",
                            {},
                            "",
                            ""};
-    auto& o_names = wrapeds.at(p_name).output_var_names;
+    auto& o_names = d.output_var_names;
     dst[kOutputFuncName] = {o_names,
-                            getTypes(wrapeds.at(p_name).outputs),
+                            getTypes(d.outputs),
                             vector<bool>(o_names.size(), true),
                             FOGtype::Special,
                             "",
@@ -582,9 +1284,9 @@ CoreManager::Impl::getFunctionUtils(const string& p_name) const {
                             "",
                             ""};
 
-    for (auto& [f_name, func] : functions) {
+    for (auto& [f_name, func] : root->functions) {
         if (f_name != p_name) {
-            dst[f_name] = func.utils;
+            dst[f_name] = func->utils;
         }
     }
     return dst;
@@ -592,12 +1294,20 @@ CoreManager::Impl::getFunctionUtils(const string& p_name) const {
 
 // ============================== Pimpl Pattern ================================
 
-CoreManager::CoreManager() : pimpl(std::make_unique<Impl>()) {}
+CoreManager::CoreManager() : pimpl(std::make_unique<Impl>()) {
+    pimpl->owner = this;
+}
 CoreManager::CoreManager(const CoreManager& a)
-    : pimpl(std::make_unique<Impl>(*a.pimpl)) {}
+    : pimpl(std::make_unique<Impl>(*a.pimpl)) {
+    pimpl->owner = this;
+}
 CoreManager::CoreManager(CoreManager& a)
-    : pimpl(std::make_unique<Impl>(*a.pimpl)) {}
-CoreManager::CoreManager(CoreManager&&) = default;
+    : pimpl(std::make_unique<Impl>(*a.pimpl)) {
+    pimpl->owner = this;
+}
+CoreManager::CoreManager(CoreManager&& a) : pimpl(std::move(a.pimpl)) {
+    pimpl->owner = this;
+}
 CoreManager& CoreManager::operator=(const CoreManager& a) {
     *pimpl = *a.pimpl;
     return *this;
@@ -606,7 +1316,11 @@ CoreManager& CoreManager::operator=(CoreManager& a) {
     *pimpl = *a.pimpl;
     return *this;
 }
-CoreManager& CoreManager::operator=(CoreManager&&) = default;
+CoreManager& CoreManager::operator=(CoreManager&& a) {
+    pimpl = std::move(a.pimpl);
+    pimpl->owner = this;
+    return *this;
+}
 CoreManager::~CoreManager() = default;
 
 bool CoreManager::addUnivFunc(const UnivFunc& func, const string& c_name,
@@ -623,6 +1337,22 @@ const PipelineAPI& CoreManager::operator[](const string& c_name) const {
     return std::as_const(*pimpl)[c_name];
 }
 
+PipelineHandle CoreManager::getHandle(const string& c_name) {
+    return PipelineHandle(pimpl->getPipelineId(c_name));
+}
+PipelineHandle CoreManager::findHandle(const string& c_name) const {
+    return PipelineHandle(pimpl->findPipelineId(c_name));
+}
+PipelineAPI& CoreManager::operator[](PipelineHandle handle) {
+    return (*pimpl)[handle.id];
+}
+const PipelineAPI& CoreManager::operator[](PipelineHandle handle) const {
+    return std::as_const(*pimpl)[handle.id];
+}
+const string& CoreManager::getName(PipelineHandle handle) const {
+    return pimpl->getPipelineName(handle.id);
+}
+
 void CoreManager::setFocusedPipeline(const string& p_name) {
     return pimpl->setFocusedPipeline(p_name);
 }
@@ -634,10 +1364,20 @@ ExportedPipe CoreManager::exportPipe(const std::string& name) const {
     return pimpl->exportPipe(name);
 }
 
+ExportedPipe
+CoreManager::exportPipe(const std::string&              name,
+                        const std::vector<std::string>& output_names) const {
+    return pimpl->exportPipe(name, output_names);
+}
+
 vector<string> CoreManager::getPipelineNames() const {
     return pimpl->getPipelineNames();
 }
 
+std::uint64_t CoreManager::getVersion() const {
+    return pimpl->getVersion();
+}
+
 map<string, FunctionUtils>
 CoreManager::getFunctionUtils(const string& p_name) const {
     return pimpl->getFunctionUtils(p_name);
@@ -647,4 +1387,17 @@ const DependenceTree& CoreManager::getDependingTree() const {
     return pimpl->getDependingTree();
 }
 
+void CoreManager::setCheckpointStore(
+        std::shared_ptr<const CheckpointStore> store) {
+    pimpl->setCheckpointStore(std::move(store));
+}
+
+void CoreManager::setMemoCache(std::shared_ptr<MemoCache> cache) {
+    pimpl->setMemoCache(std::move(cache));
+}
+
+void CoreManager::setJournal(std::shared_ptr<EditJournal> journal) {
+    pimpl->setJournal(std::move(journal));
+}
+
 } // namespace fase
@@ -2,6 +2,8 @@
 #ifndef MANAGER_H_20190217
 #define MANAGER_H_20190217
 
+#include <cstdint>
+#include <future>
 #include <map>
 #include <memory>
 #include <string>
@@ -9,6 +11,8 @@
 
 #include "common.h"
 #include "core.h"
+#include "journal.h"
+#include "native_pipe.h"
 #include "utils.h"
 #include "variable.h"
 
@@ -18,23 +22,69 @@ class CoreManager;
 
 class ExportedPipe {
 public:
-    ExportedPipe(Core&& core_, std::function<void(Core*)>&& reseter_,
-                 std::vector<std::type_index>&& types_)
-        : core(std::move(core_)), reseter(std::move(reseter_)),
-          types(std::move(types_)) {}
+    ExportedPipe(std::shared_ptr<const Core>&& program_,
+                 std::vector<std::type_index>&& types_,
+                 std::vector<std::size_t>&&     output_idxs_)
+        : program(std::move(program_)), types(std::move(types_)),
+          output_idxs(std::move(output_idxs_)) {}
 
     bool operator()(std::deque<Variable>& vs);
          operator bool() {
-        return bool(reseter);
-    }
-    void reset() {
-        reseter(&core);
+        return bool(program);
     }
+    void reset();
+
+    // Compile `code` generated by GenNativeModuleCode() in background, and
+    // call it instead of `program` once loaded. States of the nodes start
+    // over at the swap.
+    void compileInBackground(const std::string&          code,
+                             const NativeCompileOptions& options = {});
+    // Wait for the compilation, and return whether the native code is used.
+    bool waitNative();
 
 private:
-    Core                         core;
-    std::function<void(Core*)>   reseter;
+    // Shared by copies of this, and never modified.
+    std::shared_ptr<const Core> program;
+    // Running state, copied from `program` on write.
+    std::shared_ptr<Core>        state;
     std::vector<std::type_index> types;
+    std::vector<std::size_t>     output_idxs;
+
+    std::shared_future<std::shared_ptr<const NativeModule>> compiling;
+    std::shared_ptr<const NativeModule>                     native;
+    // Instance of `native`, copied on write as `state`.
+    std::shared_ptr<void> native_state;
+
+    void swapToNative();
+};
+
+// Pipeline of a CoreManager, looked up without its name. It stays valid in
+// copies of the CoreManager, since pipelines are never removed.
+// Nodes, functions and ports have their handles too. (see NodeHandle)
+class PipelineHandle {
+public:
+    static constexpr std::uint32_t kInvalidId = ~std::uint32_t(0);
+
+    PipelineHandle() = default;
+
+    explicit operator bool() const noexcept {
+        return id != kInvalidId;
+    }
+    bool operator==(const PipelineHandle& a) const noexcept {
+        return id == a.id;
+    }
+    bool operator!=(const PipelineHandle& a) const noexcept {
+        return id != a.id;
+    }
+    bool operator<(const PipelineHandle& a) const noexcept {
+        return id < a.id;
+    }
+
+private:
+    friend class CoreManager;
+    explicit PipelineHandle(std::uint32_t id_) : id(id_) {}
+
+    std::uint32_t id = kInvalidId;
 };
 
 class CoreManager {
@@ -57,16 +107,45 @@ public:
     PipelineAPI&       operator[](const std::string& name);
     const PipelineAPI& operator[](const std::string& name) const;
 
+    // The pipeline is created as operator[](), if it does not exist.
+    // The returned handle is invalid if `name` is not a good name.
+    PipelineHandle getHandle(const std::string& name);
+    PipelineHandle findHandle(const std::string& name) const;
+    // A dummy which always fails is returned for invalid handles.
+    PipelineAPI&       operator[](PipelineHandle handle);
+    const PipelineAPI& operator[](PipelineHandle handle) const;
+    // Empty for invalid handles.
+    const std::string& getName(PipelineHandle handle) const;
+
     void        setFocusedPipeline(const std::string& pipeline_name);
     std::string getFocusedPipeline() const;
 
     ExportedPipe exportPipe(const std::string& name) const;
+    // Only outputs of `output_names` are computed by the returned pipe.
+    ExportedPipe exportPipe(const std::string&              name,
+                            const std::vector<std::string>& output_names) const;
+
+    // Changed at each edit of the pipelines and the functions, and unique
+    // among CoreManagers. Copies have the version of the original until
+    // edited. Running pipelines does not change it.
+    std::uint64_t getVersion() const;
 
     std::vector<std::string> getPipelineNames() const;
     std::map<std::string, FunctionUtils>
                           getFunctionUtils(const std::string& p_name) const;
     const DependenceTree& getDependingTree() const;
 
+    // Used by all pipelines for checkpoints of their nodes. (see
+    // Core::setCheckpoint())
+    void setCheckpointStore(std::shared_ptr<const CheckpointStore> store);
+    // Shared by all pipelines, and by the pipes exported from them.
+    void setMemoCache(std::shared_ptr<MemoCache> cache);
+    // Edits of pipelines are recorded into `journal` from here, and it is
+    // compacted with this when it grows, or when pipelines are assigned to
+    // this by operator=(). Copies of this do not record.
+    // Recover the pipelines with EditJournal::recover() before setting.
+    void setJournal(std::shared_ptr<EditJournal> journal);
+
 private:
     class Impl;
     std::unique_ptr<Impl> pimpl;
@@ -0,0 +1,185 @@
+#include "memo_cache.h"
+
+#include <list>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+
+#include "utils.h"
+
+namespace fase {
+
+using std::string, std::vector;
+using size_t = std::size_t;
+
+namespace {
+
+struct Entry {
+    size_t hash;
+    string f_name;
+    // Encoded inputs. (MemoCache::Key::inputs)
+    string inputs;
+    // Outputs and their indices in the arguments.
+    vector<std::tuple<size_t, Variable>> outputs;
+    size_t bytes;
+};
+
+} // namespace
+
+class MemoCache::Impl {
+public:
+    Impl(size_t budget_, const TSCMap& converters_)
+        : budget(budget_), converters(converters_) {}
+
+    const size_t budget;
+    const TSCMap converters;
+
+    mutable std::mutex mutex;
+    std::set<string> enableds;
+    // The most recently used is the front.
+    std::list<Entry> entries;
+    std::unordered_multimap<size_t, std::list<Entry>::iterator> index;
+    size_t used = 0;
+
+    std::list<Entry>::iterator find(const Key& key, const string& f_name) {
+        auto [begin, end] = index.equal_range(key.hash);
+        for (auto it = begin; it != end; it++) {
+            if (it->second->f_name == f_name &&
+                it->second->inputs == key.inputs) {
+                return it->second;
+            }
+        }
+        return entries.end();
+    }
+
+    void erase(std::list<Entry>::iterator entry) {
+        auto [begin, end] = index.equal_range(entry->hash);
+        for (auto it = begin; it != end; it++) {
+            if (it->second == entry) {
+                index.erase(it);
+                break;
+            }
+        }
+        used -= entry->bytes;
+        entries.erase(entry);
+    }
+};
+
+MemoCache::MemoCache(size_t budget_bytes, const TSCMap& converters)
+    : pimpl(std::make_unique<Impl>(budget_bytes, converters)) {}
+
+MemoCache::~MemoCache() = default;
+
+void MemoCache::enable(const string& f_name, bool enable) {
+    std::lock_guard<std::mutex> lock(pimpl->mutex);
+    if (enable) {
+        pimpl->enableds.emplace(f_name);
+    } else {
+        pimpl->enableds.erase(f_name);
+    }
+}
+
+bool MemoCache::isEnabled(const string& f_name) const {
+    std::lock_guard<std::mutex> lock(pimpl->mutex);
+    return pimpl->enableds.count(f_name) > 0;
+}
+
+std::optional<MemoCache::Key>
+MemoCache::makeKey(const string& f_name, const std::deque<Variable>& args,
+                   const vector<bool>& is_input_args) const {
+    Fnv1aHasher hasher;
+    hasher.add(f_name);
+    Key key{0, {}, 0};
+    string buf;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (!is_input_args[i]) {
+            continue;
+        }
+        auto it = pimpl->converters.find(args[i].getType());
+        if (it == pimpl->converters.end() || !it->second.encoder ||
+            !args[i]) {
+            return std::nullopt;
+        }
+        buf.clear();
+        it->second.encoder(args[i], &buf);
+        if (it->second.hasher) {
+            hasher.add(std::uint64_t(it->second.hasher(args[i])));
+        } else {
+            hasher.add(buf);
+        }
+        key.inputs += std::to_string(buf.size()) + ":";
+        key.inputs += buf;
+        key.bytes += buf.size();
+    }
+    key.hash = size_t(hasher.value());
+    return key;
+}
+
+bool MemoCache::load(const Key& key, const string& f_name,
+                     std::deque<Variable>& args) {
+    std::lock_guard<std::mutex> lock(pimpl->mutex);
+    auto entry = pimpl->find(key, f_name);
+    if (entry == pimpl->entries.end()) {
+        return false;
+    }
+    pimpl->entries.splice(pimpl->entries.begin(), pimpl->entries, entry);
+    for (auto& [idx, v] : entry->outputs) {
+        v.copyTo(args[idx]);
+    }
+    return true;
+}
+
+void MemoCache::store(const Key& key, const string& f_name,
+                      const std::deque<Variable>& args,
+                      const vector<bool>& is_input_args) {
+    Entry entry{key.hash, f_name, key.inputs, {}, key.bytes};
+    string buf;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (is_input_args[i]) {
+            continue;
+        }
+        auto it = pimpl->converters.find(args[i].getType());
+        if (it == pimpl->converters.end() || !it->second.encoder ||
+            !args[i]) {
+            return;
+        }
+        buf.clear();
+        it->second.encoder(args[i], &buf);
+        entry.bytes += buf.size();
+        entry.outputs.emplace_back(i, args[i].clone());
+    }
+    if (entry.bytes > pimpl->budget) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(pimpl->mutex);
+    auto old = pimpl->find(key, f_name);
+    if (old != pimpl->entries.end()) {
+        pimpl->erase(old);
+    }
+    while (pimpl->used + entry.bytes > pimpl->budget) {
+        pimpl->erase(std::prev(pimpl->entries.end()));
+    }
+    pimpl->used += entry.bytes;
+    pimpl->entries.emplace_front(std::move(entry));
+    pimpl->index.emplace(key.hash, pimpl->entries.begin());
+}
+
+void MemoCache::clear() {
+    std::lock_guard<std::mutex> lock(pimpl->mutex);
+    pimpl->entries.clear();
+    pimpl->index.clear();
+    pimpl->used = 0;
+}
+
+size_t MemoCache::getBudget() const noexcept {
+    return pimpl->budget;
+}
+
+size_t MemoCache::getUsedBytes() const {
+    std::lock_guard<std::mutex> lock(pimpl->mutex);
+    return pimpl->used;
+}
+
+} // namespace fase
@@ -0,0 +1,66 @@
+#ifndef MEMO_CACHE_H_20261018
+#define MEMO_CACHE_H_20261018
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "variable.h"
+
+namespace fase {
+
+// Results of pure functions keyed by their inputs, shared by Cores.
+// (see Core::setMemoCache())
+// Inputs are kept as the bytes of `encoder`, and compared on lookups, so
+// equal hashes never give results of other inputs. They are hashed with
+// TypeStringConverters::hasher, or with the bytes if not given. Results are
+// kept until their total size (the size of the encoded inputs and outputs)
+// exceeds the budget, and dropped from the least recently used ones.
+// Thread safe.
+class MemoCache {
+public:
+    struct Key {
+        std::size_t hash;
+        // Encoded inputs, each prefixed by its size.
+        std::string inputs;
+        // Size of the encoded inputs without the prefixes.
+        std::size_t bytes;
+    };
+
+    MemoCache(std::size_t budget_bytes, const TSCMap& converters);
+    MemoCache(const MemoCache&) = delete;
+    MemoCache& operator=(const MemoCache&) = delete;
+    ~MemoCache();
+
+    // Functions are not cached unless enabled.
+    void enable(const std::string& f_name, bool enable = true);
+    bool isEnabled(const std::string& f_name) const;
+
+    // Key of the inputs (`is_input_args`) of `args`, or nullopt if some of
+    // them can not be encoded.
+    std::optional<Key>
+    makeKey(const std::string& f_name, const std::deque<Variable>& args,
+            const std::vector<bool>& is_input_args) const;
+    // Copy the cached outputs of `key` into `args`, if any.
+    bool load(const Key& key, const std::string& f_name,
+              std::deque<Variable>& args);
+    // Keep the outputs of `args`, unless some of them can not be sized.
+    void store(const Key& key, const std::string& f_name,
+               const std::deque<Variable>& args,
+               const std::vector<bool>& is_input_args);
+
+    void        clear();
+    std::size_t getBudget() const noexcept;
+    std::size_t getUsedBytes() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pimpl;
+};
+
+} // namespace fase
+
+#endif // MEMO_CACHE_H_20261018
@@ -0,0 +1,242 @@
+#include "native_pipe.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "constants.h"
+#include "manager.h"
+#include "utils.h"
+
+namespace fase {
+
+using std::string, std::vector;
+using size_t = std::size_t;
+
+namespace {
+
+constexpr char kClassName[] = "FaseNativePipe";
+
+void* LoadSymbol(void* handle, const char* name) {
+#ifndef _WIN32
+    return dlsym(handle, name);
+#else
+    (void)handle, (void)name;
+    return nullptr;
+#endif
+}
+
+// Name of cached modules, which must not change between builds of fase.
+string HashStr(const string& str) {
+    Fnv1aHasher hasher;
+    hasher.add(str.data(), str.size());
+    char dst[17];
+    std::snprintf(dst, sizeof(dst), "%016llx",
+                  static_cast<unsigned long long>(hasher.value()));
+    return dst;
+}
+
+} // namespace
+
+// ============================== NativeModule =================================
+
+NativeModule::~NativeModule() {
+#ifndef _WIN32
+    if (handle != nullptr) {
+        dlclose(handle);
+    }
+#endif
+}
+
+std::shared_ptr<const NativeModule> NativeModule::Load(const string& path) {
+#ifndef _WIN32
+    if (!std::ifstream(path)) {
+        return nullptr;
+    }
+    std::shared_ptr<NativeModule> module(new NativeModule());
+    module->handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (module->handle == nullptr) {
+        std::cerr << "NativeModule::Load() : " << dlerror() << std::endl;
+        return nullptr;
+    }
+    module->creator = reinterpret_cast<void* (*)()>(
+            LoadSymbol(module->handle, "FaseNativeCreate"));
+    module->cloner = reinterpret_cast<void* (*)(const void*)>(
+            LoadSymbol(module->handle, "FaseNativeClone"));
+    module->deleter = reinterpret_cast<void (*)(void*)>(
+            LoadSymbol(module->handle, "FaseNativeDelete"));
+    module->caller = reinterpret_cast<void (*)(void*, std::deque<Variable>*)>(
+            LoadSymbol(module->handle, "FaseNativeCall"));
+    if (!module->creator || !module->cloner || !module->deleter ||
+        !module->caller) {
+        std::cerr << "NativeModule::Load() : " << path
+                  << " is not a module of fase." << std::endl;
+        return nullptr;
+    }
+    return module;
+#else
+    (void)path;
+    return nullptr;
+#endif
+}
+
+std::shared_ptr<void> NativeModule::wrap(void* instance) const {
+    // The instance keeps this module loaded.
+    return std::shared_ptr<void>(
+            instance, [module = shared_from_this()](void* p) {
+                module->deleter(p);
+            });
+}
+
+std::shared_ptr<void> NativeModule::create() const {
+    return wrap(creator());
+}
+
+std::shared_ptr<void> NativeModule::clone(const void* instance) const {
+    return wrap(cloner(instance));
+}
+
+void NativeModule::call(void* instance, std::deque<Variable>& vs) const {
+    caller(instance, &vs);
+}
+
+// ============================= Code Generation ===============================
+
+string GenNativeModuleCode(const string& p_name, const CoreManager& cm,
+                           const TSCMap& utils, const string& prelude,
+                           const NativeCodeOptions& options) {
+    string class_code =
+            GenNativeCode(p_name, cm, utils, kClassName, "    ", options);
+    if (class_code.find(string("class ") + kClassName) != 0) {
+        return ""; // GenNativeCode() returns an error message.
+    }
+
+    auto f_utils = cm.getFunctionUtils(p_name);
+    vector<string> type_names;
+    for (auto& f_name : {kInputFuncName, kOutputFuncName}) {
+        for (auto& type : f_utils[f_name].arg_types) {
+            if (!utils.count(type)) {
+                return "";
+            }
+            type_names.emplace_back(utils.at(type).name);
+        }
+    }
+    const size_t i_size = f_utils[kInputFuncName].arg_types.size();
+
+    std::stringstream ss;
+    ss << "#include <array>" << std::endl
+       << "#include <atomic>" << std::endl
+       << "#include <chrono>" << std::endl
+       << "#include <deque>" << std::endl
+       << "#include <functional>" << std::endl
+       << "#include <future>" << std::endl
+       << "#include <optional>" << std::endl
+       << "#include <string>" << std::endl
+       << "#include <utility>" << std::endl
+       << std::endl
+       << "#include <fase2/variable.h>" << std::endl
+       << std::endl
+       << prelude << std::endl
+       << std::endl
+       << class_code << std::endl
+       << std::endl;
+
+    ss << "extern \"C\" {" << std::endl
+       << "void* FaseNativeCreate() {" << std::endl
+       << "    return new " << kClassName << "();" << std::endl
+       << "}" << std::endl
+       << "void* FaseNativeClone(const void* p) {" << std::endl
+       << "    return new " << kClassName << "(*static_cast<const "
+       << kClassName << "*>(p));" << std::endl
+       << "}" << std::endl
+       << "void FaseNativeDelete(void* p) {" << std::endl
+       << "    delete static_cast<" << kClassName << "*>(p);" << std::endl
+       << "}" << std::endl
+       << "void FaseNativeCall(void* p, std::deque<fase::Variable>* vs) {"
+       << std::endl;
+    // Outputs may be given as empty values. (e.g. by ToHard)
+    for (size_t i = i_size; i < type_names.size(); i++) {
+        ss << "    if (!(*vs)[" << i << "]) (*vs)[" << i << "].create<"
+           << type_names[i] << ">();" << std::endl;
+    }
+    ss << "    (*static_cast<" << kClassName << "*>(p))(";
+    for (size_t i = 0; i < type_names.size(); i++) {
+        if (i != 0) {
+            ss << ",";
+        }
+        ss << std::endl
+           << "        *(*vs)[" << i << "]."
+           << (i < i_size ? "getReader<" : "getWriter<") << type_names[i]
+           << ">()";
+    }
+    ss << ");" << std::endl << "}" << std::endl << "}" << std::endl;
+    return ss.str();
+}
+
+// ============================== Compilation ==================================
+
+std::shared_ptr<const NativeModule>
+CompileNativeModule(const string& code, const NativeCompileOptions& options) {
+#ifndef _WIN32
+    if (code.empty()) {
+        return nullptr;
+    }
+    string command = options.compiler + " " + options.flags;
+    for (auto& dir : options.include_dirs) {
+        command += " -I\"" + dir + "\"";
+    }
+#ifdef FASE_INCLUDE_DIR
+    command += " -I\"" FASE_INCLUDE_DIR "\"";
+#endif
+#ifdef NDEBUG
+    command += " -DNDEBUG"; // Variable is built as in this library.
+#endif
+    const string base = options.cache_dir + "/" + HashStr(command + code);
+    if (auto module = NativeModule::Load(base + ".so")) {
+        return module;
+    }
+
+    mkdir(options.cache_dir.c_str(), 0755);
+    {
+        std::ofstream ofs(base + ".cpp");
+        ofs << code;
+        if (!ofs) {
+            std::cerr << "CompileNativeModule() : failed to write " << base
+                      << ".cpp" << std::endl;
+            return nullptr;
+        }
+    }
+    // Compile to a temporary file, not to load a half-written one.
+    const string tmp = base + ".so." + std::to_string(getpid()) + "." +
+                       HashStr(std::to_string(std::hash<std::thread::id>()(
+                               std::this_thread::get_id())));
+    command += " -o \"" + tmp + "\" \"" + base + ".cpp\"";
+    if (std::system(command.c_str()) != 0) {
+        std::cerr << "CompileNativeModule() : failed to compile " << base
+                  << ".cpp" << std::endl;
+        std::remove(tmp.c_str());
+        return nullptr;
+    }
+    if (std::rename(tmp.c_str(), (base + ".so").c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return nullptr;
+    }
+    return NativeModule::Load(base + ".so");
+#else
+    (void)code, (void)options;
+    return nullptr;
+#endif
+}
+
+} // namespace fase
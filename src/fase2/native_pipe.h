@@ -0,0 +1,71 @@
+#ifndef NATIVE_PIPE_H_20261018
+#define NATIVE_PIPE_H_20261018
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "variable.h"
+
+namespace fase {
+
+struct NativeCompileOptions {
+    std::string compiler = "c++";
+    std::string flags = "-std=c++17 -O2 -shared -fPIC";
+    // Directories of headers included by the prelude of the code.
+    std::vector<std::string> include_dirs;
+    // Sources and shared objects are kept here, keyed by the hash of the code
+    // and the compiler flags.
+    std::string cache_dir = "fase_native_cache";
+    // Options of the generated code, used by ExportableParts.
+    NativeCodeOptions code;
+};
+
+// Shared object compiled from the code of GenNativeModuleCode().
+class NativeModule : public std::enable_shared_from_this<NativeModule> {
+public:
+    NativeModule(const NativeModule&) = delete;
+    NativeModule& operator=(const NativeModule&) = delete;
+    ~NativeModule();
+
+    static std::shared_ptr<const NativeModule> Load(const std::string& path);
+
+    // Instance of the pipeline, which holds states of its nodes.
+    std::shared_ptr<void> create() const;
+    std::shared_ptr<void> clone(const void* instance) const;
+
+    // Call the pipeline with `vs` (inputs followed by outputs).
+    void call(void* instance, std::deque<Variable>& vs) const;
+
+private:
+    NativeModule() = default;
+
+    void* handle = nullptr;
+    void* (*creator)() = nullptr;
+    void* (*cloner)(const void*) = nullptr;
+    void (*deleter)(void*) = nullptr;
+    void (*caller)(void*, std::deque<Variable>*) = nullptr;
+
+    std::shared_ptr<void> wrap(void* instance) const;
+};
+
+// Generate a translation unit of the pipeline, with functions used to load it
+// as a NativeModule. `prelude` is put before the generated class, and should
+// declare the functions used in the pipeline. Their symbols are resolved when
+// the module is loaded, so the executable has to export them (e.g. link with
+// -rdynamic). Returns an empty string if failed.
+std::string GenNativeModuleCode(const std::string& pipeline_name,
+                                const CoreManager& cm, const TSCMap& utils,
+                                const std::string&       prelude = "",
+                                const NativeCodeOptions& options = {});
+
+// Compile `code`, or load the cached one. Returns nullptr if failed.
+std::shared_ptr<const NativeModule>
+CompileNativeModule(const std::string&          code,
+                    const NativeCompileOptions& options);
+
+} // namespace fase
+
+#endif // NATIVE_PIPE_H_20261018
@@ -2,7 +2,14 @@
 #ifndef STDPARTS_H_20190318
 #define STDPARTS_H_20190318
 
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <tuple>
+#include <vector>
 
 #include "constants.h"
 #include "parts_base.h"
@@ -16,6 +23,11 @@ namespace fase {
 class ExportableParts : public PartsBase {
 public:
     inline ExportedPipe exportPipe() const;
+    // Export, and compile the pipeline into native code in background.
+    // `prelude` should declare the functions used in the pipeline.
+    inline ExportedPipe
+    exportNativePipe(const std::string&          prelude = "",
+                     const NativeCompileOptions& options = {});
 };
 
 template <typename... RetTypes>
@@ -27,23 +39,67 @@ public:
     public:
         template <class Exported>
         static inline auto Gen(Exported&& exported);
+
+        // Write `args` into the typed slots `vs`, which are created at the
+        // first call and reused while their types are unchanged.
+        static inline std::deque<Variable>& Bind(std::deque<Variable>* vs,
+                                                 Args... args);
+        // Move the results out of the slots.
+        static inline std::tuple<RetTypes...> Take(std::deque<Variable>& vs);
+
+    private:
+        static bool IsBound(const std::deque<Variable>& vs);
     };
 
 private:
     template <std::size_t... Seq>
-    static std::tuple<RetTypes...> Wrap(std::vector<Variable*>& ret_ps,
+    static std::tuple<RetTypes...> Wrap(std::deque<Variable>& vs,
+                                        std::size_t           offset,
                                         std::index_sequence<Seq...>) {
         return std::make_tuple(
-                std::move(*ret_ps[Seq]->getWriter<RetTypes>())...);
+                std::move(*vs[offset + Seq].getWriter<RetTypes>())...);
     }
 };
 
+// Calls pipelines through pipes exported from them, so that calls do not
+// take the writer lock of the CoreManager. The reader lock is needed only to
+// check whether the pipelines are edited since the export.
+// Each running call takes its own pipe, and calls from threads run in
+// parallel. Stateful nodes keep their states in each pipe, and start over
+// when the pipelines are edited.
+class PipeCaller {
+public:
+    struct Callee {
+        std::string          p_name;
+        std::uint64_t        version;
+        ExportedPipe         pipe;
+        // Typed slots of ToHard::Pipe::Bind().
+        std::deque<Variable> slots = {};
+    };
+
+    // Take with the reader lock of `cm`, and call without it.
+    // The focused pipeline is taken if `p_name` is empty.
+    // The pipe is empty if the pipeline can not be exported.
+    inline std::unique_ptr<Callee> take(const CoreManager& cm,
+                                        const std::string& p_name = "");
+    // Reuse the callee by later take(). Callees of failed calls are dropped
+    // instead.
+    inline void giveBack(std::unique_ptr<Callee>&& callee);
+
+private:
+    std::mutex                           mutex;
+    std::vector<std::unique_ptr<Callee>> idles;
+};
+
 class CallableParts : public PartsBase {
 public:
     inline bool call(std::deque<Variable>& args);
 
     inline bool call(const std::string&    pipeline_name,
                      std::deque<Variable>& args);
+
+private:
+    PipeCaller caller;
 };
 
 template <typename... ReturnTypes>
@@ -51,6 +107,27 @@ class HardCallableParts : public PartsBase {
 public:
     template <typename... Args>
     inline std::tuple<ReturnTypes...> callHard(Args&&... args);
+
+private:
+    PipeCaller hard_caller;
+};
+
+// Load saved pipelines and generate native code of them without the editor.
+// Used by the fase_codegen command.
+class CodegenParts : public PartsBase {
+public:
+    inline bool loadPipeline(const std::string& filename);
+    // Pipelines on which no other pipeline depends.
+    inline std::vector<std::string> getTopPipelineNames() const;
+    // Returns an empty string if failed.
+    inline std::string genNativeCode(const std::string&       pipeline_name,
+                                     const std::string&       class_name,
+                                     const NativeCodeOptions& options = {});
+    // Benchmark program of the class, which is included by `prelude`.
+    inline std::string genBenchmarkCode(const std::string& pipeline_name,
+                                        const std::string& class_name,
+                                        const std::string& prelude,
+                                        bool               per_node = false);
 };
 
 class FixedPipelineParts : public PartsBase {
@@ -68,6 +145,9 @@ public:
 
             std::string                   pipe_name;
             std::weak_ptr<PartsBase::API> api;
+            // Shared by copies of this.
+            std::shared_ptr<PipeCaller> caller =
+                    std::make_shared<PipeCaller>();
         };
     };
     template <typename... ReturnTypes>
@@ -102,15 +182,64 @@ inline ExportedPipe ExportableParts ::exportPipe() const {
     return pcm->exportPipe(pcm->getFocusedPipeline());
 }
 
+inline ExportedPipe
+ExportableParts::exportNativePipe(const std::string&          prelude,
+                                  const NativeCompileOptions& options) {
+    const TSCMap& tsc_map = getAPI()->getConverterMap();
+    auto [guard, pcm] = getAPI()->getReader();
+    auto p_name = pcm->getFocusedPipeline();
+    ExportedPipe exported = pcm->exportPipe(p_name);
+    exported.compileInBackground(
+            GenNativeModuleCode(p_name, *pcm, tsc_map, prelude, options.code),
+            options);
+    return exported;
+}
+
+inline std::unique_ptr<PipeCaller::Callee>
+PipeCaller::take(const CoreManager& cm, const std::string& p_name) {
+    std::string   name = p_name.empty() ? cm.getFocusedPipeline() : p_name;
+    std::uint64_t version = cm.getVersion();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = idles.begin(); it != idles.end(); it++) {
+            if ((*it)->p_name == name && (*it)->version == version) {
+                auto callee = std::move(*it);
+                idles.erase(it);
+                return callee;
+            }
+        }
+        // Exported before the edits.
+        idles.erase(std::remove_if(idles.begin(), idles.end(),
+                                   [&](auto& callee) {
+                                       return callee->version != version;
+                                   }),
+                    idles.end());
+    }
+    return std::make_unique<Callee>(
+            Callee{name, version, cm.exportPipe(name)});
+}
+
+inline void PipeCaller::giveBack(std::unique_ptr<Callee>&& callee) {
+    std::lock_guard<std::mutex> lock(mutex);
+    idles.emplace_back(std::move(callee));
+}
+
 inline bool CallableParts::call(std::deque<Variable>& args) {
-    auto [guard, pcm] = getAPI()->getWriter();
-    return (*pcm)[pcm->getFocusedPipeline()].call(args);
+    return call("", args);
 }
 
 inline bool CallableParts::call(const std::string&    pipeline_name,
                                 std::deque<Variable>& args) {
-    auto [guard, pcm] = getAPI()->getWriter();
-    return (*pcm)[pipeline_name].call(args);
+    std::unique_ptr<PipeCaller::Callee> callee;
+    {
+        auto [guard, pcm] = getAPI()->getReader();
+        callee = caller.take(*pcm, pipeline_name);
+    }
+    if (!callee->pipe(args)) {
+        return false;
+    }
+    caller.giveBack(std::move(callee));
+    return true;
 }
 
 template <typename... RetTypes>
@@ -120,26 +249,19 @@ inline auto ToHard<RetTypes...>::Pipe<Args...>::Gen(Exported&& exported) {
     class Dst {
     public:
         std::tuple<RetTypes...> operator()(Args... args) {
-            std::deque<Variable> arg_vs = {std::make_unique<std::decay_t<Args>>(
-                    std::forward<Args>(args))...};
-            [[maybe_unused]] auto _ = {
-                    arg_vs.emplace_back(typeid(RetTypes))...};
-            if (!soft(arg_vs)) {
+            auto& vs = Bind(&slots, std::forward<Args>(args)...);
+            if (!soft(vs)) {
                 throw std::runtime_error(
                         "HardExportPipe : input/output type isn't "
                         "match!");
             }
-            std::vector<Variable*> ret_ps;
-            for (std::size_t i = arg_vs.size() - sizeof...(RetTypes);
-                 i < arg_vs.size(); i++) {
-                ret_ps.emplace_back(&arg_vs[i]);
-            }
-            return Wrap(ret_ps, std::index_sequence_for<RetTypes...>());
+            return Take(vs);
         }
         void reset() {
             soft.reset();
         }
         std::decay_t<Exported> soft;
+        std::deque<Variable>   slots = {};
     };
     if (!exported) {
         throw std::runtime_error("HardExportPipe : Empty pipeline was wraped");
@@ -147,23 +269,118 @@ inline auto ToHard<RetTypes...>::Pipe<Args...>::Gen(Exported&& exported) {
     return Dst{std::forward<Exported>(exported)};
 }
 
+template <typename... RetTypes>
+template <typename... Args>
+bool ToHard<RetTypes...>::Pipe<Args...>::IsBound(
+        const std::deque<Variable>& vs) {
+    if (vs.size() != sizeof...(Args) + sizeof...(RetTypes)) {
+        return false;
+    }
+    std::size_t i = 0;
+    return (vs[i++].isSameType<std::decay_t<Args>>() && ... && true) &&
+           (vs[i++].isSameType<RetTypes>() && ... && true);
+}
+
+template <typename... RetTypes>
+template <typename... Args>
+inline std::deque<Variable>&
+ToHard<RetTypes...>::Pipe<Args...>::Bind(std::deque<Variable>* vs,
+                                         Args... args) {
+    if (IsBound(*vs)) {
+        std::size_t i = 0;
+        ((*(*vs)[i++].getWriter<std::decay_t<Args>>() =
+                  std::forward<Args>(args)),
+         ...);
+    } else {
+        *vs = {std::make_unique<std::decay_t<Args>>(
+                std::forward<Args>(args))...};
+        (vs->emplace_back(typeid(RetTypes)), ...);
+    }
+    return *vs;
+}
+
+template <typename... RetTypes>
+template <typename... Args>
+inline std::tuple<RetTypes...>
+ToHard<RetTypes...>::Pipe<Args...>::Take(std::deque<Variable>& vs) {
+    return Wrap(vs, sizeof...(Args), std::index_sequence_for<RetTypes...>());
+}
+
 template <typename... ReturnTypes>
 template <typename... Args>
 inline std::tuple<ReturnTypes...>
 HardCallableParts<ReturnTypes...>::callHard(Args&&... args) {
-    struct Dum {
-        HardCallableParts<ReturnTypes...>* that;
-        void                               reset() {}
-                                           operator bool() {
-            return true;
+    using Pipe = typename ToHard<ReturnTypes...>::template Pipe<Args...>;
+    // The pipeline may be edited by other threads (e.g. GUI) while running.
+    std::unique_ptr<PipeCaller::Callee> callee;
+    {
+        auto [guard, pcm] = getAPI()->getReader();
+        callee = hard_caller.take(*pcm);
+    }
+    auto& vs = Pipe::Bind(&callee->slots, std::forward<Args>(args)...);
+    if (!callee->pipe(vs)) {
+        throw std::runtime_error(
+                "HardExportPipe : input/output type isn't match!");
+    }
+    auto dst = Pipe::Take(vs);
+    hard_caller.giveBack(std::move(callee));
+    return dst;
+}
+
+inline bool CodegenParts::loadPipeline(const std::string& filename) {
+    const TSCMap& tsc_map = getAPI()->getConverterMap();
+    auto [guard, pcm] = getAPI()->getWriter();
+    return LoadPipelineFromFile(filename, pcm.get(), tsc_map);
+}
+
+inline std::vector<std::string> CodegenParts::getTopPipelineNames() const {
+    auto [guard, pcm] = getAPI()->getReader();
+    std::set<std::string> depended;
+    for (auto& p_name : pcm->getPipelineNames()) {
+        for (auto& layer : pcm->getDependingTree().getDependenceLayer(p_name)) {
+            depended.insert(layer.begin(), layer.end());
         }
-        bool operator()(std::deque<Variable>& vs) {
-            auto [guard, pcm] = that->getAPI()->getWriter();
-            return (*pcm)[pcm->getFocusedPipeline()].call(vs);
+    }
+    std::vector<std::string> dst;
+    for (auto& p_name : pcm->getPipelineNames()) {
+        if (!depended.count(p_name)) {
+            dst.emplace_back(p_name);
         }
-    };
-    return ToHard<ReturnTypes...>::template Pipe<Args...>::Gen(Dum{this})(
-            std::forward<Args>(args)...);
+    }
+    return dst;
+}
+
+inline std::string
+CodegenParts::genNativeCode(const std::string&       pipeline_name,
+                            const std::string&       class_name,
+                            const NativeCodeOptions& options) {
+    const TSCMap& tsc_map = getAPI()->getConverterMap();
+    auto [guard, pcm] = getAPI()->getReader();
+    if (!exists(pipeline_name, pcm->getPipelineNames())) {
+        return "";
+    }
+    std::string code =
+            GenNativeCode(pipeline_name, *pcm, tsc_map, class_name, "    ",
+                          options);
+    if (code.find("class " + class_name) != 0) {
+        std::cerr << code << std::endl; // Error message.
+        return "";
+    }
+    return code;
+}
+
+inline std::string
+CodegenParts::genBenchmarkCode(const std::string& pipeline_name,
+                               const std::string& class_name,
+                               const std::string& prelude,
+                               bool               per_node) {
+    const TSCMap& tsc_map = getAPI()->getConverterMap();
+    auto [guard, pcm] = getAPI()->getReader();
+    if (!exists(pipeline_name, pcm->getPipelineNames())) {
+        return "";
+    }
+    return GenNativeBenchmarkCode(pipeline_name, *pcm, tsc_map, class_name,
+                                  prelude, per_node);
 }
 
 template <typename... ReturnTypes>
@@ -226,19 +443,21 @@ FixedPipelineParts::Exported<ReturnTypes...>::API<Args...>::operator()(
     if (api.expired()) {
         throw std::runtime_error("mother pipeline is deleted");
     }
-    struct Dum {
-        std::weak_ptr<PartsBase::API> api;
-        void                          reset() {}
-                                      operator bool() {
-            return !api.expired();
-        }
-        bool operator()(std::deque<Variable>& vs) {
-            auto [guard, pcm] = api.lock()->getWriter();
-            return (*pcm)[pcm->getFocusedPipeline()].call(vs);
-        }
-    };
-    return ToHard<ReturnTypes...>::template Pipe<Args...>::Gen(Dum{api})(
-            std::forward<Args>(args)...);
+    using Pipe = typename ToHard<ReturnTypes...>::template Pipe<Args...>;
+    // The pipeline may be edited by other threads (e.g. GUI) while running.
+    std::unique_ptr<PipeCaller::Callee> callee;
+    {
+        auto [guard, pcm] = api.lock()->getReader();
+        callee = caller->take(*pcm);
+    }
+    auto& vs = Pipe::Bind(&callee->slots, std::forward<Args>(args)...);
+    if (!callee->pipe(vs)) {
+        throw std::runtime_error(
+                "HardExportPipe : input/output type isn't match!");
+    }
+    auto dst = Pipe::Take(vs);
+    caller->giveBack(std::move(callee));
+    return dst;
 }
 
 } // namespace fase
@@ -1,5 +1,10 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
 #include <map>
-#include <sstream>
+#include <stdexcept>
+#include <vector>
 
 #include "fase.h"
 
@@ -7,78 +12,249 @@ namespace fase {
 
 namespace {
 
+// Shortest representation which is read back to the same value.
 template <typename T>
-std::function<void(Variable&, const std::string&)>
-genConverter(const std::function<T(const std::string&)>& conv_f) {
-    return [conv_f](Variable& v, const std::string& str) {
-        v.create<T>(conv_f(str));
+void AppendChars(const T& v, std::string* dst) {
+    if constexpr (std::is_same_v<T, bool>) {
+        *dst += v ? '1' : '0';
+    } else {
+        char buf[64];
+        auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), v);
+        dst->append(buf, end);
+    }
+}
+
+template <typename T>
+T FromChars(std::string_view s) {
+    if constexpr (std::is_same_v<T, bool>) {
+        return FromChars<int>(s) != 0;
+    } else {
+        T v{};
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+        if (ec != std::errc()) {
+            throw std::invalid_argument("failed to read \"" + std::string(s) +
+                                        "\" as a " + typeid(T).name());
+        }
+        return v;
+    }
+}
+
+// Binary values are little-endian bytes of the values.
+bool IsLittleEndian() {
+    const std::uint16_t one = 1;
+    char head;
+    std::memcpy(&head, &one, 1);
+    return head == 1;
+}
+
+template <typename T>
+void SwapBytes(char* p, size_t n) {
+    if (sizeof(T) > 1 && !IsLittleEndian()) {
+        for (size_t i = 0; i < n; i++) {
+            std::reverse(p + i * sizeof(T), p + (i + 1) * sizeof(T));
+        }
+    }
+}
+
+template <typename T>
+void AppendBytes(const T* src, size_t n, std::string* dst) {
+    const size_t offset = dst->size();
+    dst->resize(offset + n * sizeof(T));
+    std::memcpy(&(*dst)[offset], src, n * sizeof(T));
+    SwapBytes<T>(&(*dst)[offset], n);
+}
+
+template <typename T>
+void ReadBytes(std::string_view src, T* dst, size_t n) {
+    if (src.size() != n * sizeof(T)) {
+        throw std::invalid_argument(std::string("broken bytes of ") +
+                                    typeid(T).name());
+    }
+    std::memcpy(dst, src.data(), src.size());
+    SwapBytes<T>(reinterpret_cast<char*>(dst), n);
+}
+
+template <typename T>
+void SetupNumberConverters(TypeStringConverters* tsc) {
+    tsc->checker = [](const Variable& v) { return v.isSameType<T>(); };
+    tsc->serializer = [](const Variable& v) {
+        std::string dst;
+        AppendChars(*v.getReader<T>(), &dst);
+        return dst;
+    };
+    tsc->appender = [](const Variable& v, std::string* dst) {
+        AppendChars(*v.getReader<T>(), dst);
+    };
+    tsc->deserializer = [](Variable& v, const std::string& s) {
+        v.create<T>(FromChars<T>(s));
+    };
+    tsc->def_maker = tsc->serializer;
+    tsc->hasher = [](const Variable& v) {
+        return std::hash<T>()(*v.getReader<T>());
+    };
+    if constexpr (std::is_same_v<T, bool>) {
+        tsc->encoder = [](const Variable& v, std::string* dst) {
+            *dst += *v.getReader<bool>() ? '\1' : '\0';
+        };
+        tsc->decoder = [](Variable& v, std::string_view s) {
+            std::uint8_t b;
+            ReadBytes(s, &b, 1);
+            v.create<bool>(b != 0);
+        };
+    } else {
+        tsc->encoder = [](const Variable& v, std::string* dst) {
+            AppendBytes(v.getReader<T>().get(), 1, dst);
+        };
+        tsc->decoder = [](Variable& v, std::string_view s) {
+            T x;
+            ReadBytes(s, &x, 1);
+            v.create<T>(x);
+        };
+    }
+}
+
+// std::vector of numbers is written as "1 2 3" in text, but saved as bytes.
+template <typename T>
+void AppendVector(const std::vector<T>& vec, const char* sep,
+                  std::string* dst) {
+    for (size_t i = 0; i < vec.size(); i++) {
+        if (i != 0) {
+            *dst += sep;
+        }
+        AppendChars(vec[i], dst);
+    }
+}
+
+template <typename T>
+void SetupVectorConverters(TypeStringConverters* tsc) {
+    using Vec = std::vector<T>;
+    tsc->checker = [](const Variable& v) { return v.isSameType<Vec>(); };
+    tsc->serializer = [](const Variable& v) {
+        std::string dst;
+        AppendVector(*v.getReader<Vec>(), " ", &dst);
+        return dst;
+    };
+    tsc->appender = [](const Variable& v, std::string* dst) {
+        AppendVector(*v.getReader<Vec>(), " ", dst);
+    };
+    tsc->deserializer = [](Variable& v, const std::string& s) {
+        Vec vec;
+        size_t pos = 0;
+        while ((pos = s.find_first_not_of(' ', pos)) != std::string::npos) {
+            size_t end = std::min(s.find(' ', pos), s.size());
+            vec.emplace_back(FromChars<T>(std::string_view(s).substr(
+                    pos, end - pos)));
+            pos = end;
+        }
+        v.create<Vec>(std::move(vec));
+    };
+    tsc->def_maker = [](const Variable& v) {
+        std::string dst = "{";
+        AppendVector(*v.getReader<Vec>(), ", ", &dst);
+        return dst + "}";
+    };
+    tsc->encoder = [](const Variable& v, std::string* dst) {
+        const Vec& vec = *v.getReader<Vec>();
+        AppendBytes(vec.data(), vec.size(), dst);
+    };
+    tsc->decoder = [](Variable& v, std::string_view s) {
+        Vec vec(s.size() / sizeof(T));
+        ReadBytes(s, vec.data(), vec.size());
+        v.create<Vec>(std::move(vec));
     };
+    tsc->hasher = [](const Variable& v) {
+        const Vec& vec = *v.getReader<Vec>();
+        return std::hash<std::string_view>()(std::string_view(
+                reinterpret_cast<const char*>(vec.data()),
+                vec.size() * sizeof(T)));
+    };
+    tsc->bulk = true;
 }
 
 } // namespace
 
 void SetupTypeConverters(std::map<std::type_index, TypeStringConverters>* p) {
     auto& map = *p;
-#define ADD_TYPE_CHECKER(type)                                                 \
-    map[typeid(type)].checker = [](const Variable& v) {                        \
-        return v.isSameType<type>();                                           \
-    }
-#define ADD_SERIALISER(type)                                                   \
-    map[typeid(type)].serializer = [](const Variable& v) {                     \
-        std::stringstream sstream;                                             \
-        sstream << *v.getReader<type>();                                       \
-        return sstream.str();                                                  \
-    }
-#define ADD_DESERIALISER(type, conv_f)                                         \
-    map[typeid(type)].deserializer =                                           \
-            genConverter<type>([](const std::string& s) conv_f);
-#define ADD_DEF_MAKER(type)                                                    \
-    map[typeid(type)].def_maker = [](const Variable& v) {                      \
-        std::stringstream sstream;                                             \
-        sstream << *v.getReader<type>();                                       \
-        return sstream.str();                                                  \
-    }
-#define ADD_NAME(type) map[typeid(type)].name = #type
-
-#define ADD_ALL(type, conv_f)                                                  \
-    ADD_TYPE_CHECKER(type);                                                    \
-    ADD_SERIALISER(type);                                                      \
-    ADD_DESERIALISER(type, conv_f);                                            \
-    ADD_DEF_MAKER(type);                                                       \
-    ADD_NAME(type);
-
-    // clang-format off
-    ADD_ALL(bool,               { return std::stoi(s);   });
-    ADD_ALL(bool,               { return std::stoi(s);   });
-    ADD_ALL(char,               { return *s.c_str();     });
-    ADD_ALL(unsigned char,      { return std::stoi(s);   });
-    ADD_ALL(short,              { return std::stoi(s);   });
-    ADD_ALL(unsigned short,     { return std::stoi(s);   });
-    ADD_ALL(int,                { return std::stoi(s);   });
-    ADD_ALL(unsigned int,       { return std::stol(s);   });
-    ADD_ALL(long,               { return std::stol(s);   });
-    ADD_ALL(unsigned long,      { return std::stoul(s);  });
-    ADD_ALL(long long,          { return std::stoll(s);  });
-    ADD_ALL(unsigned long long, { return std::stoull(s); });
-    ADD_ALL(float,              { return std::stof(s);   });
-    ADD_ALL(double,             { return std::stod(s);   });
-    ADD_ALL(long double,        { return std::stold(s);  });
-
-    // clang-format on
-
-    ADD_TYPE_CHECKER(std::string);
-    ADD_SERIALISER(std::string);
-    ADD_DESERIALISER(std::string, { return s; }); // TODO fix
-    map[typeid(std::string)].def_maker = [](const Variable& v) {
-        return "\"" + *v.getReader<std::string>() + "\"";
+#define ADD_NUMBER(type)                                                       \
+    SetupNumberConverters<type>(&map[typeid(type)]);                           \
+    map[typeid(type)].name = #type
+
+    ADD_NUMBER(bool);
+    ADD_NUMBER(unsigned char);
+    ADD_NUMBER(short);
+    ADD_NUMBER(unsigned short);
+    ADD_NUMBER(int);
+    ADD_NUMBER(unsigned int);
+    ADD_NUMBER(long);
+    ADD_NUMBER(unsigned long);
+    ADD_NUMBER(long long);
+    ADD_NUMBER(unsigned long long);
+    ADD_NUMBER(float);
+    ADD_NUMBER(double);
+    ADD_NUMBER(long double);
+
+#undef ADD_NUMBER
+
+#define ADD_VECTOR(type)                                                       \
+    SetupVectorConverters<type>(&map[typeid(std::vector<type>)]);              \
+    map[typeid(std::vector<type>)].name = "std::vector<" #type ">"
+
+    ADD_VECTOR(unsigned char);
+    ADD_VECTOR(short);
+    ADD_VECTOR(unsigned short);
+    ADD_VECTOR(int);
+    ADD_VECTOR(unsigned int);
+    ADD_VECTOR(long);
+    ADD_VECTOR(unsigned long);
+    ADD_VECTOR(long long);
+    ADD_VECTOR(unsigned long long);
+    ADD_VECTOR(float);
+    ADD_VECTOR(double);
+
+#undef ADD_VECTOR
+
+    // char is written as a character.
+    auto& char_tsc = map[typeid(char)];
+    char_tsc.checker = [](const Variable& v) { return v.isSameType<char>(); };
+    char_tsc.serializer = [](const Variable& v) {
+        return std::string(1, *v.getReader<char>());
     };
-    ADD_NAME(std::string);
+    char_tsc.appender = [](const Variable& v, std::string* dst) {
+        *dst += *v.getReader<char>();
+    };
+    char_tsc.deserializer = [](Variable& v, const std::string& s) {
+        v.create<char>(*s.c_str());
+    };
+    char_tsc.def_maker = char_tsc.serializer;
+    char_tsc.hasher = [](const Variable& v) {
+        return std::hash<char>()(*v.getReader<char>());
+    };
+    char_tsc.name = "char";
 
-#undef ADD_TYPE_CHECKER
-#undef ADD_SERIALISER
-#undef ADD_DESERIALISER
-#undef ADD_DEF_MAKER
-#undef ADD_NAME
+    auto& str_tsc = map[typeid(std::string)];
+    str_tsc.checker = [](const Variable& v) {
+        return v.isSameType<std::string>();
+    };
+    str_tsc.serializer = [](const Variable& v) {
+        return *v.getReader<std::string>();
+    };
+    str_tsc.appender = [](const Variable& v, std::string* dst) {
+        *dst += *v.getReader<std::string>();
+    };
+    str_tsc.deserializer = [](Variable& v, const std::string& s) {
+        v.create<std::string>(s); // TODO fix
+    };
+    str_tsc.def_maker = [](const Variable& v) {
+        return "\"" + *v.getReader<std::string>() + "\"";
+    };
+    str_tsc.encoder = str_tsc.appender;
+    str_tsc.hasher = [](const Variable& v) {
+        return std::hash<std::string>()(*v.getReader<std::string>());
+    };
+    str_tsc.decoder = [](Variable& v, std::string_view s) {
+        v.create<std::string>(s);
+    };
+    str_tsc.name = "std::string";
 }
 
 } // namespace fase
@@ -7,8 +7,13 @@
 #endif
 
 #include <algorithm>
+#include <cstdint>
 #include <map>
+#include <mutex>
 #include <numeric>
+#include <set>
+#include <string>
+#include <string_view>
 #include <vector>
 
 namespace fase {
@@ -139,57 +144,210 @@ inline bool CheckRepetition(HeadContainer&& head, TailContainers&&... tail) {
     }
 }
 
+// FNV-1a 64-bit, which is stable between processes unlike std::hash.
+// (keys of checkpoints and MemoCache, and names of cached native modules)
+class Fnv1aHasher {
+public:
+    void add(const char* p, std::size_t n) {
+        for (std::size_t i = 0; i < n; i++) {
+            h = (h ^ static_cast<unsigned char>(p[i])) * 0x100000001b3;
+        }
+    }
+    void add(std::uint64_t v) {
+        char bytes[8];
+        for (int i = 0; i < 8; i++) {
+            bytes[i] = char((v >> (8 * i)) & 0xff);
+        }
+        add(bytes, sizeof(bytes));
+    }
+    void add(std::string_view str) {
+        add(std::uint64_t(str.size()));
+        add(str.data(), str.size());
+    }
+    std::uint64_t value() const noexcept {
+        return h;
+    }
+
+private:
+    std::uint64_t h = 0xcbf29ce484222325;
+};
+
+// Dependencies between pipelines. (a DAG of adjacency lists)
+// The reachable sets are updated on each addition, so loop checks do not walk
+// the graph. Layers are computed on demand and cached until the next change.
 class DependenceTree {
 public:
     bool add(const std::string& depending, const std::string& depended) {
-        if (depending == depended || checkLoop(depended, depending)) {
+        if (depending == depended || reaches(depended, depending)) {
             return false;
         }
-        trees[depending][depended]++;
+        if (edges[depending][depended]++ == 0) {
+            dependeds[depended].insert(depending);
+            // `depending` and all pipelines reaching it now reach
+            // `depended` and all pipelines reached from it.
+            std::vector<std::string> srcs = {depending};
+            if (dependeds_all.count(depending)) {
+                const auto& ups = dependeds_all.at(depending);
+                srcs.insert(srcs.end(), ups.begin(), ups.end());
+            }
+            std::vector<std::string> dsts = {depended};
+            if (reachables.count(depended)) {
+                const auto& downs = reachables.at(depended);
+                dsts.insert(dsts.end(), downs.begin(), downs.end());
+            }
+            for (auto& src : srcs) {
+                reachables[src].insert(dsts.begin(), dsts.end());
+            }
+            for (auto& dst : dsts) {
+                dependeds_all[dst].insert(srcs.begin(), srcs.end());
+            }
+            layer_cache.clear();
+        }
         return true;
     }
     void del(const std::string& depending, const std::string& depended) {
-        trees[depending][depended]--;
-        if (trees[depending][depended] <= 0) {
-            trees[depending].erase(depended);
+        auto it = edges.find(depending);
+        if (it == edges.end()) return;
+        auto e_it = it->second.find(depended);
+        if (e_it == it->second.end()) return;
+        if (--e_it->second > 0) return;
+
+        it->second.erase(e_it);
+        if (it->second.empty()) {
+            edges.erase(it);
+        }
+        dependeds[depended].erase(depending);
+        if (dependeds[depended].empty()) {
+            dependeds.erase(depended);
         }
+        // Reachability does not shrink incrementally. Rebuild it.
+        rebuildReachables();
+        layer_cache.clear();
     }
 
+    // Pipelines which `depending` depends on, by the longest distance from
+    // it. (The 0th is the direct ones.) Each pipeline appears only once, and
+    // depends only on the ones in the later layers.
     std::vector<std::vector<std::string>>
     getDependenceLayer(const std::string& depending) const {
         if (isIndependent(depending)) return {};
 
-        std::vector<std::vector<std::string>> dst;
-        dst.emplace_back(getKeys(trees.at(depending)));
+        std::lock_guard<std::mutex> lock(layer_cache.mutex);
+        auto c_it = layer_cache.layers.find(depending);
+        if (c_it != layer_cache.layers.end()) {
+            return c_it->second;
+        }
 
-        for (auto& str : dst[0]) {
-            auto deps = getDependenceLayer(str);
-            dst.resize(std::max(deps.size() + 1, dst.size()));
-            for (std::size_t i = 0; i < deps.size(); i++) {
-                Extend(std::move(deps[i]), &dst[i + 1]);
+        // Longest distances, in a topological order from `depending`.
+        std::map<std::string, std::size_t> depths;
+        for (auto& name : reachables.at(depending)) {
+            depths[name] = 0;
+        }
+        for (auto& name : topologicalOrder(depending)) {
+            std::size_t d = name == depending ? 0 : depths.at(name) + 1;
+            if (!edges.count(name)) continue;
+            for (auto& [dep, c] : edges.at(name)) {
+                depths[dep] = std::max(depths[dep], d);
             }
         }
-        return dst;
+
+        std::vector<std::vector<std::string>> dst;
+        for (auto& [name, d] : depths) {
+            dst.resize(std::max(dst.size(), d + 1));
+            dst[d].emplace_back(name);
+        }
+        return layer_cache.layers[depending] = dst;
     }
 
     bool isIndependent(const std::string& a) const {
-        return !trees.count(a);
+        return !edges.count(a);
     }
 
     std::vector<std::string> getDependings(const std::string& a) const {
-        return getKeys(trees.at(a));
+        if (isIndependent(a)) return {};
+        return getKeys(edges.at(a));
+    }
+
+    // Pipelines which depend on `a` directly.
+    std::vector<std::string> getDependeds(const std::string& a) const {
+        if (!dependeds.count(a)) return {};
+        const auto& ds = dependeds.at(a);
+        return {ds.begin(), ds.end()};
+    }
+    // Pipelines which depend on `a` directly or indirectly.
+    std::vector<std::string> getAllDependeds(const std::string& a) const {
+        if (!dependeds_all.count(a)) return {};
+        const auto& ds = dependeds_all.at(a);
+        return {ds.begin(), ds.end()};
     }
 
 private:
-    std::map<std::string, std::map<std::string, int>> trees;
+    struct LayerCache {
+        LayerCache() = default;
+        LayerCache(const LayerCache&) {}
+        LayerCache& operator=(const LayerCache&) {
+            clear();
+            return *this;
+        }
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            layers.clear();
+        }
+
+        std::mutex mutex;
+        std::map<std::string, std::vector<std::vector<std::string>>> layers;
+    };
+
+    // Counts of the dependencies.
+    std::map<std::string, std::map<std::string, int>> edges;
+    // Reverse edges.
+    std::map<std::string, std::set<std::string>> dependeds;
+    // Transitive closures of the both.
+    std::map<std::string, std::set<std::string>> reachables;
+    std::map<std::string, std::set<std::string>> dependeds_all;
 
-    bool checkLoop(const std::string& a, const std::string& b) {
-        for (auto& [n, c] : trees[a]) {
-            if (b == n || checkLoop(n, b)) {
-                return true;
+    mutable LayerCache layer_cache;
+
+    bool reaches(const std::string& a, const std::string& b) const {
+        return reachables.count(a) && reachables.at(a).count(b);
+    }
+
+    // `root` and pipelines reachable from it, dependings first.
+    std::vector<std::string> topologicalOrder(const std::string& root) const {
+        std::vector<std::string> dst;
+        std::set<std::string> visited;
+        // (name, whether its dependencies are pushed)
+        std::vector<std::pair<std::string, bool>> stack = {{root, false}};
+        while (!stack.empty()) {
+            auto [name, expanded] = stack.back();
+            stack.pop_back();
+            if (expanded) {
+                dst.emplace_back(name);
+                continue;
+            }
+            if (!visited.insert(name).second) continue;
+            stack.emplace_back(name, true);
+            if (!edges.count(name)) continue;
+            for (auto& [dep, c] : edges.at(name)) {
+                if (!visited.count(dep)) {
+                    stack.emplace_back(dep, false);
+                }
+            }
+        }
+        std::reverse(dst.begin(), dst.end());
+        return dst;
+    }
+
+    void rebuildReachables() {
+        reachables.clear();
+        dependeds_all.clear();
+        for (auto& [name, deps] : edges) {
+            for (auto& dep : topologicalOrder(name)) {
+                if (dep == name) continue;
+                reachables[name].insert(dep);
+                dependeds_all[dep].insert(name);
             }
         }
-        return false;
     }
 };
 
@@ -2,6 +2,7 @@
 #ifndef VARIABLE_H_20190206
 #define VARIABLE_H_20190206
 
+#include <cassert>
 #include <deque>
 #include <functional>
 #include <memory>
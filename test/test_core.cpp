@@ -4,6 +4,9 @@
 
 #include "fase2/constants.h"
 
+#include <filesystem>
+#include <random>
+
 using namespace fase;
 
 static void Add(const int& a, const int& b, int& dst) {
@@ -14,6 +17,37 @@ static void Square(const int& in, int& dst) {
     dst = in * in;
 }
 
+static int n_counted_square_calls = 0;
+
+static void CountedSquare(const int& in, int& dst) {
+    n_counted_square_calls++;
+    dst = in * in;
+}
+
+namespace {
+
+// Directory removed at the end of the scope. The name is made unique, so that
+// parallel runs do not share it.
+class TempDir {
+public:
+    explicit TempDir(const std::string& name)
+        : path((std::filesystem::temp_directory_path() /
+                (name + "-" + std::to_string(std::random_device()())))
+                       .string()) {
+        std::filesystem::create_directories(path);
+    }
+    ~TempDir() {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    const std::string path;
+};
+
+} // namespace
+
 TEST_CASE("Core test") {
     Core core;
     {
@@ -122,3 +156,772 @@ TEST_CASE("Core test") {
     REQUIRE(copied.run());
     REQUIRE(*copied_outputs[0].getReader<int>() == 25);
 }
+
+TEST_CASE("Core fusion test") {
+    Core core;
+    {
+        auto univ_add =
+                UnivFuncGenerator<void(const int&, const int&, int&)>::Gen(
+                        [&]() -> std::function<void(const int&, const int&,
+                                                    int&)> { return Add; });
+        std::deque<Variable> default_args = {std::make_unique<int>(1),
+                                             std::make_unique<int>(2),
+                                             std::make_unique<int>(0)};
+        REQUIRE(core.addUnivFunc(univ_add, "add", std::move(default_args),
+                                 {{"a", "b", "dst"},
+                                  {typeid(int), typeid(int), typeid(int)},
+                                  {true, true, false},
+                                  FOGtype::Pure,
+                                  "",
+                                  {},
+                                  "",
+                                  ""}));
+    }
+    {
+        auto univ_sq = UnivFuncGenerator<void(const int&, int&)>::Gen(
+                [&]() -> std::function<void(const int&, int&)> {
+                    return Square;
+                });
+        std::deque<Variable> default_args = {std::make_unique<int>(4),
+                                             std::make_unique<int>(0)};
+        REQUIRE(core.addUnivFunc(univ_sq, "square", std::move(default_args),
+                                 {{"in", "dst"},
+                                  {typeid(int), typeid(int)},
+                                  {true, false},
+                                  FOGtype::Pure,
+                                  "",
+                                  {},
+                                  "",
+                                  ""}));
+    }
+
+    PlanOptions options;
+    options.fuse_pure_chains = true;
+    core.setPlanOptions(options);
+
+    int input0 = 1, input1 = 2;
+    std::deque<Variable> inputs;
+    Assign(inputs, &input0, &input1);
+    REQUIRE(core.supposeInput(inputs));
+    std::deque<Variable> outputs(1);
+    outputs[0].create<int>();
+    REQUIRE(core.supposeOutput(outputs));
+
+    REQUIRE(core.newNode("a"));
+    REQUIRE(core.newNode("b"));
+    REQUIRE(core.newNode("c"));
+    REQUIRE(core.allocateFunc("add", "a"));
+    REQUIRE(core.allocateFunc("square", "b"));
+    REQUIRE(core.allocateFunc("square", "c"));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode(fase::InputNodeName(), 0, "a", 0));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode(fase::InputNodeName(), 1, "a", 1));
+    REQUIRE(LinkNodeError::None == core.linkNode("a", 2, "b", 0));
+    REQUIRE(LinkNodeError::None == core.linkNode("b", 1, "c", 0));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode("c", 1, fase::OutputNodeName(), 0));
+
+    Report report;
+    REQUIRE(core.run(&report));
+    REQUIRE(*outputs[0].getReader<int>() == 81);
+    REQUIRE(report.child_reports.count("a+b+c"));
+    // intermediate values stay inside of the fused step.
+    REQUIRE(*core.getNodes().at("b").args[1].getReader<int>() == 0);
+
+    input0 = 2;
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() == 256);
+
+    // a branch breaks the chain.
+    REQUIRE(core.newNode("d"));
+    REQUIRE(core.allocateFunc("square", "d"));
+    REQUIRE(LinkNodeError::None == core.linkNode("b", 1, "d", 0));
+    report = {};
+    REQUIRE(core.run(&report));
+    REQUIRE(*outputs[0].getReader<int>() == 256);
+    REQUIRE(report.child_reports.count("a+b"));
+    REQUIRE(report.child_reports.count("c"));
+    REQUIRE(*core.getNodes().at("d").args[1].getReader<int>() == 256);
+}
+
+TEST_CASE("Core empty input test") {
+    Core core;
+    {
+        auto univ_sq = UnivFuncGenerator<void(const int&, int&)>::Gen(
+                [&]() -> std::function<void(const int&, int&)> {
+                    return Square;
+                });
+        std::deque<Variable> default_args = {std::make_unique<int>(0),
+                                             std::make_unique<int>(0)};
+        REQUIRE(core.addUnivFunc(univ_sq, "square", std::move(default_args)));
+    }
+
+    std::deque<Variable> inputs(2);
+    inputs[0].create<int>(2);
+    inputs[1].create<int>(3);
+    REQUIRE(core.supposeInput(inputs));
+    std::deque<Variable> outputs(1);
+    outputs[0].create<int>();
+    REQUIRE(core.supposeOutput(outputs));
+    REQUIRE(core.newNode("a"));
+    REQUIRE(core.allocateFunc("square", "a"));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode(fase::InputNodeName(), 0, "a", 0));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode("a", 1, fase::OutputNodeName(), 0));
+
+    REQUIRE(core.run());
+
+    // An unused input may be emptied.
+    inputs[1].free();
+    REQUIRE(core.run());
+    REQUIRE(core.supposeInput(inputs));
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() == 4);
+
+    // A node fed by the empty input fails.
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode(fase::InputNodeName(), 1, "a", 0));
+    REQUIRE_FALSE(core.run());
+}
+
+TEST_CASE("Core constant folding test") {
+    Core core;
+    {
+        auto univ_add =
+                UnivFuncGenerator<void(const int&, const int&, int&)>::Gen(
+                        [&]() -> std::function<void(const int&, const int&,
+                                                    int&)> { return Add; });
+        std::deque<Variable> default_args = {std::make_unique<int>(1),
+                                             std::make_unique<int>(2),
+                                             std::make_unique<int>(0)};
+        REQUIRE(core.addUnivFunc(univ_add, "add", std::move(default_args),
+                                 {{"a", "b", "dst"},
+                                  {typeid(int), typeid(int), typeid(int)},
+                                  {true, true, false},
+                                  FOGtype::Pure,
+                                  "",
+                                  {},
+                                  "",
+                                  ""}));
+    }
+    {
+        auto univ_sq = UnivFuncGenerator<void(const int&, int&)>::Gen(
+                [&]() -> std::function<void(const int&, int&)> {
+                    return CountedSquare;
+                });
+        std::deque<Variable> default_args = {std::make_unique<int>(3),
+                                             std::make_unique<int>(0)};
+        REQUIRE(core.addUnivFunc(univ_sq, "square", std::move(default_args),
+                                 {{"in", "dst"},
+                                  {typeid(int), typeid(int)},
+                                  {true, false},
+                                  FOGtype::Pure,
+                                  "",
+                                  {},
+                                  "",
+                                  ""}));
+    }
+
+    PlanOptions options;
+    options.fold_constants = true;
+    core.setPlanOptions(options);
+
+    int input = 1;
+    std::deque<Variable> inputs;
+    Assign(inputs, &input);
+    REQUIRE(core.supposeInput(inputs));
+    std::deque<Variable> outputs(1);
+    outputs[0].create<int>();
+    REQUIRE(core.supposeOutput(outputs));
+
+    // k1 -> k2 -> a <- Input
+    REQUIRE(core.newNode("k1"));
+    REQUIRE(core.newNode("k2"));
+    REQUIRE(core.newNode("a"));
+    REQUIRE(core.allocateFunc("square", "k1"));
+    REQUIRE(core.allocateFunc("square", "k2"));
+    REQUIRE(core.allocateFunc("add", "a"));
+    REQUIRE(LinkNodeError::None == core.linkNode("k1", 1, "k2", 0));
+    REQUIRE(LinkNodeError::None == core.linkNode("k2", 1, "a", 0));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode(fase::InputNodeName(), 0, "a", 1));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode("a", 2, fase::OutputNodeName(), 0));
+
+    n_counted_square_calls = 0;
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() == 81 + 1);
+    input = 5;
+    REQUIRE(core.run());
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() == 81 + 5);
+    REQUIRE(n_counted_square_calls == 2);
+
+    // changing an argument of a folded node evaluates it again.
+    Variable v = std::make_unique<int>(2);
+    REQUIRE(core.setArgument("k1", 0, v));
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() == 16 + 5);
+    REQUIRE(n_counted_square_calls == 4);
+
+    // a node fed by Input is not folded.
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode(fase::InputNodeName(), 0, "k1", 0));
+    REQUIRE(core.run());
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() == 625 + 5);
+    REQUIRE(n_counted_square_calls == 8);
+}
+
+TEST_CASE("Core replace function test") {
+    Core core;
+    auto add_square = [&](void (*f)(const int&, int&), FOGtype type) {
+        auto univ_f = UnivFuncGenerator<void(const int&, int&)>::Gen(
+                [f]() -> std::function<void(const int&, int&)> { return f; });
+        std::deque<Variable> default_args = {std::make_unique<int>(3),
+                                             std::make_unique<int>(0)};
+        return core.replaceUnivFunc(univ_f, "square", std::move(default_args),
+                                    {{"in", "dst"},
+                                     {typeid(int), typeid(int)},
+                                     {true, false},
+                                     type,
+                                     "",
+                                     {},
+                                     "",
+                                     ""});
+    };
+    REQUIRE(add_square(Square, FOGtype::Pure));
+
+    PlanOptions options;
+    options.fold_constants = true;
+    core.setPlanOptions(options);
+
+    std::deque<Variable> outputs(1);
+    outputs[0].create<int>();
+    REQUIRE(core.supposeOutput(outputs));
+    REQUIRE(core.newNode("k"));
+    REQUIRE(core.allocateFunc("square", "k"));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode("k", 1, fase::OutputNodeName(), 0));
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() == 9);
+
+    // The folded value of the old function is not used.
+    REQUIRE(add_square(CountedSquare, FOGtype::Pure));
+    n_counted_square_calls = 0;
+    REQUIRE(core.run());
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() == 9);
+    REQUIRE(n_counted_square_calls == 1);
+
+    // Nor once it is not pure.
+    REQUIRE(add_square(CountedSquare, FOGtype::Lambda));
+    REQUIRE(core.run());
+    REQUIRE(core.run());
+    REQUIRE(n_counted_square_calls == 3);
+}
+
+TEST_CASE("Core pruning test") {
+    Core core;
+    {
+        auto univ_sq = UnivFuncGenerator<void(const int&, int&)>::Gen(
+                [&]() -> std::function<void(const int&, int&)> {
+                    return CountedSquare;
+                });
+        std::deque<Variable> default_args = {std::make_unique<int>(3),
+                                             std::make_unique<int>(0)};
+        REQUIRE(core.addUnivFunc(univ_sq, "square", std::move(default_args),
+                                 {{"in", "dst"},
+                                  {typeid(int), typeid(int)},
+                                  {true, false},
+                                  FOGtype::Pure,
+                                  "",
+                                  {},
+                                  "",
+                                  ""}));
+    }
+
+    int input = 2;
+    std::deque<Variable> inputs;
+    Assign(inputs, &input);
+    REQUIRE(core.supposeInput(inputs));
+    std::deque<Variable> outputs(2);
+    outputs[0].create<int>();
+    outputs[1].create<int>();
+    REQUIRE(core.supposeOutput(outputs));
+
+    // Input -> a -> Output[0]
+    // Input -> b -> Output[1]
+    // Input -> c
+    for (auto n_name : {"a", "b", "c"}) {
+        REQUIRE(core.newNode(n_name));
+        REQUIRE(core.allocateFunc("square", n_name));
+        REQUIRE(LinkNodeError::None ==
+                core.linkNode(fase::InputNodeName(), 0, n_name, 0));
+    }
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode("a", 1, fase::OutputNodeName(), 0));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode("b", 1, fase::OutputNodeName(), 1));
+
+    // without the option, every node runs.
+    n_counted_square_calls = 0;
+    REQUIRE(core.run());
+    REQUIRE(n_counted_square_calls == 3);
+
+    PlanOptions options;
+    options.prune_dead_nodes = true;
+    core.setPlanOptions(options);
+    n_counted_square_calls = 0;
+    REQUIRE(core.run());
+    REQUIRE(n_counted_square_calls == 2);
+
+    REQUIRE(core.setSideEffect("c", true));
+    n_counted_square_calls = 0;
+    REQUIRE(core.run());
+    REQUIRE(n_counted_square_calls == 3);
+
+    // only the demanded output is computed.
+    input = 3;
+    n_counted_square_calls = 0;
+    REQUIRE(core.run({1}));
+    REQUIRE(n_counted_square_calls == 2);
+    REQUIRE(*outputs[0].getReader<int>() == 4);
+    REQUIRE(*outputs[1].getReader<int>() == 9);
+
+    REQUIRE_FALSE(core.run({2}));
+    REQUIRE_FALSE(core.setSideEffect("d", true));
+}
+
+TEST_CASE("Core inline test") {
+    auto univ_sq = UnivFuncGenerator<void(const int&, int&)>::Gen(
+            [&]() -> std::function<void(const int&, int&)> {
+                return CountedSquare;
+            });
+    FunctionUtils sq_utils = {{"in", "dst"},
+                              {typeid(int), typeid(int)},
+                              {true, false},
+                              FOGtype::Pure,
+                              "",
+                              {},
+                              "",
+                              ""};
+
+    // sub : Input -> x -> y -> Output
+    Core sub;
+    REQUIRE(sub.addUnivFunc(univ_sq, "square",
+                            {std::make_unique<int>(0), std::make_unique<int>(0)},
+                            sq_utils));
+    std::deque<Variable> sub_vars = {std::make_unique<int>(0),
+                                     std::make_unique<int>(0)};
+    std::deque<Variable> sub_inputs, sub_outputs;
+    RefCopy(sub_vars.begin(), sub_vars.begin() + 1, &sub_inputs);
+    RefCopy(sub_vars.begin() + 1, sub_vars.end(), &sub_outputs);
+    REQUIRE(sub.supposeInput(sub_inputs));
+    REQUIRE(sub.supposeOutput(sub_outputs));
+    REQUIRE(sub.newNode("x"));
+    REQUIRE(sub.newNode("y"));
+    REQUIRE(sub.allocateFunc("square", "x"));
+    REQUIRE(sub.allocateFunc("square", "y"));
+    REQUIRE(LinkNodeError::None ==
+            sub.linkNode(fase::InputNodeName(), 0, "x", 0));
+    REQUIRE(LinkNodeError::None == sub.linkNode("x", 1, "y", 0));
+    REQUIRE(LinkNodeError::None ==
+            sub.linkNode("y", 1, fase::OutputNodeName(), 0));
+
+    // core : Input -> n (calls sub) -> m -> Output
+    Core core;
+    REQUIRE(core.addUnivFunc(univ_sq, "square",
+                             {std::make_unique<int>(0),
+                              std::make_unique<int>(0)},
+                             sq_utils));
+    REQUIRE(core.addUnivFunc(
+            [sub](std::deque<Variable>& vs, Report*) mutable {
+                std::deque<Variable> inputs, outputs;
+                RefCopy(vs.begin(), vs.begin() + 1, &inputs);
+                RefCopy(vs.begin() + 1, vs.end(), &outputs);
+                sub.supposeInput(inputs);
+                sub.supposeOutput(outputs);
+                sub.run();
+            },
+            "sub", {std::make_unique<int>(0), std::make_unique<int>(0)}));
+    int input = 2;
+    std::deque<Variable> inputs;
+    Assign(inputs, &input);
+    REQUIRE(core.supposeInput(inputs));
+    std::deque<Variable> outputs(1);
+    outputs[0].create<int>();
+    REQUIRE(core.supposeOutput(outputs));
+    REQUIRE(core.newNode("n"));
+    REQUIRE(core.newNode("m"));
+    REQUIRE(core.allocateFunc("sub", "n"));
+    REQUIRE(core.allocateFunc("square", "m"));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode(fase::InputNodeName(), 0, "n", 0));
+    REQUIRE(LinkNodeError::None == core.linkNode("n", 1, "m", 0));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode("m", 1, fase::OutputNodeName(), 0));
+
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() == 256);
+
+    REQUIRE(core.inlineNode("n", sub));
+    REQUIRE_FALSE(core.getNodes().count("n"));
+    REQUIRE(core.getNodes().count("n.x"));
+    REQUIRE(core.getNodes().count("n.y"));
+    input = 3;
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() == 6561);
+
+    REQUIRE_FALSE(core.inlineNode("n", sub));
+    REQUIRE_FALSE(core.inlineNode(fase::InputNodeName(), sub));
+}
+
+TEST_CASE("Core inline stateful test") {
+    // Adds the count of calls, which each copy of the function has.
+    auto univ_count = UnivFuncGenerator<void(const int&, int&)>::Gen(
+            []() -> std::function<void(const int&, int&)> {
+                return [n = 0](const int& in, int& dst) mutable {
+                    dst = in + n++;
+                };
+            });
+
+    // sub : Input -> c -> Output
+    auto sub = std::make_shared<Core>();
+    REQUIRE(sub->addUnivFunc(
+            univ_count, "count",
+            {std::make_unique<int>(0), std::make_unique<int>(0)}));
+    std::deque<Variable> sub_vars = {std::make_unique<int>(0),
+                                     std::make_unique<int>(0)};
+    std::deque<Variable> sub_inputs, sub_outputs;
+    RefCopy(sub_vars.begin(), sub_vars.begin() + 1, &sub_inputs);
+    RefCopy(sub_vars.begin() + 1, sub_vars.end(), &sub_outputs);
+    REQUIRE(sub->supposeInput(sub_inputs));
+    REQUIRE(sub->supposeOutput(sub_outputs));
+    REQUIRE(sub->newNode("c"));
+    REQUIRE(sub->allocateFunc("count", "c"));
+    REQUIRE(LinkNodeError::None ==
+            sub->linkNode(fase::InputNodeName(), 0, "c", 0));
+    REQUIRE(LinkNodeError::None ==
+            sub->linkNode("c", 1, fase::OutputNodeName(), 0));
+
+    // core : Input -> n1, n2 (both call sub) -> Output
+    // The nodes share `sub`, as pipelines of CoreManager do.
+    Core core;
+    REQUIRE(core.addUnivFunc(
+            [sub](std::deque<Variable>& vs, Report*) {
+                std::deque<Variable> inputs, outputs;
+                RefCopy(vs.begin(), vs.begin() + 1, &inputs);
+                RefCopy(vs.begin() + 1, vs.end(), &outputs);
+                sub->supposeInput(inputs);
+                sub->supposeOutput(outputs);
+                sub->run();
+            },
+            "sub", {std::make_unique<int>(0), std::make_unique<int>(0)}));
+    int input = 10;
+    std::deque<Variable> inputs;
+    Assign(inputs, &input);
+    REQUIRE(core.supposeInput(inputs));
+    std::deque<Variable> outputs(2);
+    outputs[0].create<int>();
+    outputs[1].create<int>();
+    REQUIRE(core.supposeOutput(outputs));
+    REQUIRE(core.newNode("n1"));
+    REQUIRE(core.newNode("n2"));
+    REQUIRE(core.allocateFunc("sub", "n1"));
+    REQUIRE(core.allocateFunc("sub", "n2"));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode(fase::InputNodeName(), 0, "n1", 0));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode(fase::InputNodeName(), 0, "n2", 0));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode("n1", 1, fase::OutputNodeName(), 0));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode("n2", 1, fase::OutputNodeName(), 1));
+
+    // The calls count up one state.
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() + *outputs[1].getReader<int>() ==
+            10 + 11);
+
+    // Once inlined, each node counts its own calls on from the copied state.
+    REQUIRE(core.inlineNode("n1", *sub));
+    REQUIRE(core.inlineNode("n2", *sub));
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() == 12);
+    REQUIRE(*outputs[1].getReader<int>() == 12);
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() == 13);
+    REQUIRE(*outputs[1].getReader<int>() == 13);
+}
+
+TEST_CASE("Core checkpoint test") {
+    Core core;
+    {
+        auto univ_add =
+                UnivFuncGenerator<void(const int&, const int&, int&)>::Gen(
+                        [&]() -> std::function<void(const int&, const int&,
+                                                    int&)> { return Add; });
+        std::deque<Variable> default_args = {std::make_unique<int>(1),
+                                             std::make_unique<int>(2),
+                                             std::make_unique<int>(0)};
+        REQUIRE(core.addUnivFunc(univ_add, "add", std::move(default_args),
+                                 {{"a", "b", "dst"},
+                                  {typeid(int), typeid(int), typeid(int)},
+                                  {true, true, false},
+                                  FOGtype::Pure,
+                                  "",
+                                  {},
+                                  "",
+                                  ""}));
+    }
+    {
+        auto univ_sq = UnivFuncGenerator<void(const int&, int&)>::Gen(
+                [&]() -> std::function<void(const int&, int&)> {
+                    return CountedSquare;
+                });
+        std::deque<Variable> default_args = {std::make_unique<int>(3),
+                                             std::make_unique<int>(0)};
+        REQUIRE(core.addUnivFunc(univ_sq, "square", std::move(default_args),
+                                 {{"in", "dst"},
+                                  {typeid(int), typeid(int)},
+                                  {true, false},
+                                  FOGtype::Pure,
+                                  "",
+                                  {},
+                                  "",
+                                  ""}));
+    }
+    auto store = std::make_shared<CheckpointStore>();
+    TempDir dir("fase_checkpoint_test");
+    store->dir = dir.path;
+    SetupTypeConverters(&store->converters);
+    core.setCheckpointStore(store);
+
+    int input = 2;
+    std::deque<Variable> inputs;
+    Assign(inputs, &input);
+    REQUIRE(core.supposeInput(inputs));
+    std::deque<Variable> outputs(1);
+    outputs[0].create<int>();
+    REQUIRE(core.supposeOutput(outputs));
+
+    // Input -> k1 -> k2 -> a <- Input
+    REQUIRE(core.newNode("k1"));
+    REQUIRE(core.newNode("k2"));
+    REQUIRE(core.newNode("a"));
+    REQUIRE(core.allocateFunc("square", "k1"));
+    REQUIRE(core.allocateFunc("square", "k2"));
+    REQUIRE(core.allocateFunc("add", "a"));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode(fase::InputNodeName(), 0, "k1", 0));
+    REQUIRE(LinkNodeError::None == core.linkNode("k1", 1, "k2", 0));
+    REQUIRE(LinkNodeError::None == core.linkNode("k2", 1, "a", 0));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode(fase::InputNodeName(), 0, "a", 1));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode("a", 2, fase::OutputNodeName(), 0));
+    REQUIRE(core.setCheckpoint("k2", true));
+    REQUIRE_FALSE(core.setCheckpoint("x", true));
+
+    n_counted_square_calls = 0;
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() == 16 + 2);
+    REQUIRE(n_counted_square_calls == 2);
+
+    // k2 is loaded, and k1 is needed by nothing else.
+    Core restarted = core;
+    std::deque<Variable> vars;
+    vars.emplace_back(inputs[0].ref());
+    vars.emplace_back(outputs[0].ref());
+    REQUIRE(restarted.bindVariables(vars));
+    *outputs[0].getWriter<int>() = 0;
+    REQUIRE(restarted.run());
+    REQUIRE(*outputs[0].getReader<int>() == 16 + 2);
+    REQUIRE(n_counted_square_calls == 2);
+
+    // Another key by another input.
+    input = 3;
+    REQUIRE(restarted.run());
+    REQUIRE(*outputs[0].getReader<int>() == 81 + 3);
+    REQUIRE(n_counted_square_calls == 4);
+    input = 2;
+    REQUIRE(restarted.run());
+    REQUIRE(*outputs[0].getReader<int>() == 16 + 2);
+    REQUIRE(n_counted_square_calls == 4);
+
+    // Not loaded once disabled.
+    REQUIRE(restarted.setCheckpoint("k2", false));
+    REQUIRE(restarted.run());
+    REQUIRE(n_counted_square_calls == 6);
+}
+
+TEST_CASE("Core memo cache test") {
+    Core core;
+    {
+        auto univ_sq = UnivFuncGenerator<void(const int&, int&)>::Gen(
+                [&]() -> std::function<void(const int&, int&)> {
+                    return CountedSquare;
+                });
+        std::deque<Variable> default_args = {std::make_unique<int>(3),
+                                             std::make_unique<int>(0)};
+        REQUIRE(core.addUnivFunc(univ_sq, "square", std::move(default_args),
+                                 {{"in", "dst"},
+                                  {typeid(int), typeid(int)},
+                                  {true, false},
+                                  FOGtype::Pure,
+                                  "",
+                                  {},
+                                  "",
+                                  ""}));
+    }
+    TSCMap converters;
+    SetupTypeConverters(&converters);
+    // Room for two results of int with their inputs.
+    auto cache = std::make_shared<MemoCache>(4 * sizeof(int), converters);
+    core.setMemoCache(cache);
+
+    int input = 2;
+    std::deque<Variable> inputs;
+    Assign(inputs, &input);
+    REQUIRE(core.supposeInput(inputs));
+    std::deque<Variable> outputs(2);
+    outputs[0].create<int>();
+    outputs[1].create<int>();
+    REQUIRE(core.supposeOutput(outputs));
+
+    // Input -> a -> b -> Output[0], Input -> c -> Output[1]
+    REQUIRE(core.newNode("a"));
+    REQUIRE(core.newNode("b"));
+    REQUIRE(core.newNode("c"));
+    REQUIRE(core.allocateFunc("square", "a"));
+    REQUIRE(core.allocateFunc("square", "b"));
+    REQUIRE(core.allocateFunc("square", "c"));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode(fase::InputNodeName(), 0, "a", 0));
+    REQUIRE(LinkNodeError::None == core.linkNode("a", 1, "b", 0));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode(fase::InputNodeName(), 0, "c", 0));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode("b", 1, fase::OutputNodeName(), 0));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode("c", 1, fase::OutputNodeName(), 1));
+
+    // Not cached until enabled.
+    n_counted_square_calls = 0;
+    REQUIRE(core.run());
+    REQUIRE(n_counted_square_calls == 3);
+    REQUIRE(cache->getUsedBytes() == 0);
+
+    cache->enable("square");
+    Report report;
+    REQUIRE(core.run(&report));
+    REQUIRE(*outputs[0].getReader<int>() == 16);
+    REQUIRE(*outputs[1].getReader<int>() == 4);
+    // a and c have the same input.
+    REQUIRE(n_counted_square_calls == 5);
+    REQUIRE(report.child_reports["a"].memo_misses +
+                    report.child_reports["c"].memo_misses ==
+            1);
+    REQUIRE(report.child_reports["a"].memo_hits +
+                    report.child_reports["c"].memo_hits ==
+            1);
+    REQUIRE(cache->getUsedBytes() == 4 * sizeof(int));
+
+    report = {};
+    REQUIRE(core.run(&report));
+    REQUIRE(*outputs[0].getReader<int>() == 16);
+    REQUIRE(n_counted_square_calls == 5);
+    REQUIRE(report.child_reports["b"].memo_hits == 1);
+
+    // Over the budget, the least recently used results are dropped.
+    input = 3;
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() == 81);
+    REQUIRE(n_counted_square_calls == 7);
+    REQUIRE(cache->getUsedBytes() == 4 * sizeof(int));
+    input = 2;
+    REQUIRE(core.run());
+    REQUIRE(*outputs[0].getReader<int>() == 16);
+    REQUIRE(n_counted_square_calls == 9);
+
+    // Fused nodes also look up the cache.
+    PlanOptions options;
+    options.fuse_pure_chains = true;
+    core.setPlanOptions(options);
+    report = {};
+    REQUIRE(core.run(&report));
+    REQUIRE(*outputs[0].getReader<int>() == 16);
+    REQUIRE(n_counted_square_calls == 9);
+    REQUIRE(report.child_reports["a+b"].memo_hits == 2);
+
+    cache->clear();
+    REQUIRE(cache->getUsedBytes() == 0);
+}
+
+TEST_CASE("Core memo cache collision test") {
+    Core core;
+    {
+        auto univ_add =
+                UnivFuncGenerator<void(const int&, const int&, int&)>::Gen(
+                        [&]() -> std::function<void(const int&, const int&,
+                                                    int&)> { return Add; });
+        std::deque<Variable> default_args = {std::make_unique<int>(1),
+                                             std::make_unique<int>(2),
+                                             std::make_unique<int>(0)};
+        REQUIRE(core.addUnivFunc(univ_add, "add", std::move(default_args),
+                                 {{"a", "b", "dst"},
+                                  {typeid(int), typeid(int), typeid(int)},
+                                  {true, true, false},
+                                  FOGtype::Pure,
+                                  "",
+                                  {},
+                                  "",
+                                  ""}));
+    }
+    TSCMap converters;
+    SetupTypeConverters(&converters);
+    // All inputs fall into the same bucket.
+    converters[typeid(int)].hasher = [](const Variable&) -> size_t {
+        return 0;
+    };
+    auto cache = std::make_shared<MemoCache>(1024, converters);
+    cache->enable("add");
+    core.setMemoCache(cache);
+
+    int a = 0, b = 0;
+    std::deque<Variable> inputs;
+    Assign(inputs, &a, &b);
+    REQUIRE(core.supposeInput(inputs));
+    std::deque<Variable> outputs(1);
+    outputs[0].create<int>();
+    REQUIRE(core.supposeOutput(outputs));
+    REQUIRE(core.newNode("s"));
+    REQUIRE(core.allocateFunc("add", "s"));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode(fase::InputNodeName(), 0, "s", 0));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode(fase::InputNodeName(), 1, "s", 1));
+    REQUIRE(LinkNodeError::None ==
+            core.linkNode("s", 2, fase::OutputNodeName(), 0));
+
+    Report report;
+    REQUIRE(core.run(&report));
+    REQUIRE(*outputs[0].getReader<int>() == 0);
+    REQUIRE(report.child_reports["s"].memo_misses == 1);
+
+    // The same hash, but other inputs.
+    a = 1, b = 63;
+    report = {};
+    REQUIRE(core.run(&report));
+    REQUIRE(*outputs[0].getReader<int>() == 64);
+    REQUIRE(report.child_reports["s"].memo_misses == 1);
+
+    a = 0, b = 0;
+    report = {};
+    REQUIRE(core.run(&report));
+    REQUIRE(*outputs[0].getReader<int>() == 0);
+    REQUIRE(report.child_reports["s"].memo_hits == 1);
+}
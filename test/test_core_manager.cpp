@@ -1,7 +1,10 @@
 #include <catch2/catch.hpp>
 
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <random>
 
 #include "fase2/constants.h"
 #include "fase2/fase.h"
@@ -16,6 +19,30 @@ static void Square(const int& in, int& dst) {
     dst = in * in;
 }
 
+namespace {
+
+// Directory removed at the end of the scope. The name is made unique, so that
+// parallel runs do not share it.
+class TempDir {
+public:
+    explicit TempDir(const std::string& name)
+        : path((std::filesystem::temp_directory_path() /
+                (name + "-" + std::to_string(std::random_device()())))
+                       .string()) {
+        std::filesystem::create_directories(path);
+    }
+    ~TempDir() {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    const std::string path;
+};
+
+} // namespace
+
 TEST_CASE("Core Manager test") {
     CoreManager cm;
 
@@ -185,7 +212,14 @@ TEST_CASE("Core Manager test") {
         exported.reset();
         exported(vs);
         REQUIRE(result == (3 + 3) * (3 + 3));
+        auto copied = exported; // copies share the program, not the state.
+        copied(vs);
+        REQUIRE(result == (3 + 4) * (3 + 4));
         exported(vs);
+        REQUIRE(result == (3 + 4) * (3 + 4));
+        copied.reset();
+        copied(vs);
+        REQUIRE(result == (3 + 3) * (3 + 3));
         exported(vs);
         exported(vs);
         for (Variable& v : vs) {
@@ -241,3 +275,646 @@ TEST_CASE("Core Manager test") {
         REQUIRE(cm["Pipe3"].allocateFunc("Pipe2", "p2"));
     }
 }
+
+TEST_CASE("Core Manager export sink test") {
+    CoreManager cm;
+    auto univ_sq = UnivFuncGenerator<void(const int&, int&)>::Gen(
+            []() -> std::function<void(const int&, int&)> { return Square; });
+    REQUIRE(cm.addUnivFunc(univ_sq, "square",
+                           {std::make_unique<int>(4), std::make_unique<int>(0)},
+                           {{"in", "dst"},
+                            {typeid(int), typeid(int)},
+                            {true, false},
+                            FOGtype::Pure,
+                            "",
+                            {},
+                            "",
+                            ""}));
+    // An impure node without outputs, which is not marked by setSideEffect().
+    int n_sunk = 0;
+    auto univ_sink = UnivFuncGenerator<void(const int&)>::Gen(
+            [&]() -> std::function<void(const int&)> {
+                return [&](const int&) { n_sunk++; };
+            });
+    REQUIRE(cm.addUnivFunc(univ_sink, "sink", {std::make_unique<int>(0)},
+                           {{"in"},
+                            {typeid(int)},
+                            {true},
+                            FOGtype::Lambda,
+                            "",
+                            {},
+                            "",
+                            ""}));
+
+    // Input -> n -> Output, n -> s, Input -> m
+    auto& pipe = cm["Pipe"];
+    REQUIRE(pipe.supposeInput({"x"}));
+    REQUIRE(pipe.supposeOutput({"y"}));
+    REQUIRE(pipe.newNode("n"));
+    REQUIRE(pipe.newNode("m"));
+    REQUIRE(pipe.newNode("s"));
+    REQUIRE(pipe.allocateFunc("square", "n"));
+    REQUIRE(pipe.allocateFunc("square", "m"));
+    REQUIRE(pipe.allocateFunc("sink", "s"));
+    REQUIRE(pipe.smartLink(InputNodeName(), 0, "n", 0) == LinkNodeError::None);
+    REQUIRE(pipe.smartLink(InputNodeName(), 0, "m", 0) == LinkNodeError::None);
+    REQUIRE(pipe.smartLink("n", 1, OutputNodeName(), 0) ==
+            LinkNodeError::None);
+    REQUIRE(pipe.smartLink("n", 1, "s", 0) == LinkNodeError::None);
+
+    auto exported = cm.exportPipe("Pipe");
+    int input = 3, result = 0;
+    std::deque<Variable> vs;
+    Assign(vs, &input, &result);
+    exported(vs);
+    exported(vs);
+    REQUIRE(result == 9);
+    REQUIRE(n_sunk == 2);
+    for (Variable& v : vs) {
+        v.free();
+    }
+}
+
+TEST_CASE("Core Manager export reset test") {
+    CoreManager cm;
+    auto univ_sq = UnivFuncGenerator<void(const int&, int&)>::Gen(
+            []() -> std::function<void(const int&, int&)> { return Square; });
+    REQUIRE(cm.addUnivFunc(univ_sq, "square",
+                           {std::make_unique<int>(3), std::make_unique<int>(0)},
+                           {{"in", "dst"},
+                            {typeid(int), typeid(int)},
+                            {true, false},
+                            FOGtype::Pure,
+                            "",
+                            {},
+                            "",
+                            ""}));
+    // dst := in + (number of calls)
+    auto univ_acc = UnivFuncGenerator<void(const int&, int&)>::Gen(
+            []() -> std::function<void(const int&, int&)> {
+                return [n = 0](const int& in, int& dst) mutable {
+                    dst = in + n++;
+                };
+            });
+    REQUIRE(cm.addUnivFunc(univ_acc, "accumulate",
+                           {std::make_unique<int>(0), std::make_unique<int>(0)},
+                           {{"in", "dst"},
+                            {typeid(int), typeid(int)},
+                            {true, false},
+                            FOGtype::Lambda,
+                            "",
+                            {},
+                            "",
+                            ""}));
+
+    // k (folded) -> acc -> Output
+    auto& pipe = cm["Pipe"];
+    REQUIRE(pipe.supposeOutput({"y"}));
+    REQUIRE(pipe.newNode("k"));
+    REQUIRE(pipe.newNode("acc"));
+    REQUIRE(pipe.allocateFunc("square", "k"));
+    REQUIRE(pipe.allocateFunc("accumulate", "acc"));
+    REQUIRE(pipe.smartLink("k", 1, "acc", 0) == LinkNodeError::None);
+    REQUIRE(pipe.smartLink("acc", 1, OutputNodeName(), 0) ==
+            LinkNodeError::None);
+
+    auto exported = cm.exportPipe("Pipe");
+    int result = 0;
+    std::deque<Variable> vs;
+    Assign(vs, &result);
+    exported(vs);
+    REQUIRE(result == 9);
+    exported(vs);
+    REQUIRE(result == 10);
+    exported.reset();
+    exported(vs);
+    REQUIRE(result == 9);
+    exported(vs);
+    REQUIRE(result == 10);
+    for (Variable& v : vs) {
+        v.free();
+    }
+}
+
+TEST_CASE("Core Manager handle test") {
+    CoreManager cm;
+    auto univ_sq = UnivFuncGenerator<void(const int&, int&)>::Gen(
+            []() -> std::function<void(const int&, int&)> { return Square; });
+    std::deque<Variable> default_args = {std::make_unique<int>(4),
+                                         std::make_unique<int>(0)};
+    REQUIRE(cm.addUnivFunc(univ_sq, "square", std::move(default_args),
+                           {{"in", "dst"},
+                            {typeid(int), typeid(int)},
+                            {true, false},
+                            FOGtype::Pure,
+                            "",
+                            {},
+                            "",
+                            ""}));
+
+    REQUIRE_FALSE(cm.findHandle("Sub"));
+    PipelineHandle sub = cm.getHandle("Sub");
+    PipelineHandle main = cm.getHandle("Main");
+    REQUIRE(sub);
+    REQUIRE(main);
+    REQUIRE(sub != main);
+    REQUIRE(cm.findHandle("Sub") == sub);
+    REQUIRE(cm.getName(main) == "Main");
+    REQUIRE_FALSE(cm.getHandle("0bad"));
+    REQUIRE(cm.getName(PipelineHandle()).empty());
+    REQUIRE_FALSE(cm[PipelineHandle()].newNode("a"));
+
+    REQUIRE(cm[sub].newNode("s"));
+    REQUIRE(cm[sub].allocateFunc("square", "s"));
+    REQUIRE(&cm[sub] == &cm["Sub"]);
+    REQUIRE(cm[main].newNode("m"));
+    REQUIRE(cm[main].allocateFunc("Sub", "m"));
+    REQUIRE(cm.getDependingTree().getDependings("Main") ==
+            std::vector<std::string>{"Sub"});
+
+    // Handles and the dependencies are kept in copies, separately.
+    CoreManager copied = cm;
+    REQUIRE(copied.getName(main) == "Main");
+    REQUIRE(copied[main].getNodes().count("m"));
+    REQUIRE(copied[main].delNode("m"));
+    REQUIRE(copied.getDependingTree().isIndependent("Main"));
+    REQUIRE(cm.getDependingTree().getDependings("Main") ==
+            std::vector<std::string>{"Sub"});
+    REQUIRE(cm[main].getNodes().count("m"));
+
+    // Nodes, functions and ports.
+    auto& pipe = cm[sub];
+    REQUIRE_FALSE(pipe.findNode("t"));
+    REQUIRE_FALSE(pipe.findFunction("unknown"));
+    REQUIRE(pipe.newNode("t"));
+    NodeHandle s = pipe.findNode("s");
+    NodeHandle t = pipe.findNode("t");
+    FunctionHandle square = pipe.findFunction("square");
+    REQUIRE(s);
+    REQUIRE(t);
+    REQUIRE(s != t);
+    REQUIRE(pipe.getName(t) == "t");
+    REQUIRE(pipe.getName(square) == "square");
+    REQUIRE(pipe.getName(pipe.findFunction("Main")) == "Main");
+    REQUIRE(pipe.findNode(InputNodeName()));
+    REQUIRE(pipe.getName(NodeHandle()).empty());
+
+    REQUIRE(pipe.allocateFunc(square, t));
+    REQUIRE(pipe.getNodes().at("t").func_name == "square");
+    REQUIRE(pipe.smartLink({s, 1}, {t, 0}) == LinkNodeError::None);
+    REQUIRE(pipe.getLinks().size() == 1);
+    REQUIRE_FALSE(pipe.setPriority(NodeHandle(), 1));
+
+    // A node handle follows the node while renamed, until deleted.
+    REQUIRE(pipe.renameNode(t, "u"));
+    REQUIRE(pipe.findNode("u") == t);
+    REQUIRE_FALSE(pipe.findNode("t"));
+    REQUIRE(pipe.getName(t) == "u");
+    REQUIRE(pipe.setPriority(t, 2));
+    REQUIRE(pipe.getNodes().at("u").priority == 2);
+    REQUIRE(pipe.unlinkNode({t, 0}));
+    REQUIRE(pipe.getLinks().empty());
+
+    // Copies have the same handles.
+    CoreManager copied2 = cm;
+    REQUIRE(copied2[sub].getName(t) == "u");
+    REQUIRE(pipe.delNode(t));
+    REQUIRE(pipe.getName(t).empty());
+    REQUIRE_FALSE(pipe.findNode("u"));
+    REQUIRE_FALSE(pipe.delNode(t));
+    REQUIRE(copied2[sub].getName(t) == "u");
+    REQUIRE(pipe.newNode("u"));
+    REQUIRE(pipe.findNode("u") != t);
+}
+
+TEST_CASE("Core Manager binding update test") {
+    CoreManager cm;
+    auto univ_sq = UnivFuncGenerator<void(const int&, int&)>::Gen(
+            []() -> std::function<void(const int&, int&)> { return Square; });
+    std::deque<Variable> default_args = {std::make_unique<int>(4),
+                                         std::make_unique<int>(0)};
+    REQUIRE(cm.addUnivFunc(univ_sq, "square", std::move(default_args),
+                           {{"in", "dst"},
+                            {typeid(int), typeid(int)},
+                            {true, false},
+                            FOGtype::Pure,
+                            "",
+                            {},
+                            "",
+                            ""}));
+
+    auto& sub = cm["Sub"];
+    REQUIRE(sub.supposeInput({"x"}));
+    REQUIRE(sub.supposeOutput({"y"}));
+    Variable x = std::make_unique<int>(2);
+    Variable y = std::make_unique<int>(0);
+    REQUIRE(sub.setArgument(InputNodeName(), 0, x));
+    REQUIRE(sub.setArgument(OutputNodeName(), 0, y));
+    REQUIRE(sub.newNode("s"));
+    REQUIRE(sub.allocateFunc("square", "s"));
+    REQUIRE(sub.smartLink(InputNodeName(), 0, "s", 0) == LinkNodeError::None);
+    REQUIRE(sub.smartLink("s", 1, OutputNodeName(), 0) ==
+            LinkNodeError::None);
+
+    auto& main = cm["Main"];
+    REQUIRE(main.newNode("m"));
+    REQUIRE(main.allocateFunc("Sub", "m"));
+    REQUIRE(*main.getNodes().at("m").args[0].getReader<int>() == 2);
+    Variable v = std::make_unique<int>(5);
+    REQUIRE(main.setArgument("m", 0, v));
+
+    // A new default of the input keeps the arguments of the nodes.
+    Variable x2 = std::make_unique<int>(3);
+    REQUIRE(sub.setArgument(InputNodeName(), 0, x2));
+    REQUIRE(*main.getNodes().at("m").args[0].getReader<int>() == 5);
+    REQUIRE(main.newNode("m2"));
+    REQUIRE(main.allocateFunc("Sub", "m2"));
+    REQUIRE(*main.getNodes().at("m2").args[0].getReader<int>() == 3);
+    auto& other = cm["Other"];
+    REQUIRE(other.newNode("o"));
+    REQUIRE(other.allocateFunc("Sub", "o"));
+    REQUIRE(*other.getNodes().at("o").args[0].getReader<int>() == 3);
+
+    REQUIRE(main.run());
+    REQUIRE(*main.getNodes().at("m").args[1].getReader<int>() == 25);
+
+    // A new input reallocates them.
+    REQUIRE(sub.supposeInput({"x", "z"}));
+    REQUIRE(main.getNodes().at("m").args.size() == 3);
+    REQUIRE(other.getNodes().at("o").args.size() == 3);
+}
+
+TEST_CASE("Core Manager snapshot test") {
+    auto cm = std::make_unique<CoreManager>();
+    auto univ_sq = UnivFuncGenerator<void(const int&, int&)>::Gen(
+            []() -> std::function<void(const int&, int&)> { return Square; });
+    std::deque<Variable> default_args = {std::make_unique<int>(4),
+                                         std::make_unique<int>(0)};
+    REQUIRE(cm->addUnivFunc(univ_sq, "square", std::move(default_args),
+                            {{"in", "dst"},
+                             {typeid(int), typeid(int)},
+                             {true, false},
+                             FOGtype::Pure,
+                             "",
+                             {},
+                             "",
+                             ""}));
+
+    auto make_pipe = [&](const std::string& p_name,
+                         const std::string& f_name) {
+        auto& pipe = (*cm)[p_name];
+        REQUIRE(pipe.supposeInput({"x"}));
+        REQUIRE(pipe.supposeOutput({"y"}));
+        Variable x = std::make_unique<int>(3);
+        Variable y = std::make_unique<int>(0);
+        REQUIRE(pipe.setArgument(InputNodeName(), 0, x));
+        REQUIRE(pipe.setArgument(OutputNodeName(), 0, y));
+        REQUIRE(pipe.newNode("n"));
+        REQUIRE(pipe.allocateFunc(f_name, "n"));
+        REQUIRE(pipe.smartLink(InputNodeName(), 0, "n", 0) ==
+                LinkNodeError::None);
+        REQUIRE(pipe.smartLink("n", 1, OutputNodeName(), 0) ==
+                LinkNodeError::None);
+    };
+    make_pipe("Sub", "square");
+    make_pipe("Main", "Sub");
+    make_pipe("Other", "square");
+    auto result = [](const CoreManager& m, const std::string& p_name) {
+        auto& o_args = m[p_name].getNodes().at(OutputNodeName()).args;
+        return *o_args[0].getReader<int>();
+    };
+
+    CoreManager snap = *cm;
+    // Pipelines are shared until written.
+    for (auto& p_name : {"Sub", "Main", "Other"}) {
+        REQUIRE(&std::as_const(snap)[p_name].getNodes() ==
+                &std::as_const(*cm)[p_name].getNodes());
+    }
+
+    // Sub returns 10 * 10 instead.
+    REQUIRE((*cm)["Sub"].unlinkNode("n", 0));
+    Variable ten = std::make_unique<int>(10);
+    REQUIRE((*cm)["Sub"].setArgument("n", 0, ten));
+    REQUIRE((*cm)["Main"].run());
+    REQUIRE(result(*cm, "Main") == 100);
+    REQUIRE(&std::as_const(snap)["Other"].getNodes() ==
+            &std::as_const(*cm)["Other"].getNodes());
+    REQUIRE(&std::as_const(snap)["Sub"].getNodes() !=
+            &std::as_const(*cm)["Sub"].getNodes());
+
+    // Editing a pipeline does not copy the ones called by it.
+    CoreManager edited = snap;
+    REQUIRE(edited["Main"].setPriority("n", 1));
+    REQUIRE(&std::as_const(snap)["Sub"].getNodes() ==
+            &std::as_const(edited)["Sub"].getNodes());
+    REQUIRE(&std::as_const(snap)["Main"].getNodes() !=
+            &std::as_const(edited)["Main"].getNodes());
+    edited = *cm;
+    REQUIRE(&std::as_const(edited)["Main"].getNodes() ==
+            &std::as_const(*cm)["Main"].getNodes());
+
+    // The snapshot calls its own Sub, even after the original is gone.
+    cm.reset();
+    REQUIRE(snap["Main"].run());
+    REQUIRE(result(snap, "Main") == 9);
+    REQUIRE(snap["Sub"].getLinks().size() == 2);
+}
+
+TEST_CASE("DependenceTree test") {
+    DependenceTree tree;
+    // a -> b -> d, a -> c -> d, a -> d
+    REQUIRE(tree.add("a", "b"));
+    REQUIRE(tree.add("a", "c"));
+    REQUIRE(tree.add("b", "d"));
+    REQUIRE(tree.add("c", "d"));
+    REQUIRE(tree.add("a", "d"));
+    REQUIRE(tree.add("a", "d"));
+
+    using Layers = std::vector<std::vector<std::string>>;
+    REQUIRE(tree.getDependenceLayer("a") == Layers{{"b", "c"}, {"d"}});
+    REQUIRE(tree.getDependenceLayer("b") == Layers{{"d"}});
+    REQUIRE(tree.getDependenceLayer("d").empty());
+    REQUIRE(tree.getDependings("a") ==
+            std::vector<std::string>{"b", "c", "d"});
+
+    REQUIRE_FALSE(tree.add("d", "a"));
+    REQUIRE_FALSE(tree.add("d", "d"));
+
+    // Counted edges.
+    tree.del("a", "d");
+    REQUIRE(tree.getDependings("a") ==
+            std::vector<std::string>{"b", "c", "d"});
+    tree.del("b", "d");
+    tree.del("c", "d");
+    tree.del("a", "d");
+    REQUIRE(tree.getDependenceLayer("a") == Layers{{"b", "c"}});
+    REQUIRE(tree.isIndependent("b"));
+    REQUIRE(tree.add("d", "a"));
+    REQUIRE(tree.getDependenceLayer("d") == Layers{{"a"}, {"b", "c"}});
+    tree.del("x", "y");
+
+    // Ladder of shared dependencies.
+    DependenceTree ladder;
+    const int n = 200;
+    for (int i = 0; i + 1 < n; i++) {
+        std::string p = "p" + std::to_string(i), q = "q" + std::to_string(i);
+        std::string next_p = "p" + std::to_string(i + 1);
+        std::string next_q = "q" + std::to_string(i + 1);
+        REQUIRE(ladder.add(p, next_p));
+        REQUIRE(ladder.add(p, next_q));
+        REQUIRE(ladder.add(q, next_p));
+        REQUIRE(ladder.add(q, next_q));
+    }
+    REQUIRE_FALSE(ladder.add("p" + std::to_string(n - 1), "q0"));
+    auto layers = ladder.getDependenceLayer("p0");
+    REQUIRE(layers.size() == n - 1);
+    for (auto& layer : layers) {
+        REQUIRE(layer.size() == 2);
+    }
+}
+
+TEST_CASE("Core Manager batch test") {
+    CoreManager cm;
+    auto univ_sq = UnivFuncGenerator<void(const int&, int&)>::Gen(
+            []() -> std::function<void(const int&, int&)> { return Square; });
+    std::deque<Variable> default_args = {std::make_unique<int>(4),
+                                         std::make_unique<int>(0)};
+    REQUIRE(cm.addUnivFunc(univ_sq, "square", std::move(default_args),
+                           {{"in", "dst"},
+                            {typeid(int), typeid(int)},
+                            {true, false},
+                            FOGtype::Pure,
+                            "",
+                            {},
+                            "",
+                            "dst := in * in"}));
+    const std::string kINPUT = fase::InputNodeName();
+    const std::string kOUTPUT = fase::OutputNodeName();
+
+    auto& pipe = cm["Batch"];
+    cm["Other"];
+    pipe.beginBatch();
+    REQUIRE(pipe.supposeInput({"in"}));
+    REQUIRE(pipe.supposeOutput({"dst"}));
+    REQUIRE(pipe.newNode("a"));
+    REQUIRE(pipe.newNode("b"));
+    REQUIRE(pipe.allocateFunc("square", "a"));
+    REQUIRE(pipe.allocateFunc("square", "b"));
+    REQUIRE(LinkNodeError::None == pipe.smartLink(kINPUT, 0, "a", 0));
+    REQUIRE(LinkNodeError::None == pipe.smartLink("a", 1, "b", 0));
+    REQUIRE(LinkNodeError::None == pipe.smartLink("b", 1, kOUTPUT, 0));
+    // Staged links are made at commit().
+    REQUIRE(pipe.getLinks().empty());
+    // Other pipelines see the inputs and outputs at commit().
+    REQUIRE(cm.getFunctionUtils("Other")["Batch"].arg_names.empty());
+    REQUIRE(pipe.commit());
+    REQUIRE(pipe.getLinks().size() == 3);
+    REQUIRE(cm.getFunctionUtils("Other")["Batch"].arg_names ==
+            std::vector<std::string>{"in", "dst"});
+
+    int in = 3, dst = 0;
+    std::deque<Variable> vs;
+    Assign(vs, &in, &dst);
+    REQUIRE(pipe.call(vs));
+    REQUIRE(dst == 81);
+
+    // A loop is not made.
+    pipe.beginBatch();
+    REQUIRE(LinkNodeError::None == pipe.smartLink("b", 1, "a", 0));
+    REQUIRE_FALSE(pipe.commit());
+    REQUIRE(pipe.getLinks().size() == 3);
+
+    // Invalid links are dropped, and the others are made.
+    pipe.beginBatch();
+    pipe.beginBatch();
+    REQUIRE(pipe.unlinkNode("a", 0));
+    REQUIRE(LinkNodeError::None == pipe.smartLink("none", 0, "b", 0));
+    REQUIRE(pipe.commit());
+    REQUIRE(LinkNodeError::None == pipe.smartLink(kINPUT, 0, "a", 0));
+    REQUIRE_FALSE(pipe.commit());
+    REQUIRE(pipe.getLinks().size() == 3);
+    REQUIRE_FALSE(pipe.commit());
+
+    // Links of other types or out of the arguments are skipped one by one.
+    auto univ_half = UnivFuncGenerator<void(const int&, float&)>::Gen(
+            []() -> std::function<void(const int&, float&)> {
+                return [](const int& in, float& dst) { dst = in / 2.f; };
+            });
+    REQUIRE(cm.addUnivFunc(univ_half, "half",
+                           {std::make_unique<int>(0),
+                            std::make_unique<float>(0.f)},
+                           {{"in", "dst"},
+                            {typeid(int), typeid(float)},
+                            {true, false},
+                            FOGtype::Pure,
+                            "",
+                            {},
+                            "",
+                            ""}));
+    REQUIRE(pipe.newNode("h"));
+    REQUIRE(pipe.allocateFunc("half", "h"));
+    pipe.beginBatch();
+    REQUIRE(LinkNodeError::None == pipe.smartLink("h", 1, "b", 0));
+    REQUIRE(LinkNodeError::None == pipe.smartLink("h", 0, "a", 3));
+    REQUIRE(LinkNodeError::None == pipe.smartLink(kINPUT, 0, "h", 0));
+    REQUIRE_FALSE(pipe.commit());
+    REQUIRE(pipe.getLinks().size() == 4);
+
+    // An input typed by a link breaks other links from it, as smartLink().
+    auto univ_twice = UnivFuncGenerator<void(const float&, float&)>::Gen(
+            []() -> std::function<void(const float&, float&)> {
+                return [](const float& in, float& dst) { dst = in * 2.f; };
+            });
+    REQUIRE(cm.addUnivFunc(univ_twice, "twice",
+                           {std::make_unique<float>(0.f),
+                            std::make_unique<float>(0.f)},
+                           {{"in", "dst"},
+                            {typeid(float), typeid(float)},
+                            {true, false},
+                            FOGtype::Pure,
+                            "",
+                            {},
+                            "",
+                            ""}));
+    REQUIRE(pipe.newNode("t"));
+    REQUIRE(pipe.allocateFunc("twice", "t"));
+    pipe.beginBatch();
+    REQUIRE(LinkNodeError::None == pipe.smartLink(kINPUT, 0, "t", 0));
+    REQUIRE(LinkNodeError::None == pipe.smartLink("t", 1, kOUTPUT, 0));
+    REQUIRE(pipe.commit());
+    // Input -> a and Input -> h are broken, and b -> Output is replaced.
+    REQUIRE(pipe.getLinks().size() == 3);
+    float f_in = 4.f, f_dst = 0.f;
+    vs.clear();
+    Assign(vs, &f_in, &f_dst);
+    REQUIRE(pipe.call(vs));
+    REQUIRE(f_dst == 8.f);
+}
+
+TEST_CASE("Core Manager journal test") {
+    TempDir temp_dir("fase_journal_test");
+    const std::string& dir = temp_dir.path;
+    TSCMap converters;
+    SetupTypeConverters(&converters);
+
+    auto add_square = [](CoreManager* pcm) {
+        auto univ_sq = UnivFuncGenerator<void(const int&, int&)>::Gen(
+                []() -> std::function<void(const int&, int&)> {
+                    return Square;
+                });
+        std::deque<Variable> default_args = {std::make_unique<int>(4),
+                                             std::make_unique<int>(0)};
+        REQUIRE(pcm->addUnivFunc(univ_sq, "square", std::move(default_args),
+                                 {{"in", "dst"},
+                                  {typeid(int), typeid(int)},
+                                  {true, false},
+                                  FOGtype::Pure,
+                                  "",
+                                  {},
+                                  "",
+                                  ""}));
+    };
+    auto require_same = [](const CoreManager& a, const CoreManager& b) {
+        REQUIRE(a.getPipelineNames() == b.getPipelineNames());
+        for (auto& p_name : a.getPipelineNames()) {
+            auto& a_nodes = a[p_name].getNodes();
+            auto& b_nodes = b[p_name].getNodes();
+            REQUIRE(a_nodes.size() == b_nodes.size());
+            for (auto& [n_name, node] : a_nodes) {
+                REQUIRE(b_nodes.count(n_name));
+                REQUIRE(node.func_name == b_nodes.at(n_name).func_name);
+                REQUIRE(node.priority == b_nodes.at(n_name).priority);
+                auto& b_args = b_nodes.at(n_name).args;
+                REQUIRE(node.args.size() == b_args.size());
+                for (size_t i = 0; i < node.args.size(); i++) {
+                    REQUIRE(node.args[i].isSameType(b_args[i]));
+                    if (node.args[i].isSameType<int>() && node.args[i]) {
+                        REQUIRE(*node.args[i].getReader<int>() ==
+                                *b_args[i].getReader<int>());
+                    }
+                }
+            }
+            REQUIRE(a[p_name].getLinks().size() ==
+                    b[p_name].getLinks().size());
+        }
+    };
+    auto recover = [&](EditJournal* journal) {
+        CoreManager dst;
+        add_square(&dst);
+        REQUIRE(journal->recover(&dst));
+        return dst;
+    };
+
+    CoreManager cm;
+    add_square(&cm);
+    auto journal = std::make_shared<EditJournal>(dir, converters);
+    REQUIRE(journal->recover(&cm));
+    cm.setJournal(journal);
+
+    auto& sub = cm["Sub"];
+    REQUIRE(sub.supposeInput({"x"}));
+    REQUIRE(sub.supposeOutput({"y"}));
+    sub.beginBatch();
+    REQUIRE(sub.newNode("a"));
+    REQUIRE(sub.newNode("b"));
+    REQUIRE(sub.allocateFunc("square", "a"));
+    REQUIRE(sub.allocateFunc("square", "b"));
+    REQUIRE(sub.smartLink(InputNodeName(), 0, "a", 0) == LinkNodeError::None);
+    REQUIRE(sub.smartLink("a", 1, "b", 0) == LinkNodeError::None);
+    REQUIRE(sub.smartLink("b", 1, OutputNodeName(), 0) ==
+            LinkNodeError::None);
+    REQUIRE(sub.commit());
+    REQUIRE(sub.renameNode("b", "c"));
+    REQUIRE(sub.setPriority("c", 3));
+
+    auto& main = cm["Main"];
+    REQUIRE(main.newNode("s"));
+    REQUIRE(main.newNode("t"));
+    REQUIRE(main.allocateFunc("Sub", "s"));
+    Variable five = std::make_unique<int>(5);
+    REQUIRE(main.setArgument("s", 0, five));
+    REQUIRE(main.delNode("t"));
+    REQUIRE(journal->getLogBytes() > 0);
+
+    CoreManager recovered = recover(journal.get());
+    require_same(cm, recovered);
+    REQUIRE(recovered["Main"].run());
+    REQUIRE(*recovered["Main"].getNodes().at("s").args[1].getReader<int>() ==
+            625);
+
+    // A record torn by a crash is dropped.
+    {
+        std::ofstream ofs(dir + "/" + kJournalLogFile,
+                          std::ios::binary | std::ios::app);
+        ofs << "\x20\0\0\0garbage";
+    }
+    recovered = recover(journal.get());
+    require_same(cm, recovered);
+    REQUIRE(main.unlinkNode(OutputNodeName(), 0) == false);
+    REQUIRE(main.setPriority("s", 1));
+    require_same(cm, recover(journal.get()));
+
+    // The log is compacted into the snapshot when it grows.
+    journal = std::make_shared<EditJournal>(dir, converters, 64);
+    cm.setJournal(journal);
+    REQUIRE(main.newNode("u"));
+    REQUIRE(journal->getLogBytes() == 0);
+    REQUIRE(std::filesystem::exists(dir + "/" + kJournalSnapshotFile));
+    REQUIRE(main.allocateFunc("square", "u"));
+    REQUIRE(journal->getLogBytes() > 0);
+    require_same(cm, recover(journal.get()));
+
+    // Copies do not record.
+    CoreManager copied = cm;
+    const size_t log_bytes = journal->getLogBytes();
+    REQUIRE(copied["Main"].newNode("v"));
+    REQUIRE(journal->getLogBytes() == log_bytes);
+
+    // Assigned pipelines are saved at once.
+    cm = copied;
+    REQUIRE(journal->getLogBytes() == 0);
+    require_same(cm, recover(journal.get()));
+    REQUIRE(recover(journal.get())["Main"].getNodes().count("v"));
+    REQUIRE(cm["Main"].newNode("w"));
+    require_same(cm, recover(journal.get()));
+}
@@ -3,6 +3,15 @@
 #include <fase2/fase.h>
 #include <fase2/stdparts.h>
 
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+
 using namespace fase;
 
 namespace {
@@ -19,12 +28,52 @@ void Square(const int& in, int& dst) {
     dst = in * in;
 })
 
+FaseAutoAddingUnivFunction(Concat,
+std::string Concat(std::string a, const std::string& b) {
+    return a + b;
+})
+
+struct Point {
+    int x = 0, y = 0;
+};
+
+FaseAutoAddingUnivFunction(PointSum,
+void PointSum(const Point& p, int& dst) {
+    dst = p.x + p.y;
+})
+
+FaseAutoAddingUnivFunction(SumFloats,
+void SumFloats(const std::vector<float>& v, float& dst) {
+    dst = 0.f;
+    for (float x : v) dst += x;
+})
+
 int Times(const int& a, const int& b) {
     return a * b;
 }
 
 // clang-format on
 
+// Directory under the temporary directory, removed at the end of the scope.
+// The name is made unique, so that parallel runs do not share it.
+class TempDir {
+public:
+    explicit TempDir(const std::string& name)
+        : path((std::filesystem::temp_directory_path() /
+                (name + "-" + std::to_string(std::random_device()())))
+                       .string()) {
+        std::filesystem::create_directories(path);
+    }
+    ~TempDir() {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    const std::string path;
+};
+
 } // namespace
 
 class BareCore : public PartsBase {
@@ -32,6 +81,9 @@ public:
     auto getCoreManager() {
         return getAPI()->getWriter();
     }
+    const TSCMap& getConverters() {
+        return getAPI()->getConverterMap();
+    }
 };
 
 TEST_CASE("Fase test") {
@@ -46,3 +98,539 @@ TEST_CASE("Fase test") {
     REQUIRE(cm["test"].allocateFunc("Square", "a"));
     REQUIRE(cm["test"].allocateFunc("Times", "a"));
 }
+
+TEST_CASE("Hard call test") {
+    Fase<BareCore, ExportableParts, HardCallableParts<int>> app;
+    FaseAddUnivFunction(Times, int(const int&, const int&), ("a", "b"), app,
+                        "dst = a * b", {1, 1});
+    {
+        auto [guard, pcm] = app.getCoreManager();
+        auto& cm = *pcm;
+        cm.setFocusedPipeline("test");
+        REQUIRE(cm["test"].supposeInput({"a", "b"}));
+        REQUIRE(cm["test"].supposeOutput({"dst"}));
+        REQUIRE(cm["test"].newNode("t"));
+        REQUIRE(cm["test"].allocateFunc("Times", "t"));
+        REQUIRE(LinkNodeError::None ==
+                cm["test"].smartLink(InputNodeName(), 0, "t", 0));
+        REQUIRE(LinkNodeError::None ==
+                cm["test"].smartLink(InputNodeName(), 1, "t", 1));
+        REQUIRE(LinkNodeError::None ==
+                cm["test"].smartLink("t", 2, OutputNodeName(), 0));
+    }
+
+    // typed slots are reused between calls.
+    for (int i = 0; i < 3; i++) {
+        auto [dst] = app.callHard(i, 4);
+        REQUIRE(dst == i * 4);
+    }
+
+    // and are not broken by calls from other threads, nor by edits while
+    // calling.
+    std::vector<std::thread> threads;
+    std::atomic<int> n_wrong{0};
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 200; i++) {
+                auto [dst] = app.callHard(i, t);
+                if (dst != i * t) n_wrong++;
+            }
+        });
+    }
+    for (int i = 0; i < 20; i++) {
+        auto [guard, pcm] = app.getCoreManager();
+        REQUIRE((*pcm)["test"].setPriority("t", i));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(n_wrong == 0);
+
+    auto hard = ToHard<int>::Pipe<int, int>::Gen(app.exportPipe());
+    for (int i = 0; i < 3; i++) {
+        auto [dst] = hard(i, 5);
+        REQUIRE(dst == i * 5);
+    }
+    REQUIRE_THROWS(ToHard<float>::Pipe<int, int>::Gen(app.exportPipe())(1, 2));
+
+    // Calls after an edit run the edited pipeline.
+    {
+        auto [guard, pcm] = app.getCoreManager();
+        REQUIRE(LinkNodeError::None ==
+                (*pcm)["test"].smartLink(InputNodeName(), 0, "t", 1));
+    }
+    {
+        auto [dst] = app.callHard(3, 4);
+        REQUIRE(dst == 9);
+    }
+}
+
+TEST_CASE("Native compile test") {
+    Fase<BareCore, ExportableParts> app;
+    {
+        auto [guard, pcm] = app.getCoreManager();
+        auto& cm = *pcm;
+        cm.setFocusedPipeline("native");
+        REQUIRE(cm["native"].supposeInput({"in"}));
+        REQUIRE(cm["native"].supposeOutput({"dst"}));
+        Variable v = std::make_unique<int>(0);
+        REQUIRE(cm["native"].setArgument(InputNodeName(), 0, v));
+        REQUIRE(cm["native"].setArgument(OutputNodeName(), 0, v));
+        REQUIRE(LinkNodeError::None ==
+                cm["native"].smartLink(InputNodeName(), 0, OutputNodeName(), 0));
+    }
+
+    TempDir cache_dir("fase_native_cache_test");
+    NativeCompileOptions options;
+    options.cache_dir = cache_dir.path;
+    auto exported = app.exportNativePipe("", options);
+    REQUIRE(exported.waitNative());
+
+    int input = 3, result = 0;
+    std::deque<Variable> vs;
+    Assign(vs, &input, &result);
+    REQUIRE(exported(vs));
+    REQUIRE(result == 3);
+
+    // ToHard gives the outputs as empty values.
+    auto hard = ToHard<int>::Pipe<int>::Gen(exported);
+    auto [dst] = hard(7);
+    REQUIRE(dst == 7);
+}
+
+TEST_CASE("Native code generation test") {
+    Fase<BareCore, CodegenParts> app;
+    {
+        auto [guard, pcm] = app.getCoreManager();
+        auto& cm = *pcm;
+        REQUIRE(cm["gen"].supposeInput({"in"}));
+        REQUIRE(cm["gen"].supposeOutput({"dst", "sub"}));
+        REQUIRE(cm["gen"].newNode("c1"));
+        REQUIRE(cm["gen"].newNode("c2"));
+        REQUIRE(cm["gen"].newNode("c3"));
+        REQUIRE(cm["gen"].allocateFunc("Concat", "c1"));
+        REQUIRE(cm["gen"].allocateFunc("Concat", "c2"));
+        REQUIRE(cm["gen"].allocateFunc("Concat", "c3"));
+        REQUIRE(LinkNodeError::None ==
+                cm["gen"].smartLink(InputNodeName(), 0, "c1", 0));
+        REQUIRE(LinkNodeError::None == cm["gen"].smartLink("c1", 2, "c2", 0));
+        REQUIRE(LinkNodeError::None == cm["gen"].smartLink("c2", 2, "c3", 0));
+        REQUIRE(LinkNodeError::None ==
+                cm["gen"].smartLink("c3", 2, OutputNodeName(), 0));
+        REQUIRE(LinkNodeError::None ==
+                cm["gen"].smartLink("c2", 2, OutputNodeName(), 1));
+    }
+    std::string code = app.genNativeCode("gen", "Gen");
+    INFO(code);
+    // Const inputs are not moved.
+    REQUIRE(code.find("Concat(in, ") != std::string::npos);
+    // Moved at the last use.
+    REQUIRE(code.find("Concat(std::move(c1_ret), ") != std::string::npos);
+    // Outputs are constructed in place, and not moved.
+    REQUIRE(code.find("std::string& c2_ret = sub;") != std::string::npos);
+    REQUIRE(code.find("Concat(c2_ret, ") != std::string::npos);
+    REQUIRE(code.find("std::string& c3_ret = dst;") != std::string::npos);
+    REQUIRE(code.find("dst = ") == std::string::npos);
+}
+
+TEST_CASE("Parallel native code test") {
+    Fase<BareCore, ExportableParts, CodegenParts> app;
+    FaseAddUnivFunction(Times, int(const int&, const int&), ("a", "b"), app,
+                        "dst = a * b", {1, 1});
+    Report report;
+    {
+        auto [guard, pcm] = app.getCoreManager();
+        auto& cm = *pcm;
+        cm.setFocusedPipeline("par");
+        REQUIRE(cm["par"].supposeInput({"a", "b"}));
+        REQUIRE(cm["par"].supposeOutput({"dst"}));
+        for (auto n_name : {"t1", "t2", "t3"}) {
+            REQUIRE(cm["par"].newNode(n_name));
+            REQUIRE(cm["par"].allocateFunc("Times", n_name));
+            REQUIRE(LinkNodeError::None ==
+                    cm["par"].smartLink(InputNodeName(), 0, n_name, 0));
+        }
+        REQUIRE(LinkNodeError::None ==
+                cm["par"].smartLink(InputNodeName(), 1, "t1", 1));
+        REQUIRE(LinkNodeError::None ==
+                cm["par"].smartLink(InputNodeName(), 0, "t2", 1));
+        REQUIRE(cm["par"].newNode("add"));
+        REQUIRE(cm["par"].allocateFunc("Add", "add"));
+        REQUIRE(LinkNodeError::None == cm["par"].smartLink("t1", 2, "add", 0));
+        REQUIRE(LinkNodeError::None == cm["par"].smartLink("t2", 2, "add", 1));
+        REQUIRE(LinkNodeError::None ==
+                cm["par"].smartLink("add", 2, OutputNodeName(), 0));
+        REQUIRE(cm["par"].run(&report));
+    }
+
+    NativeCodeOptions code_options;
+    code_options.parallel = true;
+    code_options.parallel_threshold = std::chrono::hours(1);
+    code_options.profile = &report;
+    // All nodes are cheap, and run inline.
+    REQUIRE(app.genNativeCode("par", "Par", code_options).find("std::async") ==
+            std::string::npos);
+    report.child_reports["t1"].execution_time = std::chrono::hours(2);
+    report.child_reports["t2"].execution_time = std::chrono::hours(2);
+    // One of costly nodes runs inline.
+    std::string code = app.genNativeCode("par", "Par", code_options);
+    INFO(code);
+    REQUIRE(code.find("t1_task = std::async(") != std::string::npos);
+    REQUIRE(code.find("t2_task") == std::string::npos);
+    REQUIRE(code.find("int t1_ret = t1_task.get();") != std::string::npos);
+
+    TempDir cache_dir("fase_native_cache_test");
+    NativeCompileOptions options;
+    options.cache_dir = cache_dir.path;
+    options.code.parallel = true;
+    auto exported = app.exportNativePipe(
+            "int Times(const int& a, const int& b) { return a * b; }\n"
+            "void Add(const int& a, const int& b, int& dst) { dst = a + b; }",
+            options);
+    REQUIRE(exported.waitNative());
+
+    int a = 3, b = 4, result = 0;
+    std::deque<Variable> vs;
+    Assign(vs, &a, &b, &result);
+    REQUIRE(exported(vs));
+    REQUIRE(result == a * b + a * a);
+}
+
+TEST_CASE("Native benchmark test") {
+    Fase<BareCore, CodegenParts> app;
+    FaseAddUnivFunction(Times, int(const int&, const int&), ("a", "b"), app,
+                        "dst = a * b", {1, 1});
+    Report report;
+    {
+        auto [guard, pcm] = app.getCoreManager();
+        auto& cm = *pcm;
+        REQUIRE(cm["bench"].supposeInput({"a", "b"}));
+        REQUIRE(cm["bench"].supposeOutput({"dst"}));
+        Variable v = std::make_unique<int>(3);
+        REQUIRE(cm["bench"].setArgument(InputNodeName(), 0, v));
+        REQUIRE(cm["bench"].newNode("t"));
+        REQUIRE(cm["bench"].allocateFunc("Times", "t"));
+        REQUIRE(LinkNodeError::None ==
+                cm["bench"].smartLink(InputNodeName(), 0, "t", 0));
+        REQUIRE(LinkNodeError::None ==
+                cm["bench"].smartLink(InputNodeName(), 1, "t", 1));
+        REQUIRE(LinkNodeError::None ==
+                cm["bench"].smartLink("t", 2, OutputNodeName(), 0));
+        REQUIRE(cm["bench"].run(&report));
+    }
+
+    // Report is saved as JSON.
+    Report loaded;
+    REQUIRE(LoadReportFromString(ReportToString(report), &loaded));
+    REQUIRE(loaded.child_reports.count("t"));
+    REQUIRE(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    loaded.execution_time) ==
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    report.execution_time));
+
+    TempDir dir("fase_bench_test");
+    const std::string src = dir.path + "/bench.cpp";
+    const std::string bin = dir.path + "/bench";
+    auto run_benchmark = [&](bool per_node) {
+        NativeCodeOptions options;
+        options.timing = per_node;
+        std::string code = app.genBenchmarkCode(
+                "bench", "Bench",
+                "#include <array>\n#include <atomic>\n#include <chrono>\n"
+                "#include <functional>\n#include <string>\n"
+                "int Times(const int& a, const int& b) { return a * b; }\n" +
+                        app.genNativeCode("bench", "Bench", options),
+                per_node);
+        REQUIRE(code.find("int a = 3;") != std::string::npos);
+        {
+            std::ofstream ofs(src);
+            ofs << code;
+        }
+        REQUIRE(std::system(("c++ -std=c++17 -o " + bin + " " + src).c_str()) ==
+                0);
+        FILE* pipe = popen((bin + " 10").c_str(), "r");
+        REQUIRE(pipe != nullptr);
+        std::string output;
+        char buf[256];
+        while (fgets(buf, sizeof(buf), pipe) != nullptr) {
+            output += buf;
+        }
+        REQUIRE(pclose(pipe) == 0);
+        REQUIRE(LoadReportFromString(output, &loaded));
+    };
+
+    run_benchmark(false);
+    REQUIRE(loaded.child_reports.empty());
+
+    // Nodes are measured in the generated class.
+    run_benchmark(true);
+    REQUIRE(loaded.child_reports.size() == 1);
+    REQUIRE(loaded.child_reports.count("t"));
+}
+
+TEST_CASE("Binary pipeline test") {
+    Fase<BareCore, CodegenParts> app;
+    {
+        auto [guard, pcm] = app.getCoreManager();
+        auto& cm = *pcm;
+        REQUIRE(cm["sq"].supposeInput({"in"}));
+        REQUIRE(cm["sq"].supposeOutput({"dst"}));
+        REQUIRE(cm["sq"].newNode("s"));
+        REQUIRE(cm["sq"].allocateFunc("Square", "s"));
+        REQUIRE(LinkNodeError::None ==
+                cm["sq"].smartLink(InputNodeName(), 0, "s", 0));
+        REQUIRE(LinkNodeError::None ==
+                cm["sq"].smartLink("s", 1, OutputNodeName(), 0));
+
+        REQUIRE(cm["bin"].supposeInput({"a"}));
+        REQUIRE(cm["bin"].supposeOutput({"dst"}));
+        REQUIRE(cm["bin"].newNode("add"));
+        REQUIRE(cm["bin"].newNode("sq1"));
+        REQUIRE(cm["bin"].allocateFunc("Add", "add"));
+        REQUIRE(cm["bin"].allocateFunc("sq", "sq1"));
+        REQUIRE(cm["bin"].setPriority("sq1", 2));
+        Variable b = std::make_unique<int>(5);
+        REQUIRE(cm["bin"].setArgument("add", 1, b));
+        REQUIRE(LinkNodeError::None ==
+                cm["bin"].smartLink(InputNodeName(), 0, "add", 0));
+        REQUIRE(LinkNodeError::None == cm["bin"].smartLink("add", 2, "sq1", 0));
+        REQUIRE(LinkNodeError::None ==
+                cm["bin"].smartLink("sq1", 1, OutputNodeName(), 0));
+        REQUIRE(SavePipeline("bin", cm, "fase_bin_test.fpb",
+                             app.getConverters()));
+    }
+
+    Fase<BareCore, CodegenParts> loaded;
+    REQUIRE(loaded.loadPipeline("fase_bin_test.fpb"));
+    auto [guard, pcm] = loaded.getCoreManager();
+    auto& cm = *pcm;
+    REQUIRE(cm["bin"].getNodes().size() == 4);
+    REQUIRE(cm["bin"].getLinks().size() == 3);
+    REQUIRE(cm["bin"].getNodes().at("sq1").priority == 2);
+    REQUIRE(*cm["bin"].getNodes().at("add").args[1].getReader<int>() == 5);
+    REQUIRE(cm.getDependingTree().getDependings("bin") ==
+            std::vector<std::string>{"sq"});
+
+    int a = 2, dst = 0;
+    std::deque<Variable> vs;
+    Assign(vs, &a, &dst);
+    REQUIRE(cm["bin"].call(vs));
+    REQUIRE(dst == 49);
+
+    // Broken data is rejected.
+    std::string data = PipelineToBinary("bin", cm, loaded.getConverters());
+    CoreManager empty;
+    REQUIRE_FALSE(LoadPipelineFromBinary(data.data(), data.size() / 2, &empty,
+                                         loaded.getConverters()));
+    std::remove("fase_bin_test.fpb");
+}
+
+TEST_CASE("JSON pipeline test") {
+    Fase<BareCore> app;
+    {
+        auto [guard, pcm] = app.getCoreManager();
+        auto& cm = *pcm;
+        REQUIRE(cm["json"].supposeInput({"a"}));
+        REQUIRE(cm["json"].supposeOutput({"dst"}));
+        REQUIRE(cm["json"].newNode("c"));
+        REQUIRE(cm["json"].allocateFunc("Concat", "c"));
+        Variable b = std::make_unique<std::string>("\"b\"\n\t\\\xe2\x80\xa8");
+        REQUIRE(cm["json"].setArgument("c", 1, b));
+        REQUIRE(LinkNodeError::None ==
+                cm["json"].smartLink(InputNodeName(), 0, "c", 0));
+        REQUIRE(LinkNodeError::None ==
+                cm["json"].smartLink("c", 2, OutputNodeName(), 0));
+    }
+
+    auto check = [](CoreManager& cm, const std::string& p_name,
+                    const std::string& expected) {
+        std::string a = "a", dst;
+        std::deque<Variable> vs;
+        Assign(vs, &a, &dst);
+        REQUIRE(cm[p_name].call(vs));
+        REQUIRE(dst == expected);
+    };
+
+    std::string json;
+    {
+        auto [guard, pcm] = app.getCoreManager();
+        json = PipelineToString("json", *pcm, app.getConverters());
+    }
+    Fase<BareCore> loaded;
+    auto [guard, pcm] = loaded.getCoreManager();
+    REQUIRE(LoadPipelineFromString(json, pcm.get(), loaded.getConverters()));
+    REQUIRE(PipelineToString("json", *pcm, loaded.getConverters()) == json);
+    check(*pcm, "json", "a\"b\"\n\t\\\xe2\x80\xa8");
+
+    // Files written by json11 have the keys sorted.
+    const std::string sorted = R"([{"content": {
+        "Inputs": [{"name": "a", "type": "std::string", "value": ""}],
+        "Links": [
+          {"dst_arg": "a", "dst_node": "c",
+           "src_arg": "a", "src_node": "Input"},
+          {"dst_arg": "dst", "dst_node": "Output",
+           "src_arg": "[[returned]]", "src_node": "c"}],
+        "Nodes": {"c": {"args": [
+            {"name": "b", "type": "std::string",
+             "value": "\u00e9\ud83d\ude00"}],
+          "func_name": "Concat", "priority": 0, "side_effect": false}},
+        "Outputs": [{"name": "dst", "type": "std::string", "value": ""}]},
+      "pipeline_name": "sorted"}])";
+    REQUIRE(LoadPipelineFromString(sorted, pcm.get(), loaded.getConverters()));
+    check(*pcm, "sorted", "a\xc3\xa9\xf0\x9f\x98\x80");
+
+    REQUIRE_FALSE(LoadPipelineFromString(json.substr(0, json.size() / 2),
+                                         pcm.get(), loaded.getConverters()));
+}
+
+TEST_CASE("Type converter test") {
+    Fase<BareCore> app;
+    const TSCMap& tscs = app.getConverters();
+
+    auto round_trip = [&](auto v) {
+        using T = decltype(v);
+        Variable var = std::make_unique<T>(v), dst;
+        std::string str = tscs.at(typeid(T)).serializer(var);
+        tscs.at(typeid(T)).deserializer(dst, str);
+        REQUIRE(*dst.getReader<T>() == v);
+        return str;
+    };
+    // Floats are written in the shortest form, without losing precision.
+    REQUIRE(round_trip(0.1f) == "0.1");
+    REQUIRE(round_trip(1.0 / 3.0) == "0.3333333333333333");
+    REQUIRE(round_trip(-1234567) == "-1234567");
+    REQUIRE(round_trip(true) == "1");
+    REQUIRE(round_trip(std::uint64_t(1) << 63) == "9223372036854775808");
+    round_trip(1e300L);
+
+    Variable dst;
+    REQUIRE_THROWS(tscs.at(typeid(int)).deserializer(dst, "x"));
+
+    // Appended to the buffer.
+    std::string buf = "a=";
+    Variable var = std::make_unique<double>(2.5);
+    tscs.at(typeid(double)).serializeTo(var, &buf);
+    REQUIRE(buf == "a=2.5");
+}
+
+TEST_CASE("Binary IO test") {
+    Fase<BareCore, CodegenParts> app;
+    auto register_point = [](auto& a) {
+        FaseRegisterBinaryIO(
+                a, Point,
+                [](const Point& p, std::string* dst) {
+                    dst->append(reinterpret_cast<const char*>(&p), sizeof(p));
+                },
+                [](std::string_view bytes) {
+                    if (bytes.size() != sizeof(Point)) {
+                        throw std::invalid_argument("broken Point");
+                    }
+                    Point p;
+                    std::memcpy(&p, bytes.data(), sizeof(p));
+                    return p;
+                });
+    };
+    register_point(app);
+    const TSCMap& tscs = app.getConverters();
+
+    // Numbers are written as little-endian bytes.
+    std::string bytes;
+    Variable var = std::make_unique<int>(258), dst;
+    tscs.at(typeid(int)).encoder(var, &bytes);
+    REQUIRE(bytes == std::string("\x02\x01\0\0", 4));
+    tscs.at(typeid(int)).decoder(dst, bytes);
+    REQUIRE(*dst.getReader<int>() == 258);
+    REQUIRE_THROWS(tscs.at(typeid(int)).decoder(dst, "\x02"));
+
+    // std::vector of numbers.
+    using Floats = std::vector<float>;
+    auto& vec_tsc = tscs.at(typeid(Floats));
+    var = std::make_unique<Floats>(Floats{1.f, 2.5f, -0.1f});
+    REQUIRE(vec_tsc.name == "std::vector<float>");
+    REQUIRE(vec_tsc.serializer(var) == "1 2.5 -0.1");
+    REQUIRE(vec_tsc.def_maker(var) == "{1, 2.5, -0.1}");
+    vec_tsc.deserializer(dst, " 1 2.5  -0.1");
+    REQUIRE(*dst.getReader<Floats>() == *var.getReader<Floats>());
+    bytes.clear();
+    vec_tsc.encoder(var, &bytes);
+    REQUIRE(bytes.size() == 3 * sizeof(float));
+    vec_tsc.decoder(dst, bytes);
+    REQUIRE(*dst.getReader<Floats>() == *var.getReader<Floats>());
+
+    // A type which has only the binary codec.
+    {
+        auto [guard, pcm] = app.getCoreManager();
+        auto& cm = *pcm;
+        REQUIRE(cm["pt"].supposeOutput({"dst"}));
+        REQUIRE(cm["pt"].newNode("s"));
+        REQUIRE(cm["pt"].allocateFunc("PointSum", "s"));
+        Variable p = std::make_unique<Point>(Point{3, 4});
+        REQUIRE(cm["pt"].setArgument("s", 0, p));
+        REQUIRE(LinkNodeError::None ==
+                cm["pt"].smartLink("s", 1, OutputNodeName(), 0));
+        REQUIRE(SavePipeline("pt", cm, "fase_bin_io_test.fpb",
+                             app.getConverters()));
+        REQUIRE(SavePipeline("pt", cm, "fase_bin_io_test.json",
+                             app.getConverters()));
+    }
+
+    // Also in JSON, as base64.
+    for (auto& filename : {"fase_bin_io_test.fpb", "fase_bin_io_test.json"}) {
+        Fase<BareCore, CodegenParts> loaded;
+        register_point(loaded);
+        REQUIRE(loaded.loadPipeline(filename));
+        auto [guard, pcm] = loaded.getCoreManager();
+        int sum = 0;
+        std::deque<Variable> vs;
+        Assign(vs, &sum);
+        REQUIRE((*pcm)["pt"].call(vs));
+        REQUIRE(sum == 7);
+        std::remove(filename);
+    }
+}
+
+TEST_CASE("Bulk argument test") {
+    Fase<BareCore> app;
+    std::vector<float> kernel(10000);
+    for (size_t i = 0; i < kernel.size(); i++) {
+        kernel[i] = float(i) / 7.f;
+    }
+    std::string json;
+    {
+        auto [guard, pcm] = app.getCoreManager();
+        auto& cm = *pcm;
+        REQUIRE(cm["bulk"].supposeOutput({"dst"}));
+        REQUIRE(cm["bulk"].newNode("s"));
+        REQUIRE(cm["bulk"].allocateFunc("SumFloats", "s"));
+        Variable v = std::make_unique<std::vector<float>>(kernel);
+        REQUIRE(cm["bulk"].setArgument("s", 0, v));
+        REQUIRE(LinkNodeError::None ==
+                cm["bulk"].smartLink("s", 1, OutputNodeName(), 0));
+        PipelineToJson("bulk", cm, app.getConverters(), &json);
+    }
+    REQUIRE(json.find(R"("type": "std::vector<float>", "encoding": "base64", )"
+                      R"("size": 40000, "value": ")") != std::string::npos);
+    REQUIRE(json.size() < 60000);
+
+    auto load = [&](const std::string& str) {
+        Fase<BareCore> loaded;
+        auto [guard, pcm] = loaded.getCoreManager();
+        if (!LoadPipelineFromString(str, pcm.get(), app.getConverters())) {
+            return std::vector<float>();
+        }
+        return *(*pcm)["bulk"].getNodes().at("s").args[0].getReader<
+                std::vector<float>>();
+    };
+    REQUIRE(load(json) == kernel);
+
+    // Broken values are rejected.
+    auto broken = [&](const std::string& from, const std::string& to) {
+        std::string b = json;
+        b.replace(b.find(from, b.find("std::vector<float>")), from.size(), to);
+        return load(b).empty();
+    };
+    REQUIRE(broken("\"size\": 40000", "\"size\": 40004"));
+    REQUIRE(broken("\"value\": \"", "\"value\": \"A"));
+    REQUIRE(broken("\"value\": \"", "\"value\": \"!!!!"));
+    REQUIRE(broken("base64", "base32"));
+}
@@ -0,0 +1,198 @@
+// fase_codegen : Generate a C++ header of a pipeline saved as JSON.
+//
+// Usage:
+//   fase_codegen [-l registry]... [-i include]... [-p pipeline] [-c class]
+//                [-j] [-t] [-b bench_dir] -o output.h pipeline.json
+//
+//   -l  Shared library defining the functions used in the pipeline with
+//       FaseAutoAddingUnivFunction(). It may also define
+//           extern "C" void FaseCodegenSetup(fase::Fase<fase::CodegenParts>*);
+//       to add other functions and to register TextIO of user-defined types.
+//   -i  Header included by the generated one (declares the functions).
+//   -p  Pipeline to generate. (default: the top pipeline of the file)
+//   -c  Name of the generated class. (default: the pipeline name)
+//   -j  Run independent nodes in parallel.
+//   -t  Measure the nodes. (see NativeCodeOptions::timing)
+//   -b  Directory to write a benchmark program of the pipeline (main.cpp) and
+//       CMakeLists.txt to build it.
+
+#include <fase2/fase.h>
+#include <fase2/stdparts.h>
+
+#include <dlfcn.h>
+#include <sys/stat.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+using App = fase::Fase<fase::CodegenParts>;
+
+struct Options {
+    std::vector<std::string> registries;
+    std::vector<std::string> includes;
+    std::string              pipeline_name;
+    std::string              class_name;
+    std::string              output;
+    std::string              input;
+    std::string              bench_dir;
+    fase::NativeCodeOptions  code_options;
+};
+
+void PrintUsage(const char* argv0) {
+    std::cerr << "Usage: " << argv0
+              << " [-l registry]... [-i include]... [-p pipeline] [-c class]"
+                 " [-j] [-t] [-b bench_dir] -o output.h pipeline.json"
+              << std::endl;
+}
+
+bool ParseArgs(int argc, char* argv[], Options* opts) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "-j") {
+            opts->code_options.parallel = true;
+        } else if (arg == "-t") {
+            opts->code_options.timing = true;
+        } else if (arg.size() == 2 && arg[0] == '-') {
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const std::string val = argv[++i];
+            switch (arg[1]) {
+                case 'l': opts->registries.emplace_back(val); break;
+                case 'i': opts->includes.emplace_back(val); break;
+                case 'p': opts->pipeline_name = val; break;
+                case 'c': opts->class_name = val; break;
+                case 'o': opts->output = val; break;
+                case 'b': opts->bench_dir = val; break;
+                default: return false;
+            }
+        } else if (opts->input.empty()) {
+            opts->input = arg;
+        } else {
+            return false;
+        }
+    }
+    return !opts->input.empty() && !opts->output.empty();
+}
+
+std::string GuardName(const std::string& class_name) {
+    std::string guard = "FASE_PIPELINE_";
+    for (char c : class_name) {
+        guard += std::isalnum(static_cast<unsigned char>(c))
+                         ? char(std::toupper(static_cast<unsigned char>(c)))
+                         : '_';
+    }
+    return guard + "_H";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    if (!ParseArgs(argc, argv, &opts)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    // Registries have to be loaded before the app is created, because their
+    // functions are added in its constructor.
+    std::vector<void*> handles;
+    for (auto& path : opts.registries) {
+        void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_GLOBAL);
+        if (handle == nullptr) {
+            std::cerr << "fase_codegen : " << dlerror() << std::endl;
+            return 1;
+        }
+        handles.emplace_back(handle);
+    }
+
+    App app;
+    for (void* handle : handles) {
+        if (auto setup = reinterpret_cast<void (*)(App*)>(
+                    dlsym(handle, "FaseCodegenSetup"))) {
+            setup(&app);
+        }
+    }
+
+    if (!app.loadPipeline(opts.input)) {
+        std::cerr << "fase_codegen : failed to load " << opts.input
+                  << std::endl;
+        return 1;
+    }
+
+    if (opts.pipeline_name.empty()) {
+        auto top_names = app.getTopPipelineNames();
+        if (top_names.size() != 1) {
+            std::cerr << "fase_codegen : specify a pipeline of " << opts.input
+                      << " with -p" << std::endl;
+            return 1;
+        }
+        opts.pipeline_name = top_names[0];
+    }
+    if (opts.class_name.empty()) {
+        opts.class_name = opts.pipeline_name;
+    }
+
+    std::string code = app.genNativeCode(opts.pipeline_name, opts.class_name,
+                                         opts.code_options);
+    if (code.empty()) {
+        std::cerr << "fase_codegen : failed to generate code of "
+                  << opts.pipeline_name << std::endl;
+        return 1;
+    }
+
+    const std::string guard = GuardName(opts.class_name);
+    std::ofstream ofs(opts.output);
+    ofs << "// Generated by fase_codegen from " << opts.input << std::endl
+        << "#ifndef " << guard << std::endl
+        << "#define " << guard << std::endl
+        << std::endl
+        << "#include <array>" << std::endl
+        << "#include <atomic>" << std::endl
+        << "#include <chrono>" << std::endl
+        << "#include <functional>" << std::endl
+        << "#include <future>" << std::endl
+        << "#include <optional>" << std::endl
+        << "#include <string>" << std::endl
+        << "#include <utility>" << std::endl
+        << std::endl;
+    for (auto& include : opts.includes) {
+        ofs << "#include \"" << include << "\"" << std::endl;
+    }
+    ofs << std::endl << code << std::endl << std::endl;
+    ofs << "#endif // " << guard << std::endl;
+    ofs.close();
+    if (!ofs) {
+        std::cerr << "fase_codegen : failed to write " << opts.output
+                  << std::endl;
+        return 1;
+    }
+
+    if (!opts.bench_dir.empty()) {
+        char* header_path = realpath(opts.output.c_str(), nullptr);
+        std::string bench_code = app.genBenchmarkCode(
+                opts.pipeline_name, opts.class_name,
+                std::string("#include \"") + header_path + "\"",
+                opts.code_options.timing);
+        free(header_path);
+        mkdir(opts.bench_dir.c_str(), 0755);
+        std::ofstream bench_ofs(opts.bench_dir + "/main.cpp");
+        bench_ofs << bench_code;
+        std::ofstream cmake_ofs(opts.bench_dir + "/CMakeLists.txt");
+        cmake_ofs << fase::GenNativeBenchmarkCMake(opts.class_name + "_bench",
+                                                   {"main.cpp"});
+        if (bench_code.empty() || !bench_ofs || !cmake_ofs) {
+            std::cerr << "fase_codegen : failed to write the benchmark to "
+                      << opts.bench_dir << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}